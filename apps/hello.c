@@ -0,0 +1,23 @@
+#include "../os.h"
+
+/*
+ * 单独链接的示例程序，由 tools/mkromfs.py 打包到 romfs 的 bin/hello，
+ * 用 task_create_elf_file("bin/hello", ...) 启动。
+ * 程序运行在U模式，只能通过 user/ulib.c 中的系统调用使用内核的服务，
+ * 入口是 start，返回时任务退出。
+ */
+
+static const char greeting[] = "hello from a loaded ELF";
+int counter = 100;   // .data，加载时复制到私有页
+int scratch[256];    // .bss，加载时清零
+
+void start(void* param)
+{
+	uint32_t tid = sys_gettid();
+
+	for (int i = 0; i < 3; i++) {
+		scratch[i] = counter++;
+		uprintf("Task %d: %s, param 0x%x, counter %d\n", tid, greeting, (uint32_t)(uintptr_t)param, scratch[i]);
+		sys_sleep(CLINT_TIMEBASE_FREQ / 10);
+	}
+}
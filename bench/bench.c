@@ -0,0 +1,264 @@
+#include "../os.h"
+
+/*
+ * 内核微基准测试
+ * make bench 用 CONFIG_BENCH=1 编译 user/user.c，os_main 只创建基准测试任务。
+ * 每项测试的结果输出一行，单位是cycle:
+ *   BENCH <名称> <迭代次数> <每次迭代的cycle数>
+ * 全部结束之后输出 BENCH_END，并通过 virt 机器的测试设备关闭QEMU。
+ * tools/bench.py 从串口输出中收集结果，和 bench/baseline-rv<XLEN>-<profile>.json 比较，
+ * 每个配置有自己的基准。还没有基准时 make bench 把这次的结果记录为基准并输出提示，之后的运行和它比较。
+ * CONFIG_VM=1 时任务运行在S模式，测试设备的页由 vm_init 映射。
+ */
+
+#define BENCH_PRIORITY 0
+#define BENCH_TIMESLICE CLINT_TIMEBASE_FREQ
+
+#define YIELD_ITERS 1000
+#define SWITCH_ITERS 1000
+#define MALLOC_ITERS 1000
+#define PAGE_ITERS 1000
+#define TIMER_ITERS 32
+#define LOCK_ITERS 10000
+#define PRINTF_ITERS 100
+#define MEM_ITERS 100
+#define MEM_SIZE 4096
+#define STRLEN_SIZE 1024
+
+static void bench_report(const char *name, uint32_t iters, uint32_t cycles)
+{
+	printf("BENCH %s %d %d\n", name, iters, cycles / iters);
+}
+
+//只有一个任务时让出CPU：trap、调度并切换回自己
+static void bench_yield(void)
+{
+	uint32_t start = ucycle();
+	for (int i = 0; i < YIELD_ITERS; i++) {
+		task_yield();
+	}
+	bench_report("yield", YIELD_ITERS, ucycle() - start);
+}
+
+static volatile int _switch_running;
+
+static void switch_partner(void *param)
+{
+	while (_switch_running) {
+		task_yield();
+	}
+}
+
+//两个同优先级的任务轮流让出CPU，每次迭代切换两次
+static void bench_switch(void)
+{
+	_switch_running = 1;
+	task_create_priority(switch_partner, NULL, BENCH_PRIORITY, BENCH_TIMESLICE);
+	task_yield(); //先让对方运行起来
+
+	uint32_t start = ucycle();
+	for (int i = 0; i < SWITCH_ITERS; i++) {
+		task_yield();
+	}
+	uint32_t cycles = ucycle() - start;
+	_switch_running = 0;
+	task_yield();
+	bench_report("ctx_switch", SWITCH_ITERS * 2, cycles);
+}
+
+static void bench_malloc(void)
+{
+	uint32_t start = ucycle();
+	for (int i = 0; i < MALLOC_ITERS; i++) {
+		void *p = my_malloc(64);
+		my_free(p);
+	}
+	bench_report("malloc_free", MALLOC_ITERS, ucycle() - start);
+}
+
+static void bench_page(void)
+{
+	uint32_t start = ucycle();
+	for (int i = 0; i < PAGE_ITERS; i++) {
+		void *p = page_alloc(1);
+		page_free(p);
+	}
+	bench_report("page_alloc", PAGE_ITERS, ucycle() - start);
+}
+
+#if CONFIG_TIMER
+static volatile uint32_t _timer_fired;
+static uint32_t _timer_first;
+static uint32_t _timer_last;
+
+static void timer_func(void *arg)
+{
+	uint32_t now = ucycle();
+	if (_timer_fired == 0) {
+		_timer_first = now;
+	}
+	_timer_last = now;
+	_timer_fired++;
+}
+
+/*
+ * 插入：创建 TIMER_ITERS 个不会到期的定时器再删除
+ * 到期：同时到期的 TIMER_ITERS 个定时器，从第一个到最后一个处理函数执行之间的平均间隔
+ */
+static void bench_timer(void)
+{
+	struct timer *timers[TIMER_ITERS];
+
+	uint32_t start = ucycle();
+	for (int i = 0; i < TIMER_ITERS; i++) {
+		timers[i] = timer_create(timer_func, NULL, 1000000 + i);
+	}
+	bench_report("timer_insert", TIMER_ITERS, ucycle() - start);
+	for (int i = 0; i < TIMER_ITERS; i++) {
+		timer_delete(timers[i]);
+	}
+
+	_timer_fired = 0;
+	for (int i = 0; i < TIMER_ITERS; i++) {
+		timers[i] = timer_create(timer_func, NULL, 1);
+	}
+	while (_timer_fired < TIMER_ITERS) {
+		task_yield();
+	}
+	bench_report("timer_expire", TIMER_ITERS - 1, _timer_last - _timer_first);
+	for (int i = 0; i < TIMER_ITERS; i++) {
+		timer_delete(timers[i]);
+	}
+}
+#endif
+
+static void bench_lock(void)
+{
+	struct spinlock lock;
+	lock_init(&lock);
+
+	uint32_t start = ucycle();
+	for (int i = 0; i < LOCK_ITERS; i++) {
+		spin_lock(&lock);
+		spin_unlock(&lock);
+	}
+	bench_report("lock", LOCK_ITERS, ucycle() - start);
+}
+
+static void bench_printf(void)
+{
+	uint32_t start = ucycle();
+	for (int i = 0; i < PRINTF_ITERS; i++) {
+		printf("printf %d 0x%x %s\n", i, i, "bench");
+	}
+	bench_report("printf", PRINTF_ITERS, ucycle() - start);
+}
+
+/*
+ * lib/string.c 的函数和逐字节循环的对比，每次迭代处理 MEM_SIZE 字节
+ * 逐字节循环通过 volatile 指针访问，避免编译器把它优化成库函数调用
+ */
+static uint8_t _mem_src[MEM_SIZE + 4];
+static uint8_t _mem_dst[MEM_SIZE + 4];
+
+static void bench_mem(void)
+{
+	uint32_t start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		memcpy(_mem_dst, _mem_src, MEM_SIZE);
+	}
+	bench_report("memcpy_4k", MEM_ITERS, ucycle() - start);
+
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		memcpy(_mem_dst, _mem_src + 1, MEM_SIZE);
+	}
+	bench_report("memcpy_4k_unaligned", MEM_ITERS, ucycle() - start);
+
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		volatile uint8_t *d = _mem_dst;
+		for (int j = 0; j < MEM_SIZE; j++) {
+			d[j] = _mem_src[j];
+		}
+	}
+	bench_report("memcpy_4k_bytes", MEM_ITERS, ucycle() - start);
+
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		memset(_mem_dst, i, MEM_SIZE);
+	}
+	bench_report("memset_4k", MEM_ITERS, ucycle() - start);
+
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		volatile uint8_t *d = _mem_dst;
+		for (int j = 0; j < MEM_SIZE; j++) {
+			d[j] = i;
+		}
+	}
+	bench_report("memset_4k_bytes", MEM_ITERS, ucycle() - start);
+
+	memcpy(_mem_dst, _mem_src, MEM_SIZE);
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		if (memcmp(_mem_dst, _mem_src, MEM_SIZE) != 0) {
+			printf("bench: memcmp mismatch\n");
+		}
+	}
+	bench_report("memcmp_4k", MEM_ITERS, ucycle() - start);
+
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		volatile uint8_t *a = _mem_dst;
+		for (int j = 0; j < MEM_SIZE && a[j] == _mem_src[j]; j++) {
+		}
+	}
+	bench_report("memcmp_4k_bytes", MEM_ITERS, ucycle() - start);
+
+	memset(_mem_src, 'a', STRLEN_SIZE);
+	_mem_src[STRLEN_SIZE] = 0;
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		if (strlen((char *)_mem_src) != STRLEN_SIZE) {
+			printf("bench: strlen mismatch\n");
+		}
+	}
+	bench_report("strlen_1k", MEM_ITERS, ucycle() - start);
+
+	start = ucycle();
+	for (int i = 0; i < MEM_ITERS; i++) {
+		volatile uint8_t *s = _mem_src;
+		int n = 0;
+		while (s[n]) {
+			n++;
+		}
+	}
+	bench_report("strlen_1k_bytes", MEM_ITERS, ucycle() - start);
+}
+
+static void bench_task(void *param)
+{
+	bench_yield();
+	bench_switch();
+	bench_malloc();
+	bench_page();
+#if CONFIG_TIMER
+	bench_timer();
+#endif
+	bench_lock();
+	bench_printf();
+	bench_mem();
+	printf("BENCH_END\n");
+
+	*(volatile uint32_t *)VIRT_TEST = VIRT_TEST_PASS;
+}
+
+/*
+ * DESCRIPTION
+ * 	创建基准测试任务，在 CONFIG_BENCH 编译的 os_main 中调用.
+ */
+void bench_start(void)
+{
+	task_create_priority(bench_task, NULL, BENCH_PRIORITY, BENCH_TIMESLICE);
+}
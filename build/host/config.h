@@ -0,0 +1,48 @@
+/* generated by tools/mkconfig.py from common.mk, do not edit */
+#ifndef __CONFIG_H__
+#define __CONFIG_H__
+
+#ifndef CONFIG_MAX_TASKS
+#define CONFIG_MAX_TASKS 10
+#endif
+#ifndef CONFIG_STACK_SIZE
+#define CONFIG_STACK_SIZE 1024
+#endif
+#ifndef CONFIG_MAX_PRIORITY
+#define CONFIG_MAX_PRIORITY 256
+#endif
+#ifndef CONFIG_MAX_EDF_TASKS
+#define CONFIG_MAX_EDF_TASKS 8
+#endif
+#ifndef CONFIG_MSG_QUEUE_LEN
+#define CONFIG_MSG_QUEUE_LEN 8
+#endif
+#ifndef CONFIG_TIMER_INTERVAL
+#define CONFIG_TIMER_INTERVAL 10000000
+#endif
+#ifndef CONFIG_TRACE_RECORDS
+#define CONFIG_TRACE_RECORDS 256
+#endif
+#ifndef CONFIG_MALLOC_PAGES
+#define CONFIG_MALLOC_PAGES 256
+#endif
+#ifndef CONFIG_VM
+#define CONFIG_VM 0
+#endif
+#ifndef CONFIG_PMP
+#define CONFIG_PMP 0
+#endif
+#ifndef CONFIG_TIMER
+#define CONFIG_TIMER 1
+#endif
+#ifndef CONFIG_TRACE
+#define CONFIG_TRACE 1
+#endif
+#ifndef CONFIG_UART_RX
+#define CONFIG_UART_RX 1
+#endif
+#ifndef CONFIG_DEBUG
+#define CONFIG_DEBUG 0
+#endif
+
+#endif /* __CONFIG_H__ */
@@ -1,10 +1,80 @@
 CROSS_COMPILE = riscv64-unknown-elf-
-CFLAGS = -nostdlib -fno-builtin -march=rv32ima -mabi=ilp32 -g -Wall
 
-QEMU = qemu-system-riscv32
+# register width of the target, 32 (rv32ima, the default) or 64 (rv64ima)
+# e.g. make XLEN=64 run. The kernel is linked at 0x80000000, which RV64
+# can only address pc-relatively, hence -mcmodel=medany.
+XLEN ?= 32
+ifeq (${XLEN},32)
+ARCH = -march=rv32ima -mabi=ilp32
+STACK_SIZE_DEFAULT = 1024
+else ifeq (${XLEN},64)
+ARCH = -march=rv64ima -mabi=lp64 -mcmodel=medany
+STACK_SIZE_DEFAULT = 2048
+else
+$(error unknown XLEN ${XLEN}, use 32 or 64)
+endif
+
+CFLAGS = -nostdlib -fno-builtin ${ARCH} -g -Wall
+LDFLAGS =
+
+# build profile, each one is built into its own directory build/rv<XLEN>/<profile>
+#   debug   -O0, the default, for gdb
+#   release -O2
+#   size    -Os
+#   lto     -O2 with link time optimization, unused functions and data
+#           are removed by the linker
+# e.g. make PROFILE=release run; "make report" compares all of them
+PROFILE ?= debug
+PROFILES = debug release size lto
+
+ifeq (${PROFILE},debug)
+CFLAGS += -O0
+else ifeq (${PROFILE},release)
+CFLAGS += -O2
+else ifeq (${PROFILE},size)
+CFLAGS += -Os
+else ifeq (${PROFILE},lto)
+CFLAGS += -O2 -flto -ffunction-sections -fdata-sections
+LDFLAGS += -flto -Wl,--gc-sections
+else
+$(error unknown PROFILE ${PROFILE}, use one of: ${PROFILES})
+endif
+
+BUILD = build/rv${XLEN}/${PROFILE}
+# config.h is generated into the build directory
+CFLAGS += -I${BUILD}
+
+QEMU = qemu-system-riscv${XLEN}
 QFLAGS = -nographic -smp 1 -machine virt -bios none
+QFLAGS += -global virtio-mmio.force-legacy=false
+QFLAGS += -drive file=disk.img,if=none,format=raw,id=x0
+QFLAGS += -device virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
 
 GDB = gdb-multiarch
 CC = ${CROSS_COMPILE}gcc
 OBJCOPY = ${CROSS_COMPILE}objcopy
-OBJDUMP = ${CROSS_COMPILE}objdump
\ No newline at end of file
+OBJDUMP = ${CROSS_COMPILE}objdump
+SIZE = ${CROSS_COMPILE}size
+
+# kernel configuration, written to config.h by tools/mkconfig.py
+# override on the command line, e.g. make CONFIG_MAX_PRIORITY=8 CONFIG_TRACE=0
+# static tables
+CONFIG_MAX_TASKS ?= 10         # tasks per priority level
+CONFIG_STACK_SIZE ?= ${STACK_SIZE_DEFAULT} # bytes per kernel task stack, doubled on RV64
+CONFIG_MAX_PRIORITY ?= 256     # priority levels, the idle task uses the last one
+CONFIG_MAX_EDF_TASKS ?= 8
+CONFIG_MSG_QUEUE_LEN ?= 8      # messages per task mailbox
+CONFIG_TIMER_INTERVAL ?= 10000000  # first timer interrupt and software timer unit, in mtime ticks (1s)
+CONFIG_TRACE_RECORDS ?= 256    # trace records per hart, a power of two
+CONFIG_MALLOC_PAGES ?= 256     # pages reserved for my_malloc
+# features, 0 compiles the subsystem out
+CONFIG_VM ?= 0                 # Sv32 page tables, tasks run in S-mode
+CONFIG_PMP ?= 0                # PMP isolation of U-mode tasks, not with CONFIG_VM
+CONFIG_TIMER ?= 1              # software timers (timer_create, SYS_TIMER)
+CONFIG_TRACE ?= 1              # event trace ring (trace_event, Ctrl-T dump)
+CONFIG_UART_RX ?= 1            # UART receive interrupt
+CONFIG_DEBUG ?= 0              # per-interrupt debug messages
+
+CONFIG_VARS = MAX_TASKS STACK_SIZE MAX_PRIORITY MAX_EDF_TASKS MSG_QUEUE_LEN \
+	TIMER_INTERVAL TRACE_RECORDS MALLOC_PAGES \
+	VM PMP TIMER TRACE UART_RX DEBUG
@@ -0,0 +1,428 @@
+#include "../os.h"
+
+/*
+ * 块缓存
+ * 缓存块设备上 BLOCK_SIZE 大小的块，每个缓冲区的数据占用 page_alloc 分配的一页。
+ * - 按 (设备, 块号) 哈希查找，所有缓冲区按最近使用的顺序串成LRU链表，淘汰最久未使用的干净块
+ * - 写回：bwrite 只标记为脏块，由 flusher 任务定期批量写回，淘汰时没有干净块才同步写回
+ * - 预读：检测到连续的顺序读之后，异步读入后面的 READAHEAD_WINDOW 个块
+ *
+ * 缓冲区的 io 标记表示读写正在进行，IO完成的回调在中断中清除该标记并唤醒等待的任务。
+ * 哈希表和LRU链表只在任务中访问，由睡眠锁保护：低优先级的 flusher 持有锁时被抢占，
+ * 高优先级的任务阻塞等待而不是自旋，flusher 仍然可以运行并释放锁。等待IO时不持有锁。
+ */
+
+extern uintptr_t HEAP_SIZE;
+
+#define BCACHE_HASH 64
+/* 块缓存占用堆中 1/BCACHE_HEAP_SHARE 的页 */
+#define BCACHE_HEAP_SHARE 16
+#define BCACHE_MIN_BUFS 8
+#define BCACHE_MAX_BUFS 512
+/* 连续读了 READAHEAD_TRIGGER 个块之后开始预读 */
+#define READAHEAD_TRIGGER 2
+#define READAHEAD_WINDOW 4
+/* 一次写回提交的最大请求数 */
+#define FLUSH_BATCH 16
+/* flusher 任务的写回间隔，单位为mtime的tick */
+#define FLUSH_INTERVAL (CLINT_TIMEBASE_FREQ / 2)
+#define FLUSHER_PRIORITY (MAX_PRIORITY - 2)
+
+static struct {
+	struct sleeplock lock;
+	struct buf *bufs;
+	uint32_t nbuf;
+	struct buf *hash[BCACHE_HASH];
+	struct buf lru; // 哨兵，lru.next 是最近使用的，lru.prev 是最久未使用的
+	struct bcache_stats stats;
+	volatile uint32_t releases; // brelse 释放最后一个引用的次数，所有缓冲区都被引用时在这里等待
+	volatile uint32_t release_waiters;
+
+	/* 顺序读检测 */
+	struct blk_dev *seq_dev;
+	uint32_t seq_next;  // 顺序读时下一个要读的块
+	uint32_t seq_count; // 已经连续读了多少块
+} bcache;
+
+static inline uint32_t _hash(struct blk_dev *dev, uint32_t blockno)
+{
+	return ((uint32_t)(uintptr_t)dev ^ blockno) % BCACHE_HASH;
+}
+
+static void _hash_remove(struct buf *b)
+{
+	struct buf **pp = &bcache.hash[_hash(b->dev, b->blockno)];
+	while (*pp && *pp != b) {
+		pp = &(*pp)->hnext;
+	}
+	if (*pp) {
+		*pp = b->hnext;
+	}
+	b->hnext = NULL;
+}
+
+static void _hash_insert(struct buf *b)
+{
+	struct buf **head = &bcache.hash[_hash(b->dev, b->blockno)];
+	b->hnext = *head;
+	*head = b;
+}
+
+static struct buf *_lookup(struct blk_dev *dev, uint32_t blockno)
+{
+	for (struct buf *b = bcache.hash[_hash(dev, blockno)]; b; b = b->hnext) {
+		if (b->dev == dev && b->blockno == blockno) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+//移到LRU链表的头部
+static void _lru_touch(struct buf *b)
+{
+	b->prev->next = b->next;
+	b->next->prev = b->prev;
+	b->next = bcache.lru.next;
+	b->prev = &bcache.lru;
+	bcache.lru.next->prev = b;
+	bcache.lru.next = b;
+}
+
+/*
+ * 找一个可以重用的缓冲区：没有被引用、没有IO、不是脏块，从LRU链表尾部开始找
+ * 调用时持有 bcache.lock
+ */
+static struct buf *_victim(void)
+{
+	for (struct buf *b = bcache.lru.prev; b != &bcache.lru; b = b->prev) {
+		if (b->refcnt == 0 && !b->io && !b->dirty) {
+			if (b->dev) {
+				bcache.stats.evictions++;
+			}
+			_hash_remove(b);
+			return b;
+		}
+	}
+	return NULL;
+}
+
+/* IO完成，在中断上下文中调用 */
+static void _bdone(struct blk_req *req)
+{
+	struct buf *b = (struct buf *)req->arg;
+	if (req->status == BLK_OK) {
+		if (!req->write) {
+			b->valid = 1;
+		}
+	} else {
+		printf("bcache: %s block %d: %s error\n", b->dev->name, b->blockno, req->write ? "write" : "read");
+		if (req->write) {
+			b->dirty = 1;
+		}
+	}
+	b->io = 0;
+	task_wake_chan((void *)&b->io);
+}
+
+static void _bio_prepare(struct buf *b, int write)
+{
+	b->req.sector = b->blockno * BLOCK_SECTORS;
+	b->req.buf = b->data;
+	b->req.len = BLOCK_SIZE;
+	b->req.write = write;
+	b->req.done = _bdone;
+	b->req.arg = b;
+}
+
+//提交一批已经设置了io标记的缓冲区的请求，描述符不够时让出CPU等待之前的请求完成
+static void _bio_submit(struct blk_dev *dev, struct blk_req *reqs[], int n)
+{
+	while (n > 0) {
+		int queued = dev->submit(dev, reqs, n);
+		if (queued < 0) {
+			panic("bcache: bad block request");
+		}
+		reqs += queued;
+		n -= queued;
+		if (n > 0) {
+			task_yield();
+		}
+	}
+}
+
+static void _bio_wait(struct buf *b)
+{
+	while (b->io) {
+		sys_wait(&b->io, 1);
+	}
+}
+
+/*
+ * 顺序读检测，返回需要预读的缓冲区个数，缓冲区已经加入哈希表并设置了io标记
+ * 调用时持有 bcache.lock
+ */
+static int _readahead(struct blk_dev *dev, uint32_t blockno, struct blk_req *reqs[])
+{
+	int n = 0;
+
+	if (dev == bcache.seq_dev && blockno == bcache.seq_next) {
+		bcache.seq_count++;
+	} else {
+		bcache.seq_dev = dev;
+		bcache.seq_count = 1;
+	}
+	bcache.seq_next = blockno + 1;
+	if (bcache.seq_count < READAHEAD_TRIGGER) {
+		return 0;
+	}
+
+	for (uint32_t i = 1; i <= READAHEAD_WINDOW && blockno + i < dev->nblocks; i++) {
+		if (_lookup(dev, blockno + i)) {
+			continue;
+		}
+		struct buf *b = _victim();
+		if (b == NULL) {
+			break;
+		}
+		b->dev = dev;
+		b->blockno = blockno + i;
+		b->valid = 0;
+		b->io = 1;
+		_hash_insert(b);
+		_bio_prepare(b, 0);
+		reqs[n++] = &b->req;
+	}
+	bcache.stats.readaheads += n;
+	return n;
+}
+
+//找一个没有被引用、但是是脏块或者IO还没有完成的缓冲区，调用时持有 bcache.lock
+static struct buf *_busy(void)
+{
+	for (struct buf *b = bcache.lru.prev; b != &bcache.lru; b = b->prev) {
+		if (b->refcnt == 0 && (b->dirty || b->io)) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+//找一个正在写回的块，调用时持有 bcache.lock
+static struct buf *_writing(void)
+{
+	for (struct buf *b = bcache.lru.next; b != &bcache.lru; b = b->next) {
+		if (b->io && b->req.write) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+static void bcache_flusher(void *param);
+
+void bcache_init(void)
+{
+	uint32_t nbuf = HEAP_SIZE / PAGE_SIZE / BCACHE_HEAP_SHARE;
+	if (nbuf < BCACHE_MIN_BUFS) {
+		nbuf = BCACHE_MIN_BUFS;
+	}
+	if (nbuf > BCACHE_MAX_BUFS) {
+		nbuf = BCACHE_MAX_BUFS;
+	}
+
+	bcache.bufs = (struct buf *)my_malloc(nbuf * sizeof(struct buf));
+	bcache.lru.next = &bcache.lru;
+	bcache.lru.prev = &bcache.lru;
+	sleeplock_init(&bcache.lock);
+	bcache.releases = 0;
+	bcache.release_waiters = 0;
+	for (uint32_t i = 0; i < BCACHE_HASH; i++) {
+		bcache.hash[i] = NULL;
+	}
+
+	for (bcache.nbuf = 0; bcache.nbuf < nbuf; bcache.nbuf++) {
+		struct buf *b = &bcache.bufs[bcache.nbuf];
+		b->data = (uint8_t *)page_alloc(1);
+		if (b->data == NULL) {
+			break;
+		}
+		b->dev = NULL;
+		b->valid = 0;
+		b->dirty = 0;
+		b->io = 0;
+		b->refcnt = 0;
+		b->hnext = NULL;
+		b->next = bcache.lru.next;
+		b->prev = &bcache.lru;
+		bcache.lru.next->prev = b;
+		bcache.lru.next = b;
+	}
+
+	task_create_priority(bcache_flusher, NULL, FLUSHER_PRIORITY, CLINT_TIMEBASE_FREQ / 100);
+	printf("bcache: %d buffers of %d bytes\n", bcache.nbuf, BLOCK_SIZE);
+}
+
+/*
+ * DESCRIPTION
+ * 	读取一个块，返回的缓冲区被引用，使用完之后必须调用 brelse.
+ * 	只能在任务中调用，没有命中时阻塞等待IO完成。
+ * RETURN VALUE
+ * 	缓冲区，读取失败时 valid 为0
+ */
+struct buf *bread(struct blk_dev *dev, uint32_t blockno)
+{
+	struct blk_req *ra[READAHEAD_WINDOW];
+	struct buf *b;
+	int need_read = 0;
+	int nra;
+
+	sleep_lock(&bcache.lock);
+	while (1) {
+		b = _lookup(dev, blockno);
+		if (b) {
+			bcache.stats.hits++;
+			if (!b->valid && !b->io) {
+				//上一次读取失败，重新读
+				need_read = 1;
+			}
+			break;
+		}
+		b = _victim();
+		if (b) {
+			bcache.stats.misses++;
+			b->dev = dev;
+			b->blockno = blockno;
+			b->valid = 0;
+			_hash_insert(b);
+			need_read = 1;
+			break;
+		}
+		struct buf *busy = _busy();
+		if (busy) {
+			//没有引用的缓冲区是脏块或者IO还没有完成，写回或者等待IO完成之后重试
+			int dirty = busy->dirty && !busy->io;
+			sleep_unlock(&bcache.lock);
+			if (dirty) {
+				bcache_flush();
+			} else {
+				_bio_wait(busy);
+			}
+			sleep_lock(&bcache.lock);
+			continue;
+		}
+		//所有缓冲区都被引用，等待 brelse 释放一个，sys_wait 发现计数已经变化时立即返回
+		uint32_t releases = bcache.releases;
+		bcache.release_waiters++;
+		sleep_unlock(&bcache.lock);
+		sys_wait(&bcache.releases, releases);
+		sleep_lock(&bcache.lock);
+		bcache.release_waiters--;
+	}
+	if (need_read) {
+		//由当前任务读入，其他任务命中时等待IO完成
+		b->io = 1;
+		_bio_prepare(b, 0);
+	}
+	b->refcnt++;
+	_lru_touch(b);
+	nra = _readahead(dev, blockno, ra);
+	sleep_unlock(&bcache.lock);
+
+	if (need_read) {
+		struct blk_req *req = &b->req;
+		_bio_submit(dev, &req, 1);
+	}
+	if (nra) {
+		_bio_submit(dev, ra, nra);
+	}
+	_bio_wait(b);
+	return b;
+}
+
+/*
+ * DESCRIPTION
+ * 	标记缓冲区已修改，由 flusher 任务或 bcache_flush 写回磁盘.
+ */
+void bwrite(struct buf *b)
+{
+	b->valid = 1;
+	b->dirty = 1;
+}
+
+void brelse(struct buf *b)
+{
+	int wake = 0;
+
+	sleep_lock(&bcache.lock);
+	if (--b->refcnt == 0) {
+		bcache.releases++;
+		wake = bcache.release_waiters > 0;
+	}
+	sleep_unlock(&bcache.lock);
+	if (wake) {
+		sys_wake(&bcache.releases);
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	把所有脏块写回磁盘，每次批量提交 FLUSH_BATCH 个请求，等待全部完成后返回.
+ * 	其他任务(例如 flusher)已经提交、还没有完成的写也会等待完成。
+ */
+void bcache_flush(void)
+{
+	struct buf *batch[FLUSH_BATCH];
+	struct blk_req *reqs[FLUSH_BATCH];
+
+	while (1) {
+		int n = 0;
+		struct blk_dev *dev = NULL;
+
+		sleep_lock(&bcache.lock);
+		for (struct buf *b = bcache.lru.prev; b != &bcache.lru && n < FLUSH_BATCH; b = b->prev) {
+			//一批请求只能提交到同一个设备
+			if (!b->dirty || b->io || (dev && b->dev != dev)) {
+				continue;
+			}
+			dev = b->dev;
+			b->dirty = 0;
+			b->io = 1;
+			_bio_prepare(b, 1);
+			batch[n] = b;
+			reqs[n] = &b->req;
+			n++;
+		}
+		bcache.stats.writebacks += n;
+		if (n == 0) {
+			//没有需要提交的脏块，等待别的任务提交的写完成，完成后重新检查
+			struct buf *w = _writing();
+			sleep_unlock(&bcache.lock);
+			if (w == NULL) {
+				return;
+			}
+			_bio_wait(w);
+			continue;
+		}
+		sleep_unlock(&bcache.lock);
+
+		_bio_submit(dev, reqs, n);
+		for (int i = 0; i < n; i++) {
+			_bio_wait(batch[i]);
+		}
+	}
+}
+
+//定期写回脏块
+static void bcache_flusher(void *param)
+{
+	while (1) {
+		sys_sleep(FLUSH_INTERVAL);
+		bcache_flush();
+	}
+}
+
+void bcache_get_stats(struct bcache_stats *stats)
+{
+	*stats = bcache.stats;
+}
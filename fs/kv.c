@@ -0,0 +1,575 @@
+#include "../os.h"
+
+/*
+ * 日志结构的键值存储
+ * 建立在块缓存上，块设备可以是磁盘，也可以是测试用的内存块设备。
+ * - 只追加写：put/del 都在日志末尾追加一条记录，从不原地修改，适合闪存
+ * - 提交记录：kv_commit 追加一条提交记录并把块缓存写回磁盘，挂载时只重放最后一条提交记录之前的记录，
+ *   之后没有提交的记录被丢弃
+ * - 内存中的哈希索引：键 -> 最新记录在日志中的偏移，挂载时扫描日志重建
+ * - 压缩：设备分成两半，当前的一半写满之后，把有效的记录复制到另一半，
+ *   最后写另一半的头部(代数增加)切换过去，写头部之前掉电仍然使用原来的一半。
+ *   压缩由低优先级的任务在后台进行，追加时空间不够则直接在调用者中进行。
+ *
+ * 每一半的第一个块是头部，记录从第二个块开始，可以跨块。
+ * 记录中保存了所在一半的代数，上一代残留的记录因为代数不同而被忽略。
+ * 每条记录之后写一个空的记录头作为日志的结尾，扫描在这里停止：失败的压缩可能在另一半留下
+ * 同一代的记录(甚至提交记录)，重启之后代数可能再次被使用，结尾保证这些旧记录不会被重放。
+ */
+
+#define KV_MAGIC 0x474c564b // "KVLG"
+#define KV_REC_MAGIC 0x4b56
+#define KV_PUT 1
+#define KV_DEL 2
+#define KV_COMMIT 3
+#define KV_HASH 256
+#define KV_COMPACT_INTERVAL (CLINT_TIMEBASE_FREQ / 10)
+#define KV_COMPACTOR_PRIORITY (MAX_PRIORITY - 2)
+
+struct kv_header {
+	uint32_t magic;
+	uint32_t gen;
+	uint32_t crc;
+};
+
+struct kv_rec {
+	uint16_t magic;
+	uint8_t type;
+	uint8_t klen;
+	uint16_t vlen;
+	uint16_t pad;
+	uint32_t gen;
+	uint32_t crc; // 整条记录的CRC32，计算时该字段为0
+};
+
+#define REC_SIZE(klen, vlen) ((sizeof(struct kv_rec) + (klen) + (vlen) + 3) & ~3)
+#define REC_MAX REC_SIZE(KV_MAX_KEY, KV_MAX_VALUE)
+
+struct kv_entry {
+	struct kv_entry *next;
+	uint32_t hash;
+	uint32_t off;   // 最新记录在日志中的偏移
+	uint16_t vlen;
+	uint8_t klen;
+	char key[KV_MAX_KEY];
+};
+
+static struct {
+	struct blk_dev *dev;
+	struct sleeplock lock; // 保护整个结构体和日志，等待时阻塞而不是轮询
+	uint32_t half_blocks;
+	uint32_t half;      // 当前使用的一半
+	uint32_t gen;       // 当前一半的代数
+	uint32_t next_gen;  // 下一次压缩使用的代数，只增不减，失败的压缩用过的代数不再使用
+	uint32_t end;       // 追加的位置
+	uint32_t live;      // 有效记录的字节数
+	int compactor;      // 压缩任务是否已经创建
+	struct kv_entry *index[KV_HASH];
+	struct kv_stats stats;
+	uint8_t rec[REC_MAX]; // 读写记录的缓冲区，由锁保护
+} kv;
+
+static uint32_t crc_table[256];
+
+static void _crc_init(void)
+{
+	for (uint32_t i = 0; i < 256; i++) {
+		uint32_t c = i;
+		for (int j = 0; j < 8; j++) {
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		}
+		crc_table[i] = c;
+	}
+}
+
+static uint32_t _crc32(const uint8_t *p, uint32_t len)
+{
+	uint32_t c = 0xffffffff;
+	for (uint32_t i = 0; i < len; i++) {
+		c = crc_table[(c ^ p[i]) & 0xff] ^ (c >> 8);
+	}
+	return ~c;
+}
+
+static uint32_t _hash(const char *key, uint32_t klen)
+{
+	uint32_t h = 0x811c9dc5;
+	for (uint32_t i = 0; i < klen; i++) {
+		h ^= (uint8_t)key[i];
+		h *= 0x01000193;
+	}
+	return h;
+}
+
+static inline uint32_t _half_size(void)
+{
+	return kv.half_blocks * BLOCK_SIZE;
+}
+
+//通过块缓存读写一半中 [off, off + len) 的日志
+static int _log_io(uint32_t half, uint32_t off, void *buf, uint32_t len, int write)
+{
+	uint8_t *p = (uint8_t *)buf;
+	while (len > 0) {
+		uint32_t boff = off % BLOCK_SIZE;
+		uint32_t n = BLOCK_SIZE - boff;
+		if (n > len) {
+			n = len;
+		}
+		struct buf *b = bread(kv.dev, half * kv.half_blocks + off / BLOCK_SIZE);
+		if (!b->valid) {
+			brelse(b);
+			return -1;
+		}
+		if (write) {
+			memcpy(b->data + boff, p, n);
+		} else {
+			memcpy(p, b->data + boff, n);
+		}
+		if (write) {
+			bwrite(b);
+		}
+		brelse(b);
+		p += n;
+		off += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * 把 off 处的记录读入 kv.rec 并检查
+ * 返回记录的大小，不是有效的记录时返回0
+ */
+static uint32_t _read_rec(uint32_t half, uint32_t gen, uint32_t off)
+{
+	struct kv_rec *r = (struct kv_rec *)kv.rec;
+
+	if (off + sizeof(struct kv_rec) > _half_size() ||
+		_log_io(half, off, r, sizeof(struct kv_rec), 0) < 0) {
+		return 0;
+	}
+	if (r->magic != KV_REC_MAGIC || r->gen != gen || r->type < KV_PUT || r->type > KV_COMMIT ||
+		r->klen > KV_MAX_KEY || r->vlen > KV_MAX_VALUE) {
+		return 0;
+	}
+	uint32_t size = REC_SIZE(r->klen, r->vlen);
+	if (off + size > _half_size() ||
+		_log_io(half, off + sizeof(struct kv_rec), r + 1, size - sizeof(struct kv_rec), 0) < 0) {
+		return 0;
+	}
+	uint32_t crc = r->crc;
+	r->crc = 0;
+	if (_crc32(kv.rec, size) != crc) {
+		return 0;
+	}
+	r->crc = crc;
+	return size;
+}
+
+//把 kv.rec 中的记录写到 off 处，重新计算代数和CRC
+static int _write_rec(uint32_t half, uint32_t gen, uint32_t off)
+{
+	struct kv_rec *r = (struct kv_rec *)kv.rec;
+	uint32_t size = REC_SIZE(r->klen, r->vlen);
+
+	r->magic = KV_REC_MAGIC;
+	r->gen = gen;
+	r->crc = 0;
+	r->crc = _crc32(kv.rec, size);
+	if (_log_io(half, off, kv.rec, size, 1) < 0) {
+		return -1;
+	}
+	//日志的结尾，下一条记录会覆盖它
+	struct kv_rec end = {0};
+	if (off + size + sizeof(end) <= _half_size() &&
+		_log_io(half, off + size, &end, sizeof(end), 1) < 0) {
+		return -1;
+	}
+	kv.stats.log_bytes += size;
+	return 0;
+}
+
+//在 kv.rec 中组装一条记录
+static uint32_t _make_rec(uint8_t type, const char *key, uint32_t klen, const void *val, uint32_t vlen)
+{
+	struct kv_rec *r = (struct kv_rec *)kv.rec;
+	uint8_t *p = (uint8_t *)(r + 1);
+	uint32_t size = REC_SIZE(klen, vlen);
+
+	r->type = type;
+	r->klen = klen;
+	r->vlen = vlen;
+	r->pad = 0;
+	for (uint32_t i = 0; i < klen; i++) {
+		*p++ = key[i];
+	}
+	for (uint32_t i = 0; i < vlen; i++) {
+		*p++ = ((const uint8_t *)val)[i];
+	}
+	while (p < kv.rec + size) {
+		*p++ = 0;
+	}
+	return size;
+}
+
+static struct kv_entry **_lookup(const char *key, uint32_t klen, uint32_t hash)
+{
+	struct kv_entry **pp = &kv.index[hash % KV_HASH];
+	for (; *pp; pp = &(*pp)->next) {
+		struct kv_entry *e = *pp;
+		if (e->hash != hash || e->klen != klen) {
+			continue;
+		}
+		uint32_t i = 0;
+		while (i < klen && e->key[i] == key[i]) {
+			i++;
+		}
+		if (i == klen) {
+			break;
+		}
+	}
+	return pp;
+}
+
+//更新索引，记录已经写到 off 处
+static int _apply(uint8_t type, const char *key, uint32_t klen, uint32_t vlen, uint32_t off)
+{
+	uint32_t hash = _hash(key, klen);
+	struct kv_entry **pp = _lookup(key, klen, hash);
+	struct kv_entry *e = *pp;
+
+	if (e) {
+		kv.live -= REC_SIZE(e->klen, e->vlen);
+	}
+	if (type == KV_DEL) {
+		if (e) {
+			*pp = e->next;
+			my_free(e);
+		}
+		return 0;
+	}
+	if (e == NULL) {
+		e = (struct kv_entry *)my_malloc(sizeof(struct kv_entry));
+		if (e == NULL) {
+			return -1;
+		}
+		e->hash = hash;
+		e->klen = klen;
+		memcpy(e->key, key, klen);
+		e->next = NULL;
+		*pp = e;
+	}
+	e->off = off;
+	e->vlen = vlen;
+	kv.live += REC_SIZE(klen, vlen);
+	return 0;
+}
+
+static void _index_clear(void)
+{
+	for (int i = 0; i < KV_HASH; i++) {
+		while (kv.index[i]) {
+			struct kv_entry *e = kv.index[i];
+			kv.index[i] = e->next;
+			my_free(e);
+		}
+	}
+	kv.live = 0;
+}
+
+/*
+ * 扫描当前的一半重建索引：第一遍找到最后一条提交记录，第二遍只重放它之前的记录
+ */
+static int _replay(void)
+{
+	uint32_t committed = BLOCK_SIZE;
+	uint32_t off, size;
+
+	_index_clear();
+	for (off = BLOCK_SIZE; (size = _read_rec(kv.half, kv.gen, off)) != 0; off += size) {
+		if (((struct kv_rec *)kv.rec)->type == KV_COMMIT) {
+			committed = off + size;
+		}
+	}
+	for (off = BLOCK_SIZE; off < committed; off += size) {
+		struct kv_rec *r = (struct kv_rec *)kv.rec;
+		size = _read_rec(kv.half, kv.gen, off);
+		if (size == 0) {
+			return -1;
+		}
+		if (r->type != KV_COMMIT && _apply(r->type, (char *)(r + 1), r->klen, r->vlen, off) < 0) {
+			return -1;
+		}
+	}
+	kv.end = committed;
+	return 0;
+}
+
+static int _write_header(uint32_t half, uint32_t gen)
+{
+	struct kv_header h;
+	h.magic = KV_MAGIC;
+	h.gen = gen;
+	h.crc = _crc32((uint8_t *)&h, 2 * sizeof(uint32_t));
+	if (_log_io(half, 0, &h, sizeof(h), 1) < 0) {
+		return -1;
+	}
+	kv.stats.log_bytes += sizeof(h);
+	bcache_flush();
+	return 0;
+}
+
+//读一半的头部，返回代数，无效时返回0
+static uint32_t _read_header(uint32_t half)
+{
+	struct kv_header h;
+	if (_log_io(half, 0, &h, sizeof(h), 0) < 0 || h.magic != KV_MAGIC ||
+		h.crc != _crc32((uint8_t *)&h, 2 * sizeof(uint32_t))) {
+		return 0;
+	}
+	return h.gen;
+}
+
+static int _append_commit(uint32_t half, uint32_t gen, uint32_t *off)
+{
+	uint32_t size = _make_rec(KV_COMMIT, NULL, 0, NULL, 0);
+	if (*off + size > _half_size() || _write_rec(half, gen, *off) < 0) {
+		return -1;
+	}
+	*off += size;
+	return 0;
+}
+
+/*
+ * 把有效的记录复制到另一半，调用时持有锁
+ * 出错时另一半的头部还没有写，当前的一半仍然有效，重新扫描恢复索引
+ */
+static int _compact(void)
+{
+	uint32_t half = 1 - kv.half;
+	uint32_t gen = kv.next_gen++;
+	uint32_t off = BLOCK_SIZE;
+
+	for (int i = 0; i < KV_HASH; i++) {
+		for (struct kv_entry *e = kv.index[i]; e; e = e->next) {
+			uint32_t size = _read_rec(kv.half, kv.gen, e->off);
+			if (size == 0 || _write_rec(half, gen, off) < 0) {
+				goto fail;
+			}
+			e->off = off;
+			off += size;
+		}
+	}
+	if (_append_commit(half, gen, &off) < 0) {
+		goto fail;
+	}
+	bcache_flush();
+	if (_write_header(half, gen) < 0) {
+		goto fail;
+	}
+	kv.half = half;
+	kv.gen = gen;
+	kv.end = off;
+	kv.stats.compactions++;
+	return 0;
+
+fail:
+	printf("kv: compaction failed\n");
+	_replay();
+	return -1;
+}
+
+//日志用了3/4以上，并且至少1/4是无效的记录
+static int _need_compact(void)
+{
+	return kv.end > _half_size() / 4 * 3 && kv.end - BLOCK_SIZE - kv.live > _half_size() / 4;
+}
+
+static void kv_compactor(void *param)
+{
+	while (1) {
+		sys_sleep(KV_COMPACT_INTERVAL);
+		sleep_lock(&kv.lock);
+		if (_need_compact()) {
+			_compact();
+		}
+		sleep_unlock(&kv.lock);
+	}
+}
+
+/*
+ * 追加一条记录并更新索引，调用时持有锁
+ * 为之后的提交记录预留空间，空间不够时先压缩
+ */
+static int _append(uint8_t type, const char *key, uint32_t klen, const void *val, uint32_t vlen)
+{
+	uint32_t size = REC_SIZE(klen, vlen);
+	uint32_t limit = _half_size() - REC_SIZE(0, 0);
+
+	if (kv.end + size > limit && (_compact() < 0 || kv.end + size > limit)) {
+		return -1;
+	}
+	_make_rec(type, key, klen, val, vlen);
+	if (_write_rec(kv.half, kv.gen, kv.end) < 0 || _apply(type, key, klen, vlen, kv.end) < 0) {
+		return -1;
+	}
+	kv.end += size;
+	return 0;
+}
+
+static uint32_t _key_len(const char *key)
+{
+	uint32_t n = 0;
+	while (key[n]) {
+		n++;
+	}
+	return n;
+}
+
+/*
+ * DESCRIPTION
+ * 	在块设备上挂载键值存储，设备上没有有效的数据时格式化.
+ * 	设备的前一半和后一半轮流使用，每一半至少两个块。
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 设备太小或读写失败
+ */
+int kv_mount(struct blk_dev *dev)
+{
+	uint32_t gen0, gen1;
+
+	if (dev == NULL || dev->nblocks < 4) {
+		return -1;
+	}
+	_crc_init();
+	sleep_lock(&kv.lock);
+	kv.dev = dev;
+	kv.half_blocks = dev->nblocks / 2;
+	gen0 = _read_header(0);
+	gen1 = _read_header(1);
+	if (gen0 == 0 && gen1 == 0) {
+		printf("kv: formatting %s\n", dev->name);
+		kv.half = 0;
+		kv.gen = 1;
+		if (_write_header(0, 1) < 0) {
+			sleep_unlock(&kv.lock);
+			return -1;
+		}
+	} else {
+		kv.half = gen1 > gen0 ? 1 : 0;
+		kv.gen = gen1 > gen0 ? gen1 : gen0;
+	}
+	kv.next_gen = kv.gen + 1;
+	int ret = _replay();
+	sleep_unlock(&kv.lock);
+	if (ret < 0) {
+		return -1;
+	}
+
+	if (!kv.compactor) {
+		task_create_priority(kv_compactor, NULL, KV_COMPACTOR_PRIORITY, CLINT_TIMEBASE_FREQ / 100);
+		kv.compactor = 1;
+	}
+	printf("kv: mounted %s, generation %d, %d bytes of log\n", dev->name, kv.gen, kv.end);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	写入键值对，key 是不超过 KV_MAX_KEY 个字符的字符串.
+ * 	写入立即对 kv_get 可见，调用 kv_commit 之后才保证掉电不丢失。
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 参数错误、空间不够或读写失败
+ */
+int kv_put(const char *key, const void *val, uint32_t len)
+{
+	uint32_t klen = _key_len(key);
+	if (klen == 0 || klen > KV_MAX_KEY || len > KV_MAX_VALUE) {
+		return -1;
+	}
+	sleep_lock(&kv.lock);
+	int ret = _append(KV_PUT, key, klen, val, len);
+	if (ret == 0) {
+		kv.stats.puts++;
+		kv.stats.user_bytes += klen + len;
+	}
+	sleep_unlock(&kv.lock);
+	return ret;
+}
+
+/*
+ * DESCRIPTION
+ * 	读取 key 的值，最多复制 len 字节到 buf 中.
+ * RETURN VALUE
+ * 	值的长度，key 不存在或读取失败时返回-1
+ */
+int kv_get(const char *key, void *buf, uint32_t len)
+{
+	uint32_t klen = _key_len(key);
+	int ret = -1;
+
+	sleep_lock(&kv.lock);
+	struct kv_entry *e = *_lookup(key, klen, _hash(key, klen));
+	if (e) {
+		uint32_t n = e->vlen < len ? e->vlen : len;
+		if (_log_io(kv.half, e->off + sizeof(struct kv_rec) + klen, buf, n, 0) == 0) {
+			ret = e->vlen;
+		}
+	}
+	kv.stats.gets++;
+	sleep_unlock(&kv.lock);
+	return ret;
+}
+
+/*
+ * DESCRIPTION
+ * 	删除 key，追加一条删除记录.
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: key 不存在或写入失败
+ */
+int kv_del(const char *key)
+{
+	uint32_t klen = _key_len(key);
+	int ret = -1;
+
+	sleep_lock(&kv.lock);
+	if (*_lookup(key, klen, _hash(key, klen))) {
+		ret = _append(KV_DEL, key, klen, NULL, 0);
+	}
+	if (ret == 0) {
+		kv.stats.dels++;
+	}
+	sleep_unlock(&kv.lock);
+	return ret;
+}
+
+/*
+ * DESCRIPTION
+ * 	追加提交记录并把块缓存写回设备，返回之后之前的所有写入都不会因为掉电丢失.
+ */
+int kv_commit(void)
+{
+	int ret;
+
+	sleep_lock(&kv.lock);
+	if (kv.end + REC_SIZE(0, 0) > _half_size()) {
+		//压缩之后的日志以提交记录结尾
+		ret = _compact();
+	} else {
+		ret = _append_commit(kv.half, kv.gen, &kv.end);
+	}
+	bcache_flush();
+	if (ret == 0) {
+		kv.stats.commits++;
+	}
+	sleep_unlock(&kv.lock);
+	return ret;
+}
+
+void kv_get_stats(struct kv_stats *stats)
+{
+	*stats = kv.stats;
+}
@@ -0,0 +1,58 @@
+#include "../os.h"
+
+/*
+ * 内存块设备
+ * 用 page_alloc 分配的连续页模拟一个块设备，用于在没有磁盘时测试块缓存和文件系统。
+ * 请求在 submit 中同步完成，完成回调在提交者的上下文中调用。
+ */
+
+static int ramdisk_submit(struct blk_dev *dev, struct blk_req *reqs[], int n)
+{
+	uint8_t *base = (uint8_t *)dev->priv;
+	uint32_t sectors = dev->nblocks * BLOCK_SECTORS;
+
+	for (int i = 0; i < n; i++) {
+		if (reqs[i]->len == 0 || reqs[i]->len % BLK_SECTOR_SIZE ||
+			reqs[i]->sector + reqs[i]->len / BLK_SECTOR_SIZE > sectors) {
+			return -1;
+		}
+	}
+
+	for (int i = 0; i < n; i++) {
+		struct blk_req *req = reqs[i];
+		uint8_t *disk = base + req->sector * BLK_SECTOR_SIZE;
+		uint8_t *src = req->write ? req->buf : disk;
+		uint8_t *dst = req->write ? disk : req->buf;
+		memcpy(dst, src, req->len);
+		req->status = BLK_OK;
+		if (req->done) {
+			req->done(req);
+		}
+	}
+	return n;
+}
+
+/*
+ * DESCRIPTION
+ * 	创建一个 nblocks 个块的内存块设备，内容初始化为0.
+ * RETURN VALUE
+ * 	块设备，内存不足时返回NULL
+ */
+struct blk_dev *ramdisk_create(uint32_t nblocks)
+{
+	struct blk_dev *dev = (struct blk_dev *)my_malloc(sizeof(struct blk_dev));
+	if (dev == NULL) {
+		return NULL;
+	}
+	uint32_t *data = (uint32_t *)page_alloc(nblocks * BLOCK_SIZE / PAGE_SIZE);
+	if (data == NULL) {
+		my_free(dev);
+		return NULL;
+	}
+	memset(data, 0, nblocks * BLOCK_SIZE);
+	dev->name = "ram0";
+	dev->nblocks = nblocks;
+	dev->submit = ramdisk_submit;
+	dev->priv = data;
+	return dev;
+}
@@ -0,0 +1,155 @@
+#include "../os.h"
+
+/*
+ * 只读的内存文件系统
+ * tools/mkromfs.py 把 romfs/ 目录打包成镜像，链接到内核的 .romfs 段中(见 os.ld)，
+ * 镜像的格式见 mkromfs.py。文件的内容不需要复制，romfs_map 直接返回指向镜像内部的指针。
+ * 路径按 FNV-1a 哈希到桶中，查找只需要比较同一个桶里的几个文件名。
+ */
+
+extern uintptr_t ROMFS_START;
+extern uintptr_t ROMFS_END;
+
+/* 和 tools/mkromfs.py 保持一致 */
+#define ROMFS_MAGIC 0x464d4f52 // "ROMF"
+#define ROMFS_VERSION 1
+#define ROMFS_NO_ENTRY 0xffffffff
+
+struct romfs_header {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t nfiles;
+	uint32_t nbuckets;
+	uint32_t size;
+	uint32_t entries_off;
+	uint32_t names_off;
+};
+
+struct romfs_entry {
+	uint32_t hash;
+	uint32_t next;      // 同一个桶中的下一个文件
+	uint32_t name_off;
+	uint32_t data_off;
+	uint32_t size;
+};
+
+static const struct romfs_header *_romfs = NULL;
+
+static uint32_t _romfs_hash(const char *name)
+{
+	uint32_t h = 0x811c9dc5;
+	while (*name) {
+		h ^= (uint8_t)*name++;
+		h *= 0x01000193;
+	}
+	return h;
+}
+
+static int _name_equal(const char *a, const char *b)
+{
+	while (*a && *a == *b) {
+		a++;
+		b++;
+	}
+	return *a == *b;
+}
+
+static inline const uint8_t *_base(void)
+{
+	return (const uint8_t *)_romfs;
+}
+
+static inline const struct romfs_entry *_entry(uint32_t i)
+{
+	return (const struct romfs_entry *)(_base() + _romfs->entries_off) + i;
+}
+
+void romfs_init(void)
+{
+	const struct romfs_header *h = (const struct romfs_header *)ROMFS_START;
+
+	if (ROMFS_END - ROMFS_START < sizeof(struct romfs_header) ||
+		h->magic != ROMFS_MAGIC || h->version != ROMFS_VERSION ||
+		h->size > ROMFS_END - ROMFS_START) {
+		printf("romfs: no valid image\n");
+		return;
+	}
+	_romfs = h;
+	printf("romfs: %d files, %d bytes at 0x%x\n", h->nfiles, h->size, ROMFS_START);
+}
+
+/*
+ * DESCRIPTION
+ * 	打开文件，路径相对于打包的目录，开头的 '/' 可以省略.
+ * RETURN VALUE
+ * 	0: 成功，f 中是文件的信息，读写位置为0
+ * 	-1: 文件不存在
+ */
+int romfs_open(const char *path, struct romfs_file *f)
+{
+	if (_romfs == NULL) {
+		return -1;
+	}
+	while (*path == '/') {
+		path++;
+	}
+
+	uint32_t h = _romfs_hash(path);
+	const uint32_t *buckets = (const uint32_t *)(_base() + sizeof(struct romfs_header));
+	for (uint32_t i = buckets[h & (_romfs->nbuckets - 1)]; i != ROMFS_NO_ENTRY; i = _entry(i)->next) {
+		const struct romfs_entry *e = _entry(i);
+		const char *name = (const char *)_base() + e->name_off;
+		if (e->hash == h && _name_equal(name, path)) {
+			f->name = name;
+			f->data = _base() + e->data_off;
+			f->size = e->size;
+			f->pos = 0;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/*
+ * DESCRIPTION
+ * 	从当前位置复制最多 len 字节到 buf 中，并移动读写位置.
+ * RETURN VALUE
+ * 	实际读取的字节数，到达文件末尾时返回0
+ */
+int romfs_read(struct romfs_file *f, void *buf, uint32_t len)
+{
+	uint32_t n = f->size - f->pos;
+	if (n > len) {
+		n = len;
+	}
+	memcpy(buf, f->data + f->pos, n);
+	f->pos += n;
+	return n;
+}
+
+/*
+ * DESCRIPTION
+ * 	返回文件中 [off, off + len) 在镜像中的地址，不复制数据.
+ * 	镜像是只读的，不能通过返回的指针修改文件。
+ * RETURN VALUE
+ * 	指向文件内容的指针，超出文件范围时返回NULL
+ */
+const void *romfs_map(struct romfs_file *f, uint32_t off, uint32_t len)
+{
+	if (off > f->size || len > f->size - off) {
+		return NULL;
+	}
+	return f->data + off;
+}
+
+//打印镜像中所有的文件
+void romfs_list(void)
+{
+	if (_romfs == NULL) {
+		return;
+	}
+	for (uint32_t i = 0; i < _romfs->nfiles; i++) {
+		const struct romfs_entry *e = _entry(i);
+		printf("%s\t%d\n", (const char *)_base() + e->name_off, e->size);
+	}
+}
@@ -0,0 +1,170 @@
+#include "../os.h"
+
+/*
+ * 主机上的微基准测试：在主机上运行分配器、调度器和定时器链表的热路径，输出每次操作的纳秒数.
+ * 和 bench/bench.c 在QEMU中测量的cycle数不能直接比较，用于在修改数据结构时快速比较前后的差别。
+ * 每项测试的结果输出一行:
+ *   HOST_BENCH <名称> <迭代次数> <每次操作的纳秒数>
+ */
+#define BENCH_ITERS 1000000
+#define BENCH_TASKS 8
+#define BENCH_TIMERS 64
+#define BENCH_FRAG_BLOCKS 512
+
+extern TaskNode* task_global_ptr;
+extern void sched_init(void);
+extern void timer_init(void);
+extern void timer_handler(void);
+extern void schedule_priority(void);
+
+static uint64_t _start;
+
+static void _begin(void)
+{
+	_start = hal_now_ns();
+}
+
+static void _end(const char *name, uint32_t iters)
+{
+	uint64_t ns = hal_now_ns() - _start;
+	uint32_t tenths = (uint32_t)(ns * 10 / iters);
+	printf("HOST_BENCH %-20s %8d %6d.%d ns\n", name, iters, tenths / 10, tenths % 10);
+}
+
+static void _entry(void *param)
+{
+}
+
+static void _timer_func(void *arg)
+{
+}
+
+static void bench_malloc(void)
+{
+	static void *blocks[BENCH_FRAG_BLOCKS];
+
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		my_free(my_malloc(32));
+	}
+	_end("malloc_free_32", BENCH_ITERS);
+
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		my_free(my_calloc(1, 256));
+	}
+	_end("calloc_free_256", BENCH_ITERS);
+
+	//释放一半的块，首次适应要跳过很多已分配的块和小的空闲块
+	for (int i = 0; i < BENCH_FRAG_BLOCKS; i++) {
+		blocks[i] = my_malloc(16 + hal_rand() % 240);
+	}
+	for (int i = 0; i < BENCH_FRAG_BLOCKS; i += 2) {
+		my_free(blocks[i]);
+		blocks[i] = NULL;
+	}
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		my_free(my_malloc(16 + i % 240));
+	}
+	_end("malloc_free_frag", BENCH_ITERS);
+	for (int i = 0; i < BENCH_FRAG_BLOCKS; i++) {
+		my_free(blocks[i]);
+	}
+
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		void *p = my_malloc(64);
+		p = my_realloc(p, 512);
+		my_free(p);
+	}
+	_end("malloc_realloc_free", BENCH_ITERS);
+
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		page_free(page_alloc(1));
+	}
+	_end("page_alloc_free", BENCH_ITERS);
+}
+
+static void bench_sched(void)
+{
+	for (int i = 0; i < BENCH_TASKS; i++) {
+		HAL_CHECK(task_create_priority(_entry, NULL, 1, CLINT_TIMEBASE_FREQ) >= 0);
+	}
+	schedule_priority();
+
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		task_yield();
+		schedule_priority();
+	}
+	_end("yield_schedule", BENCH_ITERS);
+
+	//阻塞当前任务再唤醒，和等待消息、sys_wait 的路径相同
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		TaskNode *t = task_global_ptr;
+		task_block(t);
+		schedule_priority();
+		task_wakeup(t);
+	}
+	_end("block_wakeup", BENCH_ITERS);
+
+	//在更高的优先级创建任务，调度到它之后退出，由调度器回收
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		task_create_priority(_entry, NULL, 0, CLINT_TIMEBASE_FREQ);
+		schedule_priority();
+		task_global_ptr->exiting = 1;
+		schedule_priority();
+	}
+	_end("create_run_exit", BENCH_ITERS);
+
+	while (task_global_ptr->base_priority != MAX_PRIORITY - 1) {
+		task_global_ptr->exiting = 1;
+		schedule_priority();
+	}
+}
+
+static void bench_timer(void)
+{
+	static struct timer *pending[BENCH_TIMERS];
+
+	for (int i = 0; i < BENCH_TIMERS; i++) {
+		pending[i] = timer_create(_timer_func, NULL, 100 + hal_rand() % 100);
+	}
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		timer_delete(timer_create(_timer_func, NULL, 100 + i % 100));
+	}
+	_end("timer_create_delete", BENCH_ITERS);
+
+	//定时器中断中触发一个定时器并调度
+	_begin();
+	for (uint32_t i = 0; i < BENCH_ITERS; i++) {
+		struct timer *t = timer_create(_timer_func, NULL, 1);
+		hal_set_mtime(t->expires);
+		timer_handler();
+		timer_delete(t);
+	}
+	_end("timer_fire", BENCH_ITERS);
+
+	for (int i = 0; i < BENCH_TIMERS; i++) {
+		timer_delete(pending[i]);
+	}
+}
+
+int main(void)
+{
+	hal_init();
+	hal_srand(1);
+	sched_init();
+	timer_init();
+	bench_malloc();
+	bench_sched();
+	bench_timer();
+	HAL_CHECK(heap_check() == 0);
+	HAL_CHECK(sched_check() == 0);
+	return 0;
+}
@@ -0,0 +1,143 @@
+#include "../os.h"
+
+/*
+ * 主机测试的硬件抽象层，和内核的源文件一样只包含 os.h，
+ * 需要libc的部分(计时、随机数、退出)在 hal_libc.c 中。
+ *
+ * 主机上没有任务在运行，测试程序直接调用内核函数，所有调用都相当于发生在trap中：
+ * trap_context 总是返回1，页分配器、堆和任务创建直接执行，不会走系统调用。
+ * 只能在任务中执行的系统调用在这里调用时测试失败。
+ */
+
+reg_t hal_csr[HAL_NR_CSR];
+uint8_t hal_clint[HAL_CLINT_SIZE] __attribute__((aligned(8)));
+
+/* 代替 mem.S 和 os.ld 给出的内存布局，只有堆是真实的内存 */
+#define HAL_HEAP_SIZE (8 * 1024 * 1024)
+static uint8_t hal_heap[HAL_HEAP_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+uintptr_t HEAP_START = (uintptr_t)hal_heap;
+uintptr_t HEAP_SIZE = HAL_HEAP_SIZE;
+uintptr_t TEXT_START, TEXT_END, DATA_START, DATA_END, RODATA_START, RODATA_END;
+uintptr_t UTEXT_START, UTEXT_END, UDATA_START, UDATA_END, ROMFS_START, ROMFS_END;
+uintptr_t BSS_START, BSS_END;
+
+struct context *hal_current;
+uint32_t hal_switches;
+
+//上电之后内存中的内容是随机的，堆不能依赖它是0
+void hal_init(void)
+{
+	memset(hal_heap, 0xa5, HAL_HEAP_SIZE);
+}
+
+void hal_set_mtime(uint64_t t)
+{
+	*(volatile uint64_t *)CLINT_MTIME = t;
+}
+
+uint64_t hal_get_mtime(void)
+{
+	return clock_ticks();
+}
+
+uint32_t hal_take_msip(void)
+{
+	volatile uint32_t *msip = (volatile uint32_t *)CLINT_MSIP(0);
+	uint32_t v = *msip;
+	*msip = 0;
+	return v;
+}
+
+int trap_context(void)
+{
+	return 1;
+}
+
+//切换任务只记录切换到的上下文，任务不会真的运行
+void switch_to(struct context *next)
+{
+	hal_current = next;
+	hal_switches++;
+}
+
+uint32_t ucycle(void)
+{
+	return (uint32_t)hal_cycle();
+}
+
+#if CONFIG_TRACE
+void trace_event(uint8_t event, uint32_t arg0, uint32_t arg1)
+{
+}
+#endif
+
+//测试中的任务不使用区域和虚拟内存
+void arena_destroy(struct arena *a)
+{
+	HAL_CHECK(a == NULL);
+}
+
+void vm_destroy(pagetable_t pt)
+{
+	hal_fail(__FILE__, __LINE__, "vm_destroy without CONFIG_VM");
+}
+
+void vm_free_asid(reg_t satp)
+{
+	hal_fail(__FILE__, __LINE__, "vm_free_asid without CONFIG_VM");
+}
+
+//和 SYS_TIMER_ADD/SYS_TIMER_DEL 的处理函数一样，直接修改定时器链表
+int sys_timer_add(struct TimerNode *node)
+{
+	timer_insert(node);
+	return 0;
+}
+
+int sys_timer_del(struct TimerNode *node)
+{
+	timer_remove(node);
+	return 0;
+}
+
+/* 下面的函数只会在任务中调用 */
+#define HAL_TASK_ONLY() hal_fail(__FILE__, __LINE__, __func__)
+
+reg_t sys_mem(int op, reg_t arg0, reg_t arg1)
+{
+	HAL_TASK_ONLY();
+	return 0;
+}
+
+int sys_task_create(const struct task_args *a)
+{
+	HAL_TASK_ONLY();
+	return -1;
+}
+
+int sys_job_end(void)
+{
+	HAL_TASK_ONLY();
+	return -1;
+}
+
+void sys_sleep(uint32_t ticks)
+{
+	HAL_TASK_ONLY();
+}
+
+void sys_exit(void)
+{
+	HAL_TASK_ONLY();
+}
+
+void sleep_lock(struct sleeplock *lk)
+{
+	HAL_TASK_ONLY();
+}
+
+void sleep_unlock(struct sleeplock *lk)
+{
+	HAL_TASK_ONLY();
+}
@@ -0,0 +1,86 @@
+#ifndef __HAL_H__
+#define __HAL_H__
+
+/*
+ * 主机测试的硬件抽象层
+ * make host-test 用主机的gcc编译 mem/page.c、sched/sched.c 和 trap/timer.c，
+ * 定义 HOST_TEST 之后 riscv.h 在最后包含这个文件：访问CSR的函数换成下面的宏，
+ * 读写的是 host/hal.c 中的变量，riscv.h 中的内联汇编没有被调用，不会被编译出来。
+ * CLINT 是 hal.c 中的一块内存，见 platform.h。
+ * 这个文件和内核的源文件一起编译，不能包含libc的头文件。
+ */
+
+enum {
+	HAL_MSTATUS,
+	HAL_MEPC,
+	HAL_MSCRATCH,
+	HAL_MTVEC,
+	HAL_MIE,
+	HAL_MCOUNTEREN,
+	HAL_SCOUNTEREN,
+	HAL_MCAUSE,
+	HAL_SATP,
+	HAL_PMPCFG0,
+	HAL_PMPCFG1,
+	HAL_PMPADDR0,
+	HAL_PMPADDR7,
+	HAL_MTVAL,
+	HAL_NR_CSR,
+};
+
+extern reg_t hal_csr[HAL_NR_CSR];
+extern reg_t hal_cycle(void);
+
+/* 测试只模拟一个hart，tp 和 mhartid 总是0 */
+#define r_tp() ((reg_t)0)
+#define r_mhartid() ((reg_t)0)
+#define r_mstatus() (hal_csr[HAL_MSTATUS])
+#define w_mstatus(x) (hal_csr[HAL_MSTATUS] = (x))
+#define r_mepc() (hal_csr[HAL_MEPC])
+#define w_mepc(x) (hal_csr[HAL_MEPC] = (x))
+#define w_mscratch(x) (hal_csr[HAL_MSCRATCH] = (x))
+#define w_mtvec(x) (hal_csr[HAL_MTVEC] = (x))
+#define r_mie() (hal_csr[HAL_MIE])
+#define w_mie(x) (hal_csr[HAL_MIE] = (x))
+#define w_mcounteren(x) (hal_csr[HAL_MCOUNTEREN] = (x))
+#define w_scounteren(x) (hal_csr[HAL_SCOUNTEREN] = (x))
+#define r_cycle() hal_cycle()
+#define r_mcause() (hal_csr[HAL_MCAUSE])
+#define w_satp(x) (hal_csr[HAL_SATP] = (x))
+#define r_satp() (hal_csr[HAL_SATP])
+#define sfence_vma() ((void)0)
+#define sfence_vma_asid(asid) ((void)(asid))
+#define w_pmpcfg0(x) (hal_csr[HAL_PMPCFG0] = (x))
+#define w_pmpcfg1(x) (hal_csr[HAL_PMPCFG1] = (x))
+#define w_pmpaddr0(x) (hal_csr[HAL_PMPADDR0] = (x))
+#define w_pmpaddr7(x) (hal_csr[HAL_PMPADDR7] = (x))
+#define r_mtval() (hal_csr[HAL_MTVAL])
+#define wfi() ((void)0)
+
+/* CLINT 的寄存器，platform.h 中的 CLINT_BASE 指向这里 */
+#define HAL_CLINT_SIZE 0xC000
+extern uint8_t hal_clint[];
+
+/*
+ * 测试程序使用的接口，由 hal.c 用libc实现
+ */
+/* 在使用内核之前调用，把堆填成非0的内容 */
+extern void hal_init(void);
+/* 设置 mtime，clock_ticks 和定时器都按它计时 */
+extern void hal_set_mtime(uint64_t t);
+extern uint64_t hal_get_mtime(void);
+/* 读取并清除 CLINT 的 msip，返回之前的值，用来检查内核是否请求了调度 */
+extern uint32_t hal_take_msip(void);
+/* 最近一次 switch_to 切换到的上下文 */
+extern struct context *hal_current;
+extern uint32_t hal_switches;
+/* 可重复的伪随机数 */
+extern void hal_srand(uint64_t seed);
+extern uint32_t hal_rand(void);
+/* 单调时钟，单位是纳秒，用于微基准测试 */
+extern uint64_t hal_now_ns(void);
+/* 测试失败：输出位置和信息然后退出 */
+extern void hal_fail(const char *file, int line, const char *msg);
+#define HAL_CHECK(cond) do { if (!(cond)) hal_fail(__FILE__, __LINE__, #cond); } while (0)
+
+#endif /* __HAL_H__ */
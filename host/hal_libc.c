@@ -0,0 +1,44 @@
+/*
+ * 主机测试的硬件抽象层中需要libc的部分
+ * 这个文件不包含内核的头文件，types.h 中的类型和libc的定义冲突，
+ * 这里用 unsigned int/unsigned long long 代替 uint32_t/uint64_t，函数的声明见 hal.h。
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static unsigned long long hal_seed = 1;
+
+void hal_srand(unsigned long long seed)
+{
+	hal_seed = seed ? seed : 1;
+}
+
+//xorshift64*，在不同的主机上得到相同的序列
+unsigned int hal_rand(void)
+{
+	hal_seed ^= hal_seed >> 12;
+	hal_seed ^= hal_seed << 25;
+	hal_seed ^= hal_seed >> 27;
+	return (unsigned int)((hal_seed * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+unsigned long long hal_now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//主机上没有cycle计数器可用时，用纳秒代替
+unsigned long long hal_cycle(void)
+{
+	return hal_now_ns();
+}
+
+void hal_fail(const char *file, int line, const char *msg)
+{
+	fflush(stdout);
+	fprintf(stderr, "%s:%d: check failed: %s\n", file, line, msg);
+	exit(1);
+}
@@ -0,0 +1,211 @@
+#include "../os.h"
+
+/*
+ * 页分配器和堆的性质测试，在主机上运行 HEAP_OPS 次随机操作：
+ * 每个槽位保存一次分配和它的内容，分配后按槽位的标记填满，释放和 my_realloc 之前检查内容没有被改写，
+ * 所以任何重叠的分配都会被发现。另外检查：
+ * - my_calloc 的内存全是0，包括之前用过的内存和第一次分配出去的内存
+ * - my_aligned_alloc 按要求对齐，my_realloc 保留原来的内容
+ * - 只有最大的空闲块放不下时 my_malloc 才返回NULL，测试中堆会被用满
+ * - 重复释放和指向块中间的指针被拒绝，并且不影响其他分配
+ * - 定期用 heap_check 和 page_check 检查不变式，全部释放之后堆回到开始时的状态
+ * 最后运行内核中的 page_test，次数由 make host-test 设为 HEAP_OPS。
+ */
+#define HEAP_OPS 1000000
+#define HEAP_SLOTS 256
+#define HEAP_CHECK_EVERY 4096
+/* 页分配只抽查内容，否则太慢 */
+#define PAGE_VERIFY_STEP 61
+
+enum { KIND_MALLOC, KIND_CALLOC, KIND_ALIGNED, KIND_PAGES };
+
+struct slot {
+	uint8_t *p;
+	uint32_t size;
+	int kind;
+};
+
+static struct slot slots[HEAP_SLOTS];
+
+static uint32_t _step(struct slot *s)
+{
+	return s->kind == KIND_PAGES ? PAGE_VERIFY_STEP : 1;
+}
+
+static void _fill(struct slot *s, uint32_t from, uint8_t tag)
+{
+	for (uint32_t i = from; i < s->size; i += _step(s)) {
+		s->p[i] = tag;
+	}
+}
+
+static void _verify(struct slot *s, uint32_t len, uint8_t tag)
+{
+	for (uint32_t i = 0; i < len; i += _step(s)) {
+		HAL_CHECK(s->p[i] == tag);
+	}
+}
+
+//大多数分配很小，偶尔有和堆(MALLOC_PAGES 页)同一量级的分配让堆用满
+static uint32_t _rand_size(void)
+{
+	uint32_t r = hal_rand() % 100;
+	if (r < 80) {
+		return 1 + hal_rand() % 256;
+	}
+	if (r < 98) {
+		return 1 + hal_rand() % 4096;
+	}
+	return 1 + hal_rand() % (CONFIG_MALLOC_PAGES * PAGE_SIZE / 4);
+}
+
+//分配失败时最大的空闲块一定放不下：块的大小不超过 size 加两个控制块和对齐
+static void _check_full(uint32_t size)
+{
+	struct heap_stats st;
+	HAL_CHECK(heap_get_stats(&st) == 0);
+	HAL_CHECK(st.largest_free < size + 32);
+}
+
+static void _alloc(struct slot *s, uint8_t tag)
+{
+	uint32_t r = hal_rand() % 100;
+	s->size = _rand_size();
+	if (r < 50) {
+		s->kind = KIND_MALLOC;
+		s->p = my_malloc(s->size);
+		if (s->p == NULL) {
+			_check_full(s->size);
+		}
+	} else if (r < 70) {
+		uint32_t n = 1 + hal_rand() % 16;
+		s->kind = KIND_CALLOC;
+		s->size = (s->size + n - 1) / n * n;
+		s->p = my_calloc(n, s->size / n);
+		if (s->p == NULL) {
+			_check_full(s->size);
+		}
+		_verify(s, s->p ? s->size : 0, 0);
+	} else if (r < 85) {
+		uint32_t align = 1u << (hal_rand() % 13);
+		s->kind = KIND_ALIGNED;
+		s->p = my_aligned_alloc(align, s->size);
+		HAL_CHECK((uintptr_t)s->p % align == 0);
+	} else {
+		int npages = 1 + hal_rand() % 4;
+		s->kind = KIND_PAGES;
+		s->size = npages * PAGE_SIZE;
+		s->p = page_alloc(npages);
+		HAL_CHECK((uintptr_t)s->p % PAGE_SIZE == 0);
+	}
+	if (s->p) {
+		_fill(s, 0, tag);
+	}
+}
+
+static void _release(struct slot *s)
+{
+	if (s->kind == KIND_PAGES) {
+		page_free(s->p);
+	} else {
+		my_free(s->p);
+	}
+	s->p = NULL;
+}
+
+//重复释放和指向块中间的指针都被拒绝，堆和其他分配不受影响
+static void _bad_free(struct slot *s, uint8_t tag)
+{
+	struct heap_stats st0, st1;
+
+	HAL_CHECK(heap_get_stats(&st0) == 0);
+	if (s->size >= 16) {
+		my_free(s->p + 8);
+		_verify(s, s->size, tag);
+	} else {
+		uint8_t *p = s->p;
+		my_free(p);
+		my_free(p);
+		s->p = NULL;
+	}
+	HAL_CHECK(heap_get_stats(&st1) == 0);
+	HAL_CHECK(st1.bad_frees == st0.bad_frees + 1);
+}
+
+static uint32_t failures;
+
+static void _realloc(struct slot *s, uint8_t tag)
+{
+	uint32_t size = _rand_size();
+	uint8_t *p = my_realloc(s->p, size);
+	if (p == NULL) {
+		//失败时原来的内存不变
+		failures++;
+		_check_full(size);
+		_verify(s, s->size, tag);
+		return;
+	}
+	uint32_t kept = size < s->size ? size : s->size;
+	s->p = p;
+	s->kind = KIND_MALLOC;
+	_verify(s, kept, tag);
+	s->size = size;
+	_fill(s, kept, tag);
+}
+
+int main(void)
+{
+	struct heap_stats start, end;
+	uint64_t t0 = hal_now_ns();
+	uint32_t allocs = 0;
+
+	hal_init();
+	hal_srand(42);
+	HAL_CHECK(heap_get_stats(&start) == 0);
+
+	for (uint32_t op = 0; op < HEAP_OPS; op++) {
+		uint32_t i = hal_rand() % HEAP_SLOTS;
+		struct slot *s = &slots[i];
+		uint8_t tag = (uint8_t)(op * 7 + i);
+
+		if (s->p == NULL) {
+			_alloc(s, tag);
+			allocs++;
+			failures += s->p == NULL;
+		} else {
+			//上一次写入时的标记保存在第一个字节
+			uint8_t old = s->p[0];
+			_verify(s, s->size, old);
+			uint32_t r = hal_rand() % 64;
+			if (r == 0 && s->kind != KIND_PAGES) {
+				_bad_free(s, old);
+			} else if (r < 16 && s->kind != KIND_PAGES) {
+				_realloc(s, old);
+			} else {
+				_release(s);
+			}
+		}
+		if (op % HEAP_CHECK_EVERY == 0) {
+			HAL_CHECK(heap_check() == 0);
+			HAL_CHECK(page_check() == 0);
+		}
+	}
+	for (int i = 0; i < HEAP_SLOTS; i++) {
+		if (slots[i].p) {
+			_verify(&slots[i], slots[i].size, slots[i].p[0]);
+			_release(&slots[i]);
+		}
+	}
+	HAL_CHECK(heap_get_stats(&end) == 0);
+	HAL_CHECK(page_check() == 0);
+	HAL_CHECK(end.used_bytes == start.used_bytes);
+	HAL_CHECK(end.free_blocks == 1);
+	//堆确实被用满过，分配失败的路径也测试到了
+	HAL_CHECK(failures > 0);
+	printf("test_heap: %d ops, %d allocations, %d failed, %d ms\n",
+		HEAP_OPS, allocs, failures, (uint32_t)((hal_now_ns() - t0) / 1000000));
+
+	HAL_CHECK(page_test() == 0);
+	printf("test_heap: passed\n");
+	return 0;
+}
@@ -0,0 +1,259 @@
+#include "../os.h"
+
+/*
+ * 就绪链表和调度器的性质测试，在主机上运行 SCHED_OPS 次随机操作：
+ * 创建任务、主动让出、被定时器中断抢占、阻塞、唤醒和退出，每次都调用真实的 schedule_priority。
+ * 测试中维护每个优先级的就绪队列和每个任务的时间片预算作为参考模型，每次调度之后检查：
+ * - 切换到的任务是最高优先级的参考队列的头部，时间片预算和模型一致
+ * - sched_check 通过，每个优先级的 tasks_num 等于参考队列的长度
+ * - 每个优先级的栈槽位用完时 task_create_priority 失败，否则成功
+ * 最后让所有任务退出，堆回到测试开始时的状态。
+ */
+#define SCHED_OPS 1000000
+/* 测试使用的优先级，空闲任务在 MAX_PRIORITY - 1 */
+#define TEST_PRIORITIES 6
+#define TEST_TASKS (TEST_PRIORITIES * MAX_TASKS)
+#define IDLE_PRIORITY (MAX_PRIORITY - 1)
+/* 与 sched/sched.c 中的 MIN_TIMESLICE 相同 */
+#define MIN_TIMESLICE (CLINT_TIMEBASE_FREQ / 10000)
+
+extern TaskNode* task_global_ptr;
+extern uint32_t tasks_num[];
+extern void sched_init(void);
+extern void schedule_priority(void);
+
+/* 参考模型：每个优先级一个FIFO队列，最后一个位置放空闲任务的队列 */
+#define QUEUES (TEST_PRIORITIES + 1)
+#define QUEUE_CAP (MAX_TASKS + 1)
+
+struct queue {
+	TaskNode *q[QUEUE_CAP];
+	uint32_t n;
+};
+
+static struct queue ready[QUEUES];
+static TaskNode *blocked[TEST_TASKS];
+static uint32_t nblocked;
+static uint32_t alive[TEST_PRIORITIES]; //每个优先级还没有退出的任务数，包括阻塞的
+/* 模型中每个存活任务的时间片预算 */
+static struct {
+	TaskNode *t;
+	uint32_t budget;
+} budgets[TEST_TASKS + 1];
+static uint64_t slice_start;
+
+static struct queue *_queue(int priority)
+{
+	return &ready[priority == IDLE_PRIORITY ? TEST_PRIORITIES : priority];
+}
+
+static void _push(TaskNode *t)
+{
+	struct queue *q = _queue(t->base_priority);
+	HAL_CHECK(q->n < QUEUE_CAP);
+	q->q[q->n++] = t;
+}
+
+static void _remove(TaskNode *t)
+{
+	struct queue *q = _queue(t->base_priority);
+	for (uint32_t i = 0; i < q->n; i++) {
+		if (q->q[i] == t) {
+			for (; i + 1 < q->n; i++) {
+				q->q[i] = q->q[i + 1];
+			}
+			q->n--;
+			return;
+		}
+	}
+	HAL_CHECK(0);
+}
+
+//任务在模型中的预算，add 为1时为新任务分配一项
+static uint32_t *_budget(TaskNode *t, int add)
+{
+	for (int i = 0; i < TEST_TASKS + 1; i++) {
+		if (budgets[i].t == (add ? NULL : t)) {
+			budgets[i].t = t;
+			return &budgets[i].budget;
+		}
+	}
+	HAL_CHECK(0);
+	return NULL;
+}
+
+
+static void _entry(void *param)
+{
+}
+
+//模型中切出当前任务：结算预算，用完或者主动让出时移到队尾
+static void _model_switch_out(uint64_t now, int yielded, int leaving)
+{
+	TaskNode *cur = task_global_ptr;
+	if (cur == NULL) {
+		return;
+	}
+	uint32_t used = now - slice_start;
+	uint32_t *b = _budget(cur, 0);
+	int exhausted = used + MIN_TIMESLICE >= *b;
+	*b = exhausted ? cur->timeslice : *b - used;
+	if (!leaving && (exhausted || yielded)) {
+		_remove(cur);
+		_push(cur);
+	}
+}
+
+//调度之后检查切换到的任务和模型一致
+static void _check_pick(void)
+{
+	TaskNode *expect = NULL;
+	for (int i = 0; i < QUEUES; i++) {
+		if (ready[i].n) {
+			expect = ready[i].q[0];
+			break;
+		}
+	}
+	HAL_CHECK(expect != NULL);
+	HAL_CHECK(task_global_ptr == expect);
+	HAL_CHECK(hal_current == expect->task);
+	HAL_CHECK(expect->budget == *_budget(expect, 0));
+}
+
+static void _check_lists(void)
+{
+	HAL_CHECK(sched_check() == 0);
+	for (int p = 0; p < TEST_PRIORITIES; p++) {
+		HAL_CHECK(tasks_num[p] == ready[p].n);
+	}
+	HAL_CHECK(tasks_num[IDLE_PRIORITY] == ready[TEST_PRIORITIES].n);
+}
+
+//时间前进 advance 个tick之后进入调度器，yielded 和 leaving 描述当前任务切出的原因
+static void _schedule(uint32_t advance, int yielded, int leaving)
+{
+	uint64_t now = hal_get_mtime() + advance;
+	hal_set_mtime(now);
+	_model_switch_out(now, yielded, leaving);
+	schedule_priority();
+	slice_start = now;
+	_check_pick();
+}
+
+//当前任务退出：先从模型的队列中删除，调度器回收之后再删除它的预算，节点的内存可能被新任务重用
+static void _exit_current(uint32_t advance)
+{
+	TaskNode *cur = task_global_ptr;
+	cur->exiting = 1;
+	_remove(cur);
+	alive[cur->base_priority]--;
+	_schedule(advance, 0, 1);
+	for (int i = 0; i < TEST_TASKS + 1; i++) {
+		if (budgets[i].t == cur) {
+			budgets[i].t = NULL;
+		}
+	}
+}
+
+static void _create(void)
+{
+	int priority = hal_rand() % TEST_PRIORITIES;
+	uint32_t timeslice = 2 * MIN_TIMESLICE + hal_rand() % (50 * MIN_TIMESLICE);
+	int id = task_create_priority(_entry, NULL, priority, timeslice);
+
+	if (alive[priority] == MAX_TASKS) {
+		HAL_CHECK(id < 0);
+		return;
+	}
+	HAL_CHECK(id >= 0);
+	TaskNode *t = task_find(id);
+	HAL_CHECK(t != NULL && t->base_priority == priority && t->budget == timeslice);
+	*_budget(t, 1) = timeslice;
+	alive[priority]++;
+	_push(t);
+}
+
+//短的运行时间不会用完预算，长的经常用完
+static uint32_t _rand_advance(void)
+{
+	return hal_rand() % 4 ? hal_rand() % MIN_TIMESLICE : hal_rand() % (60 * MIN_TIMESLICE);
+}
+
+int main(void)
+{
+	struct heap_stats start, end;
+	uint64_t t0 = hal_now_ns();
+	uint32_t counts[6] = {0};
+
+	hal_init();
+	hal_srand(7);
+	sched_init();
+	HAL_CHECK(heap_get_stats(&start) == 0);
+	//sched_init 创建的空闲任务
+	TaskNode *idle = task_find(0);
+	HAL_CHECK(idle != NULL && idle->base_priority == IDLE_PRIORITY);
+	*_budget(idle, 1) = idle->timeslice;
+	_push(idle);
+	_schedule(0, 0, 0);
+
+	for (uint32_t op = 0; op < SCHED_OPS; op++) {
+		uint32_t r = hal_rand() % 100;
+		TaskNode *cur = task_global_ptr;
+		int is_idle = cur == idle;
+
+		if (r < 15) {
+			_create();
+			counts[0]++;
+		} else if (r < 45) {
+			//主动让出
+			task_yield();
+			HAL_CHECK(hal_take_msip() == 1);
+			_schedule(_rand_advance(), 1, 0);
+			counts[1]++;
+		} else if (r < 65) {
+			//定时器中断抢占
+			_schedule(_rand_advance(), 0, 0);
+			counts[2]++;
+		} else if (r < 77 && !is_idle) {
+			//阻塞：和 sys_wait、sys_recv 一样在中断上下文中离开就绪链表再调度
+			task_block(cur);
+			_remove(cur);
+			blocked[nblocked++] = cur;
+			_schedule(_rand_advance(), 0, 1);
+			counts[3]++;
+		} else if (r < 92 && nblocked) {
+			//唤醒回到原来优先级的队尾，等下一次调度
+			uint32_t i = hal_rand() % nblocked;
+			TaskNode *t = blocked[i];
+			blocked[i] = blocked[--nblocked];
+			task_wakeup(t);
+			_push(t);
+			counts[4]++;
+		} else if (!is_idle) {
+			//退出：调度器回收任务
+			_exit_current(_rand_advance());
+			counts[5]++;
+		}
+		_check_lists();
+	}
+
+	//唤醒所有任务，依次让它们退出
+	while (nblocked) {
+		TaskNode *t = blocked[--nblocked];
+		task_wakeup(t);
+		_push(t);
+	}
+	_schedule(0, 0, 0);
+	while (task_global_ptr != idle) {
+		_exit_current(0);
+	}
+	_check_lists();
+	HAL_CHECK(heap_get_stats(&end) == 0);
+	HAL_CHECK(end.used_bytes == start.used_bytes);
+
+	printf("test_sched: %d ops: %d creates, %d yields, %d preemptions, %d blocks, %d wakeups, %d exits, %d ms\n",
+		SCHED_OPS, counts[0], counts[1], counts[2], counts[3], counts[4], counts[5],
+		(uint32_t)((hal_now_ns() - t0) / 1000000));
+	printf("test_sched: passed\n");
+	return 0;
+}
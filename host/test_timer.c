@@ -0,0 +1,130 @@
+#include "../os.h"
+
+/*
+ * 软件定时器链表的性质测试，在主机上运行 TIMER_OPS 次随机操作：
+ * 用 timer_create/timer_delete 创建和删除定时器，让 mtime 前进之后调用真实的定时器中断处理 timer_handler。
+ * 测试中记录每个定时器的超时时刻作为参考模型，每次操作之后检查：
+ * - timer_list_check 通过，timer_next_expiry 等于模型中最早的未触发定时器
+ * - 定时器中断中到期的定时器都触发了一次，按超时时刻的顺序，没有到期的和已经删除的不会触发
+ * - mtimecmp 不晚于最早的未触发定时器，定时器中断不会错过它，包括设置了很长的时间片之后新创建的定时器
+ * 最后删除所有定时器，堆回到测试开始时的状态。
+ */
+#define TIMER_OPS 1000000
+#define TIMER_SLOTS 64
+#define TIMER_MAX_TIMEOUT 8
+
+extern void sched_init(void);
+extern void timer_init(void);
+extern void timer_handler(void);
+extern void timer_arm(uint32_t interval);
+
+struct slot {
+	struct timer *t;
+	uint64_t expires;
+	uint32_t fired;
+};
+
+static struct slot slots[TIMER_SLOTS];
+static uint64_t last_fired; //本次定时器中断中上一个触发的定时器的超时时刻
+
+static void _func(void *arg)
+{
+	struct slot *s = arg;
+	HAL_CHECK(s->t != NULL && s->fired == 0);
+	HAL_CHECK(s->expires <= hal_get_mtime());
+	HAL_CHECK(s->expires >= last_fired);
+	last_fired = s->expires;
+	s->fired++;
+}
+
+//模型中最早的未触发定时器
+static uint64_t _next_expiry(void)
+{
+	uint64_t next = (uint64_t)-1;
+	for (int i = 0; i < TIMER_SLOTS; i++) {
+		if (slots[i].t && !slots[i].fired && slots[i].expires < next) {
+			next = slots[i].expires;
+		}
+	}
+	return next;
+}
+
+static void _check(void)
+{
+	uint64_t next = _next_expiry();
+	HAL_CHECK(timer_list_check() == 0);
+	HAL_CHECK(timer_next_expiry() == next);
+	HAL_CHECK(*(volatile uint64_t *)CLINT_MTIMECMP(0) <= next);
+}
+
+int main(void)
+{
+	struct heap_stats start, end;
+	uint64_t t0 = hal_now_ns();
+	uint32_t creates = 0, deletes = 0, interrupts = 0;
+
+	hal_init();
+	hal_srand(3);
+	sched_init();
+	timer_init();
+	HAL_CHECK(heap_get_stats(&start) == 0);
+
+	for (uint32_t op = 0; op < TIMER_OPS; op++) {
+		uint32_t r = hal_rand() % 100;
+		struct slot *s = &slots[hal_rand() % TIMER_SLOTS];
+
+		if (r < 60) {
+			if (s->t == NULL) {
+				uint32_t timeout = 1 + hal_rand() % TIMER_MAX_TIMEOUT;
+				s->expires = hal_get_mtime() + (uint64_t)timeout * TIMER_TICK;
+				s->fired = 0;
+				s->t = timer_create(_func, s, timeout);
+				HAL_CHECK(s->t != NULL && s->t->expires == s->expires);
+				creates++;
+			} else {
+				//已经触发的定时器也要删除，释放内存
+				timer_delete(s->t);
+				s->t = NULL;
+				deletes++;
+			}
+		} else {
+			//随机前进，经常停在某个定时器的超时时刻上
+			uint64_t now = hal_get_mtime();
+			uint64_t next = _next_expiry();
+			if (next != (uint64_t)-1 && hal_rand() % 2) {
+				now = next;
+			} else {
+				now += hal_rand() % (TIMER_TICK / 2);
+			}
+			hal_set_mtime(now);
+			last_fired = 0;
+			timer_handler();
+			interrupts++;
+			//有时像切换到时间片很长的任务一样设置定时器，之后创建的更早的定时器要把 mtimecmp 提前
+			if (hal_rand() % 2) {
+				timer_arm(2 * TIMER_MAX_TIMEOUT * TIMER_TICK);
+			}
+			for (int i = 0; i < TIMER_SLOTS; i++) {
+				if (slots[i].t) {
+					HAL_CHECK(slots[i].fired == (slots[i].expires <= now));
+				}
+			}
+		}
+		_check();
+	}
+	for (int i = 0; i < TIMER_SLOTS; i++) {
+		if (slots[i].t) {
+			timer_delete(slots[i].t);
+			slots[i].t = NULL;
+		}
+	}
+	_check();
+	HAL_CHECK(timer_next_expiry() == (uint64_t)-1);
+	HAL_CHECK(heap_get_stats(&end) == 0);
+	HAL_CHECK(end.used_bytes == start.used_bytes);
+
+	printf("test_timer: %d ops: %d creates, %d deletes, %d interrupts, %d ms\n",
+		TIMER_OPS, creates, deletes, interrupts, (uint32_t)((hal_now_ns() - t0) / 1000000));
+	printf("test_timer: passed\n");
+	return 0;
+}
@@ -7,14 +7,16 @@
 extern void uart_init(void);
 extern void page_init(void);
 extern void malloc_init(void);
+extern void vm_init(void);
 extern void trap_init(void);
 extern void plic_init(void);
 extern void timer_init(void);
 extern void sched_init(void);
+extern void bcache_init(void);
+extern void romfs_init(void);
 extern void schedule_priority(void);
 extern void os_main(void);
 
-extern int lock_init(struct spinlock* lk);
 struct spinlock lk;
 
 void start_kernel(void)
@@ -23,14 +25,20 @@ void start_kernel(void)
 	uart_puts("Hello, RVOS!\n");
 
 	malloc_init();
+	romfs_init();
+#if CONFIG_VM
+	vm_init();
+#endif
 
 	trap_init();
 
 	plic_init();
 	uart_puts("timplic_initer is done!\n");
+	virtio_blk_init();
 	timer_init();
 	uart_puts("timer is done!\n");
 	sched_init();
+	bcache_init();
 
 	os_main();
 	uart_puts("task create is done!\n");
@@ -0,0 +1,163 @@
+#include "../os.h"
+
+/*
+ * 内存和字符串函数
+ * 内核用 -nostdlib -fno-builtin 编译，没有C库，这里实现内核使用的部分。
+ * 地址对齐时按字(4字节)操作并展开循环，不对齐的头部和尾部逐字节处理。
+ * 读取时可能读到结尾之后同一个对齐字中的字节，对齐的字不会跨页，不会引起访问异常。
+ */
+
+#define WORD_ONES  0x01010101u
+#define WORD_HIGHS 0x80808080u
+//字中是否有为0的字节
+#define WORD_HAS_ZERO(w) (((w) - WORD_ONES) & ~(w) & WORD_HIGHS)
+
+void *memset(void *dst, int c, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	uint32_t w = (uint8_t)c * WORD_ONES;
+
+	while (n > 0 && ((uintptr_t)d & 3)) {
+		*d++ = (uint8_t)c;
+		n--;
+	}
+	uint32_t *wd = (uint32_t *)d;
+	for (; n >= 16; n -= 16, wd += 4) {
+		wd[0] = w;
+		wd[1] = w;
+		wd[2] = w;
+		wd[3] = w;
+	}
+	for (; n >= 4; n -= 4) {
+		*wd++ = w;
+	}
+	d = (uint8_t *)wd;
+	while (n > 0) {
+		*d++ = (uint8_t)c;
+		n--;
+	}
+	return dst;
+}
+
+void *memcpy(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	//先把目的地址对齐
+	while (n > 0 && ((uintptr_t)d & 3)) {
+		*d++ = *s++;
+		n--;
+	}
+	uint32_t *wd = (uint32_t *)d;
+	uint32_t shift = ((uintptr_t)s & 3) * 8;
+	if (shift == 0) {
+		const uint32_t *ws = (const uint32_t *)s;
+		for (; n >= 16; n -= 16, wd += 4, ws += 4) {
+			wd[0] = ws[0];
+			wd[1] = ws[1];
+			wd[2] = ws[2];
+			wd[3] = ws[3];
+		}
+		for (; n >= 4; n -= 4) {
+			*wd++ = *ws++;
+		}
+		s = (const uint8_t *)ws;
+	} else if (n >= 4) {
+		//源地址不对齐：按对齐的字读取，移位拼接成目的字(小端)，避免不对齐的访问
+		const uint32_t *ws = (const uint32_t *)((uintptr_t)s & ~3);
+		uint32_t cur = *ws++;
+		uint32_t copied = 0;
+		for (; n >= 4; n -= 4, copied += 4) {
+			uint32_t next = *ws++;
+			*wd++ = (cur >> shift) | (next << (32 - shift));
+			cur = next;
+		}
+		s += copied;
+	}
+	d = (uint8_t *)wd;
+	while (n > 0) {
+		*d++ = *s++;
+		n--;
+	}
+	return dst;
+}
+
+void *memmove(void *dst, const void *src, size_t n)
+{
+	uint8_t *d = (uint8_t *)dst;
+	const uint8_t *s = (const uint8_t *)src;
+
+	//目的在源之前或者不重叠时，memcpy 从前往后复制，先读后写，是安全的
+	if (d <= s || d >= s + n) {
+		return memcpy(dst, src, n);
+	}
+	//目的在源之后并且重叠，从后往前复制
+	d += n;
+	s += n;
+	if ((((uintptr_t)d ^ (uintptr_t)s) & 3) == 0) {
+		while (n > 0 && ((uintptr_t)d & 3)) {
+			*--d = *--s;
+			n--;
+		}
+		for (; n >= 4; n -= 4) {
+			d -= 4;
+			s -= 4;
+			*(uint32_t *)d = *(const uint32_t *)s;
+		}
+	}
+	while (n > 0) {
+		*--d = *--s;
+		n--;
+	}
+	return dst;
+}
+
+int memcmp(const void *a, const void *b, size_t n)
+{
+	const uint8_t *p = (const uint8_t *)a;
+	const uint8_t *q = (const uint8_t *)b;
+
+	//两个地址同样对齐时按字比较，找到不同的字之后再逐字节比较
+	if ((((uintptr_t)p ^ (uintptr_t)q) & 3) == 0) {
+		while (n > 0 && ((uintptr_t)p & 3)) {
+			if (*p != *q) {
+				return *p - *q;
+			}
+			p++;
+			q++;
+			n--;
+		}
+		for (; n >= 4 && *(const uint32_t *)p == *(const uint32_t *)q; n -= 4) {
+			p += 4;
+			q += 4;
+		}
+	}
+	for (; n > 0; n--, p++, q++) {
+		if (*p != *q) {
+			return *p - *q;
+		}
+	}
+	return 0;
+}
+
+size_t strlen(const char *str)
+{
+	const char *s = str;
+
+	while ((uintptr_t)s & 3) {
+		if (*s == 0) {
+			return s - str;
+		}
+		s++;
+	}
+	const uint32_t *w = (const uint32_t *)s;
+	while (!WORD_HAS_ZERO(*w)) {
+		w++;
+	}
+	s = (const char *)w;
+	while (*s) {
+		s++;
+	}
+	return s - str;
+}
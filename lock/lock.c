@@ -10,7 +10,11 @@ int spin_lock(struct spinlock* lk)
 {
 	//w_mstatus(r_mstatus() & ~MSTATUS_MIE);
 	
-	while(__sync_lock_test_and_set(&(lk->locked), 1) != 0);
+	uint32_t spins = 0;
+	while(__sync_lock_test_and_set(&(lk->locked), 1) != 0){
+		spins++;
+	}
+	trace_event(TRACE_EV_LOCK, (uint32_t)(uintptr_t)lk, spins);
 
 	return 0;
 }
@@ -18,6 +22,36 @@ int spin_lock(struct spinlock* lk)
 int spin_unlock(struct spinlock* lk)
 {
 	//w_mstatus(r_mstatus() | MSTATUS_MIE);
-	lk->locked = 0;
+	//带屏障的释放，开启优化后临界区内的读写不会被移到释放之后
+	__sync_lock_release(&(lk->locked));
 	return 0;
 }
+
+void sleeplock_init(struct sleeplock* lk)
+{
+	lk->locked = 0;
+	lk->waiters = 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	获得睡眠锁，锁被占用时阻塞，直到持有者释放.
+ * 	sys_wait 在中断上下文中检查 locked，释放锁和阻塞之间不会丢失唤醒。
+ */
+void sleep_lock(struct sleeplock* lk)
+{
+	while (__sync_lock_test_and_set(&lk->locked, 1) != 0) {
+		__sync_fetch_and_add(&lk->waiters, 1);
+		sys_wait(&lk->locked, 1);
+		__sync_fetch_and_sub(&lk->waiters, 1);
+	}
+}
+
+void sleep_unlock(struct sleeplock* lk)
+{
+	__sync_lock_release(&lk->locked);
+	//没有等待者时不需要进入内核
+	if (lk->waiters) {
+		sys_wake(&lk->locked);
+	}
+}
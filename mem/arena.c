@@ -0,0 +1,166 @@
+#include "../os.h"
+
+/*
+ * 区域(arena)分配器
+ * 从 page_alloc 申请的页块中按指针递增分配，对象不能单独释放，只能一次性释放整个区域。
+ * 适合先分配大量小对象、之后整体丢弃的场景，例如短生命周期的工作任务。
+ * 每个页块的开头是 arena_chunk，区域本身放在第一个页块中，不需要 my_malloc。
+ */
+
+/* 普通页块的页数，超过一个页块的对象单独分配页块 */
+#define ARENA_CHUNK_PAGES 1
+#define ARENA_ALIGN 8
+#define _ARENA_ROUND(x) (((x) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+struct arena_chunk {
+	struct arena_chunk* next;
+	uint32_t npages;
+};
+
+struct arena {
+	struct arena_chunk* chunks; // 页块链表，最新的在前，最后一个是区域所在的页块
+	char* cur;       // 当前页块中下一个可分配的地址
+	char* end;       // 当前页块的末尾
+	uint32_t bytes;  // 已分配的字节数
+	uint32_t npages; // 占用的页数
+};
+
+#define CHUNK_HDR _ARENA_ROUND(sizeof(struct arena_chunk))
+#define ARENA_HDR _ARENA_ROUND(sizeof(struct arena))
+
+//区域所在的第一个页块
+static inline struct arena_chunk* _first_chunk(struct arena* a)
+{
+	return (struct arena_chunk*)((char*)a - CHUNK_HDR);
+}
+
+/*
+ * DESCRIPTION
+ * 	创建一个空的区域，占用一页.
+ * RETURN VALUE
+ * 	新的区域，内存不足时返回NULL
+ */
+struct arena* arena_create(void)
+{
+	struct arena_chunk* c = page_alloc(ARENA_CHUNK_PAGES);
+	if (c == NULL) {
+		return NULL;
+	}
+	c->next = NULL;
+	c->npages = ARENA_CHUNK_PAGES;
+	struct arena* a = (struct arena*)((char*)c + CHUNK_HDR);
+	a->chunks = c;
+	a->cur = (char*)a + ARENA_HDR;
+	a->end = (char*)c + ARENA_CHUNK_PAGES * PAGE_SIZE;
+	a->bytes = 0;
+	a->npages = ARENA_CHUNK_PAGES;
+	return a;
+}
+
+/*
+ * DESCRIPTION
+ * 	从区域中分配 size 字节，按8字节对齐，内容未初始化.
+ * 	当前页块不够时申请新的页块，当前页块剩余的部分被丢弃；
+ * 	大于一个页块的对象单独使用一个页块，当前页块继续使用。
+ * RETURN VALUE
+ * 	分配的内存，内存不足时返回NULL
+ */
+void* arena_alloc(struct arena* a, size_t size)
+{
+	//避免下面计算页数时溢出
+	if (size > (uint32_t)-1 - CHUNK_HDR - PAGE_SIZE) {
+		return NULL;
+	}
+	size = _ARENA_ROUND(size);
+	if (size <= (uint32_t)(a->end - a->cur)) {
+		void* p = a->cur;
+		a->cur += size;
+		a->bytes += size;
+		return p;
+	}
+	uint32_t npages = (size + CHUNK_HDR + PAGE_SIZE - 1) / PAGE_SIZE;
+	int big = npages > ARENA_CHUNK_PAGES;
+	if (!big) {
+		npages = ARENA_CHUNK_PAGES;
+	}
+	struct arena_chunk* c = page_alloc(npages);
+	if (c == NULL) {
+		return NULL;
+	}
+	c->next = a->chunks;
+	c->npages = npages;
+	a->chunks = c;
+	a->npages += npages;
+	a->bytes += size;
+	if (!big) {
+		a->cur = (char*)c + CHUNK_HDR + size;
+		a->end = (char*)c + npages * PAGE_SIZE;
+	}
+	return (char*)c + CHUNK_HDR;
+}
+
+/*
+ * DESCRIPTION
+ * 	释放区域中的所有对象，只保留区域所在的第一个页块，区域可以继续使用.
+ */
+void arena_reset(struct arena* a)
+{
+	struct arena_chunk* first = _first_chunk(a);
+	struct arena_chunk* c = a->chunks;
+	while (c != first) {
+		struct arena_chunk* next = c->next;
+		page_free(c);
+		c = next;
+	}
+	a->chunks = first;
+	a->cur = (char*)a + ARENA_HDR;
+	a->end = (char*)first + first->npages * PAGE_SIZE;
+	a->bytes = 0;
+	a->npages = first->npages;
+}
+
+/*
+ * DESCRIPTION
+ * 	释放整个区域，释放的次数只和页块数有关，和对象的个数无关.
+ */
+void arena_destroy(struct arena* a)
+{
+	if (a == NULL) {
+		return;
+	}
+	struct arena_chunk* c = a->chunks;
+	while (c) {
+		//区域本身在最后一个页块中，释放它之前已经读出了 next
+		struct arena_chunk* next = c->next;
+		page_free(c);
+		c = next;
+	}
+}
+
+//区域已分配的字节数和占用的页数
+void arena_get_usage(struct arena* a, uint32_t* bytes, uint32_t* npages)
+{
+	*bytes = a->bytes;
+	*npages = a->npages;
+}
+
+extern TaskNode* task_global_ptr;
+
+/*
+ * DESCRIPTION
+ * 	从当前任务的区域中分配内存，第一次调用时创建区域.
+ * 	内存不能单独释放，任务退出或重启时整体释放。只供内核任务使用。
+ * RETURN VALUE
+ * 	分配的内存，内存不足时返回NULL
+ */
+void* task_alloc(size_t size)
+{
+	TaskNode* task_node = task_global_ptr;
+	if (task_node->arena == NULL) {
+		task_node->arena = arena_create();
+		if (task_node->arena == NULL) {
+			return NULL;
+		}
+	}
+	return arena_alloc(task_node->arena, size);
+}
@@ -3,27 +3,37 @@
 /*
  * Following global vars are defined in mem.S
  */
-extern uint32_t TEXT_START;
-extern uint32_t TEXT_END;
-extern uint32_t DATA_START;
-extern uint32_t DATA_END;
-extern uint32_t RODATA_START;
-extern uint32_t RODATA_END;
-extern uint32_t BSS_START;
-extern uint32_t BSS_END;
-extern uint32_t HEAP_START;
-extern uint32_t HEAP_SIZE;
+extern uintptr_t TEXT_START;
+extern uintptr_t TEXT_END;
+extern uintptr_t DATA_START;
+extern uintptr_t DATA_END;
+extern uintptr_t RODATA_START;
+extern uintptr_t RODATA_END;
+extern uintptr_t UTEXT_START;
+extern uintptr_t UTEXT_END;
+extern uintptr_t UDATA_START;
+extern uintptr_t UDATA_END;
+extern uintptr_t ROMFS_START;
+extern uintptr_t ROMFS_END;
+extern uintptr_t BSS_START;
+extern uintptr_t BSS_END;
+extern uintptr_t HEAP_START;
+extern uintptr_t HEAP_SIZE;
 
 /*
  * _alloc_start points to the actual start address of heap pool
  * _alloc_end points to the actual end address of heap pool
  * _num_pages holds the actual max number of pages we can allocate.
  */
-static uint32_t _alloc_start = 0;
-static uint32_t _alloc_end = 0;
+static uintptr_t _alloc_start = 0;
+static uintptr_t _alloc_end = 0;
 static uint32_t _num_pages = 0;
+/*
+ * 已经清零的页描述符个数，之后的描述符在 page_alloc 第一次扫描到时才清零，
+ * 启动时间不再随内存大小增长
+ */
+static uint32_t _num_cleared = 0;
 
-static uint32_t _allocd_page_end = 0;
 static uint32_t _mlloc_initialized = 0;     // 初始化malloc标志
 void *managed_memory_start;  // 指向堆底（内存块起始位置）
 void *last_valid_address;    // 指向堆顶
@@ -35,9 +45,11 @@ struct mem_control_block {
   uint8_t is_used; // 是否可用（如果还没被分配出去，就是 0）
 };
 
-#define PAGE_SIZE 4096
 #define PAGE_ORDER 12
 
+/* 字节级内存管理使用的页数，在 malloc_init 中从 page_alloc 一次性申请 */
+#define MALLOC_PAGES CONFIG_MALLOC_PAGES
+
 #define PAGE_TAKEN (uint8_t)(1 << 0)
 #define PAGE_LAST  (uint8_t)(1 << 1)
 
@@ -79,12 +91,33 @@ static inline int _is_last(struct Page *page)
 	}
 }
 
+/* 页描述符每次按需清零的个数 */
+#define PAGE_CLEAR_BATCH 256
+
+/*
+ * 第i个页描述符，按需清零
+ * page_alloc 从低地址向高地址扫描，之前的描述符都已经清零
+ */
+static inline struct Page *_page(uint32_t i)
+{
+	struct Page *page = (struct Page *)HEAP_START;
+	if (_num_cleared <= i) {
+		uint32_t n = (i / PAGE_CLEAR_BATCH + 1) * PAGE_CLEAR_BATCH;
+		if (n > _num_pages) {
+			n = _num_pages;
+		}
+		memset(&page[_num_cleared], 0, (n - _num_cleared) * sizeof(struct Page));
+		_num_cleared = n;
+	}
+	return &page[i];
+}
+
 /*
  * align the address to the border of page(4K)
  */
-static inline uint32_t _align_page(uint32_t address)
+static inline uintptr_t _align_page(uintptr_t address)
 {
-	uint32_t order = (1 << PAGE_ORDER) - 1;
+	uintptr_t order = (1 << PAGE_ORDER) - 1;
 	return (address + order) & (~order);
 }
 
@@ -97,18 +130,17 @@ void page_init()
 	_num_pages = (HEAP_SIZE / PAGE_SIZE) - 8;
 	printf("HEAP_START = %x, HEAP_SIZE = %x, num of pages = %d\n", HEAP_START, HEAP_SIZE, _num_pages);
 	
-	struct Page *page = (struct Page *)HEAP_START;
-	for (int i = 0; i < _num_pages; i++) {
-		_clear(page);
-		page++;	
-	}
+	_num_cleared = 0;
 
 	_alloc_start = _align_page(HEAP_START + 8 * PAGE_SIZE);
 	_alloc_end = _alloc_start + (PAGE_SIZE * _num_pages);
 
 	printf("TEXT:   0x%x -> 0x%x\n", TEXT_START, TEXT_END);
 	printf("RODATA: 0x%x -> 0x%x\n", RODATA_START, RODATA_END);
+	printf("ROMFS:  0x%x -> 0x%x\n", ROMFS_START, ROMFS_END);
 	printf("DATA:   0x%x -> 0x%x\n", DATA_START, DATA_END);
+	printf("UTEXT:  0x%x -> 0x%x\n", UTEXT_START, UTEXT_END);
+	printf("UDATA:  0x%x -> 0x%x\n", UDATA_START, UDATA_END);
 	printf("BSS:    0x%x -> 0x%x\n", BSS_START, BSS_END);
 	printf("HEAP:   0x%x -> 0x%x\n", _alloc_start, _alloc_end);
 }
@@ -119,23 +151,24 @@ void page_init()
  */
 void *page_alloc(int npages)
 {
+	if (!trap_context()) {
+		return (void *)sys_mem(MEM_PAGE_ALLOC, npages, 0);
+	}
 	/* Note we are searching the page descriptor bitmaps. */
 	int found = 0;
-	struct Page *page_i = (struct Page *)HEAP_START;
 	for (int i = 0; i <= (_num_pages - npages); i++) {
+		struct Page *page_i = _page(i);
 		if (_is_free(page_i)) {
 			found = 1;
 			/* 
 			 * meet a free page, continue to check if following
 			 * (npages - 1) pages are also unallocated.
 			 */
-			struct Page *page_j = page_i + 1;
 			for (int j = i + 1; j < (i + npages); j++) {
-				if (!_is_free(page_j)) {
+				if (!_is_free(_page(j))) {
 					found = 0;
 					break;
 				}
-				page_j++;
 			}
 			/*
 			 * get a memory block which is good enough for us,
@@ -153,7 +186,6 @@ void *page_alloc(int npages)
 				return (void *)(_alloc_start + i * PAGE_SIZE);
 			}
 		}
-		page_i++;
 	}
 	return NULL;
 }
@@ -164,15 +196,19 @@ void *page_alloc(int npages)
  */
 void page_free(void *p)
 {
+	if (!trap_context()) {
+		sys_mem(MEM_PAGE_FREE, (reg_t)p, 0);
+		return;
+	}
 	/*
 	 * Assert (TBD) if p is invalid
 	 */
-	if (!p || (uint32_t)p >= _alloc_end) {
+	if (!p || (uintptr_t)p >= _alloc_end) {
 		return;
 	}
 	/* get the first page descriptor of this memory block */
 	struct Page *page = (struct Page *)HEAP_START;
-	page += ((uint32_t)p - _alloc_start)/ PAGE_SIZE;
+	page += ((uintptr_t)p - _alloc_start)/ PAGE_SIZE;
 	/* loop and clear all the page descriptors of the memory block */
 	while (!_is_free(page)) {
 		if (_is_last(page)) {
@@ -185,289 +221,665 @@ void page_free(void *p)
 	}
 }
 
+/*
+ * 字节级内存管理
+ * 每个内存块的头部和尾部各有一个内存控制块，记录整个块的大小(包括两个控制块)和是否已分配，
+ * 释放时通过前一个块的尾部和后一个块的头部找到相邻的块，空闲的相邻块立即合并。
+ * 初始化时整个堆是一个空闲块，分配时按首次适应查找，剩余部分足够大时切分出新的空闲块。
+ */
+#define MCB_SIZE sizeof(struct mem_control_block)
+/* 返回的地址和块的大小按8字节对齐 */
+#define MALLOC_ALIGN 8
+/* 最小的块：两个控制块和8字节的数据，更小的剩余部分不切分 */
+#define MIN_BLOCK (2 * MCB_SIZE + MALLOC_ALIGN)
+/* 为1时 my_free 输出合并前后的内存块信息，发现重复释放或越界写时 panic */
+#define MALLOC_DEBUG 0
+
+/* 堆的统计，空闲块的个数和最大的空闲块在 heap_get_stats 中遍历得到 */
+static uint32_t _heap_used;     // 已分配块的字节数，包括控制块
+static uint32_t _heap_peak;     // _heap_used 的最大值
+static uint32_t _heap_allocs;
+static uint32_t _heap_frees;
+static uint32_t _heap_failed;   // 分配失败的次数
+static uint32_t _heap_bad_frees; // 被拒绝的释放和realloc：重复释放、野指针或块的尾部被越界写坏
+/*
+ * 这个地址之后的内存从来没有分配出去过，属于堆中最后一个空闲块，除了它的控制块之外内容不确定；
+ * 之前的部分在第一次分配出去时清零过
+ */
+static char *_heap_fresh;
+
+static inline struct mem_control_block *_mcb_tail(struct mem_control_block *head)
+{
+	return (struct mem_control_block *)((char *)head + head->size - MCB_SIZE);
+}
+
+//设置内存块的头部和尾部
+static inline void _mcb_set(char *head, uint32_t size, uint8_t is_used)
+{
+	struct mem_control_block *mcb = (struct mem_control_block *)head;
+	mcb->size = size;
+	mcb->is_used = is_used;
+	mcb = _mcb_tail(mcb);
+	mcb->size = size;
+	mcb->is_used = is_used;
+}
+
 /*
  * 字节为单位的malloc的初始化
  */
 void malloc_init() {
 	// 首先要进行page的初始化，得到_alloc_start 和 _alloc_end
 	page_init();
-	// 这里不向操作系统申请堆空间，只是为了获取堆的起始地址和最后有效地址
-	last_valid_address = (void *)_alloc_end; // 堆的最后有效地址last_valid_address
-	managed_memory_start = (void *)_alloc_start; //堆的起始地址managed_memory_start
-	
+	// 从页分配器申请堆空间，避免和 page_alloc 分配出去的页重叠
+	managed_memory_start = page_alloc(MALLOC_PAGES); //堆的起始地址managed_memory_start
+	last_valid_address = managed_memory_start + MALLOC_PAGES * PAGE_SIZE; // 堆的最后有效地址last_valid_address
+	// 不在启动时清零整个堆，分配时由 _heap_grow 逐步清零
+	_heap_fresh = managed_memory_start;
+	// 整个堆是一个空闲块，只需要写头尾两个控制块
+	_mcb_set(managed_memory_start, MALLOC_PAGES * PAGE_SIZE, 0);
+
 	_mlloc_initialized = 1;
 }
 
+//包含两个内存控制块的块大小，numbytes 超过整个堆时返回一个不可能满足的大小
+static inline uint32_t _block_size(size_t numbytes)
+{
+	if (numbytes > MALLOC_PAGES * PAGE_SIZE) {
+		return 0xffffffff;
+	}
+	uint32_t size = ((numbytes + MALLOC_ALIGN - 1) & ~(MALLOC_ALIGN - 1)) + 2 * MCB_SIZE;
+	return size < MIN_BLOCK ? MIN_BLOCK : size;
+}
+
+/*
+ * 分配出去的内存延伸到 end 之前，把其中从未分配过的部分清零
+ * 会覆盖 [_heap_fresh, end) 中的控制块，必须在读取它们之后、写入新的控制块之前调用
+ */
+static inline void _heap_grow(char *end)
+{
+	if (end > _heap_fresh) {
+		memset(_heap_fresh, 0, end - _heap_fresh);
+		_heap_fresh = end;
+	}
+}
+
+//从 size 字节的空闲块中分配 want 字节时，分配出去的部分加上切分出的空闲块头部的长度
+static inline uint32_t _grow_size(uint32_t size, uint32_t want)
+{
+	return size - want < MIN_BLOCK ? size : want + MCB_SIZE;
+}
+
+/*
+ * 头部必须是已分配的块，尾部必须和头部一致，否则是重复释放、野指针或越界写.
+ * 这样的块被拒绝，避免把堆进一步破坏
+ */
+static int _block_valid(char *head)
+{
+	struct mem_control_block *mcb = (struct mem_control_block *)head;
+
+	//先确认头部在堆中，再读取头部；确认大小不越界之后才读取尾部
+	if (head < (char *)managed_memory_start || head >= (char *)last_valid_address ||
+		(uintptr_t)head % MALLOC_ALIGN || mcb->is_used != 1 ||
+		mcb->size < MIN_BLOCK || mcb->size > (uint32_t)((char *)last_valid_address - head) ||
+		_mcb_tail(mcb)->size != mcb->size || _mcb_tail(mcb)->is_used != 1) {
+		_heap_bad_frees++;
+#if MALLOC_DEBUG
+		printf("malloc: bad block 0x%x\n", head + MCB_SIZE);
+		panic("malloc");
+#endif
+		return 0;
+	}
+	return 1;
+}
+
+/*
+ * 把 head 开始的 size 字节设为空闲块，和前后相邻的空闲块合并
+ * 返回合并后的块的头部
+ */
+static char *_merge_free(char *head, uint32_t size)
+{
+	// 后面的内存块空闲，合并
+	struct mem_control_block *next = (struct mem_control_block *)(head + size);
+	if ((char *)next < (char *)last_valid_address && !next->is_used) {
+		size += next->size;
+	}
+	// 前面的内存块空闲，合并，前一个块的尾部就在当前块的头部之前
+	if (head > (char *)managed_memory_start) {
+		struct mem_control_block *pre_tail = (struct mem_control_block *)(head - MCB_SIZE);
+		if (!pre_tail->is_used) {
+			head -= pre_tail->size;
+			size += pre_tail->size;
+		}
+	}
+	_mcb_set(head, size, 0);
+	return head;
+}
+
+//已分配的块缩小到 size，剩余部分足够大时切分成新的空闲块
+static void _shrink(char *head, uint32_t size)
+{
+	uint32_t old = ((struct mem_control_block *)head)->size;
+	if (old - size < MIN_BLOCK) {
+		return;
+	}
+	_mcb_set(head, size, 1);
+	_heap_used -= old - size;
+	_merge_free(head + size, old - size);
+}
+
+/*
+ * 页分配器和堆没有锁，它们的数据结构只在不会被抢占的上下文中修改：
+ * 启动过程和trap处理中(trap_context() 为1)直接执行，task_reap、页错误处理可以直接分配和释放；
+ * 任务中调用时通过 SYS_MEM 进入trap再执行，不会在查找空闲块或者合并的中途被抢占。
+ * 返回之后分配到的内存属于调用者，读写它不需要进入trap。
+ */
 void *my_malloc(size_t numbytes) {
-	char *current_location;  // 当前访问的内存位置
-	char *current_location_tail;  // 当前访问的内存块的末尾位置
-	struct mem_control_block *current_location_mcb;  // 只是作了一个强制类型转换
-	struct mem_control_block *current_location_mcb_tail;
-	
-	void *memory_location;  // 这是要返回的内存位置。初始时设为
-							// 0，表示没有找到合适的位置
+	if (!trap_context()) {
+		return (void *)sys_mem(MEM_MALLOC, numbytes, 0);
+	}
 	if (!_mlloc_initialized) {
 		malloc_init();
 	}
 	// 要查找的内存必须包含内存控制块，所以需要调整 numbytes 的大小
-	numbytes = numbytes + 2 * sizeof(struct mem_control_block);
-	// 初始时设为 0，表示没有找到合适的位置
-	memory_location = 0;
-	/* Begin searching at the start of managed memory */
-	// 从被管理内存的起始位置开始搜索
-	// managed_memory_start 是在 malloc_init 中通过 sbrk() 函数设置的
-	current_location = managed_memory_start;
-	while (current_location < last_valid_address) {
-		// current_location 是一个 void 指针，用来计算地址；
-		// current_location_mcb 是一个具体的结构体类型
-		// 这两个实际上是一个含义
-		current_location_mcb = (struct mem_control_block *)current_location;
-		
-		if (!current_location_mcb->is_used) {
-			if((current_location_mcb->size == 0) || (current_location_mcb->size != 0 && current_location_mcb->size >= numbytes))
-			{
-				// 找到一个新的内存块
-				/*
-				if((current_location_mcb->size != 0 && current_location_mcb->size >= numbytes)){
-					char *_tail = current_location + current_location_mcb->size - sizeof(struct mem_control_block);
-					struct mem_control_block * _mcb_tail = (struct mem_control_block *)_tail;
-					_mcb_tail->is_used = 0;
-					_mcb_tail->size = 0;
-				}
-				*/
-								
-				
+	uint32_t size = _block_size(numbytes);
 
-				current_location_mcb->is_used = 1;  // 设为不可用
-				current_location_mcb->size = numbytes;
-
-				memory_location = current_location;      // 设置内存地址
+	// 从被管理内存的起始位置开始，按首次适应查找空闲块
+	for (char *cur = managed_memory_start; cur < (char *)last_valid_address; cur += ((struct mem_control_block *)cur)->size) {
+		struct mem_control_block *mcb = (struct mem_control_block *)cur;
+		if (mcb->is_used || mcb->size < size) {
+			continue;
+		}
+		uint32_t bsize = mcb->size;
+		_heap_grow(cur + _grow_size(bsize, size));
+		_mcb_set(cur, bsize, 1);
+		_heap_used += bsize;
+		_shrink(cur, size);
+		_heap_allocs++;
+		if (_heap_used > _heap_peak) {
+			_heap_peak = _heap_used;
+		}
+		// 内存控制块对于用户而言应该是透明的，因此返回指针前，跳过内存控制块
+		return cur + MCB_SIZE;
+	}
+	// 堆的大小固定为 MALLOC_PAGES 页，不再扩展
+	_heap_failed++;
+	return NULL;
+}
 
-				current_location_tail = current_location + numbytes - sizeof(struct mem_control_block);
-				current_location_mcb_tail = (struct mem_control_block *)current_location_tail;
-				current_location_mcb_tail->is_used = 1;  // 设为不可用
-				current_location_mcb_tail->size = numbytes;
-				
+void my_free(void *ptr) {  // ptr 是要回收的空间
+	if (ptr == NULL) {
+		return;
+	}
+	if (!trap_context()) {
+		sys_mem(MEM_FREE, (reg_t)ptr, 0);
+		return;
+	}
+	char *head = (char *)ptr - MCB_SIZE; // 找到该内存块的控制信息的地址
+	struct mem_control_block *mcb = (struct mem_control_block *)head;
 
-				break;
-			}
-		}
-		// 否则，当前内存块不可用或过小，移动到下一个内存块
-		current_location = current_location + current_location_mcb->size;
+	//ptr 可能不是 my_malloc 返回的地址，检查通过之前不能读取控制信息
+	if (!_block_valid(head)) {
+		return;
 	}
-	
-	// 循环结束，没有找到合适的位置，需要向操作系统申请更多内存，但是在本系统里不会涉及拓展的问题
-	if (!memory_location) {
-		printf("RVOS need create a new page!!\n");
-		
-		// 扩展堆page
-		void* page_new = page_alloc(1);
-		_allocd_page_end = (void *)page_new + PAGE_SIZE;
-		
-		// 新的内存的起始位置就是 last_valid_address 的旧值
-		memory_location = (void *)page_new;
-		// 将 last_valid_address 后移 numbytes，移动到整个内存的最右边界
-		//last_valid_address = last_valid_address + numbytes;
-		last_valid_address = (void *)_allocd_page_end;
-		// 初始化内存控制块 mem_control_block
-		current_location_mcb = memory_location;
-		current_location_mcb->is_used = 1;
-		current_location_mcb->size = numbytes;
-	}
-	// 最终，memory_location 保存了大小为 numbyte的内存空间，
-	// 并且在空间的开始处包含了一个内存控制块，记录了元信息
-	// 内存控制块对于用户而言应该是透明的，因此返回指针前，跳过内存分配块
-	memory_location = memory_location + sizeof(struct mem_control_block);
-	// 返回内存块的指针
-	return memory_location;
+	uint32_t size = mcb->size;
+	// 先清除头部的分配标志，这个块被合并到前一个块之后，再次释放也能被发现
+	mcb->is_used = 0;
+	_heap_frees++;
+	_heap_used -= size;
+
+#if MALLOC_DEBUG
+	printf("ptr: 0x%x, size: %d\n", ptr, size);
+#endif
+	head = _merge_free(head, size);
+#if MALLOC_DEBUG
+	printf("ptr: 0x%x, merged block 0x%x, size: %d\n", ptr, head, ((struct mem_control_block *)head)->size);
+#endif
 }
 
-uint8_t pre_is_used(void *ptr){
-	struct mem_control_block *pre_mem_tail = ptr - 2*sizeof(struct mem_control_block);
-	return pre_mem_tail->is_used;
+/*
+ * DESCRIPTION
+ * 	分配 nmemb 个 size 字节的元素并清零.
+ * 	分配到的内存中从未分配过的部分(_heap_fresh 之后)已经在 my_malloc 中清零，只需要清零之前的部分。
+ * RETURN VALUE
+ * 	分配的内存，失败或者大小溢出时返回NULL
+ */
+void *my_calloc(size_t nmemb, size_t size)
+{
+	if (size && nmemb > (size_t)-1 / size) {
+		return NULL;
+	}
+	//判断哪些部分需要清零和分配必须一起完成
+	if (!trap_context()) {
+		return (void *)sys_mem(MEM_CALLOC, nmemb, size);
+	}
+	if (!_mlloc_initialized) {
+		malloc_init();
+	}
+	uint32_t n = nmemb * size;
+	char *fresh = _heap_fresh;
+	char *p = my_malloc(n);
+	if (p == NULL || p >= fresh) {
+		return p;
+	}
+	char *end = p + n < fresh ? p + n : fresh;
+	memset(p, 0, end - p);
+	return p;
 }
 
-uint8_t pre_mem_size(void *ptr){
-	struct mem_control_block *pre_mem_tail = ptr - 2*sizeof(struct mem_control_block);
-	return pre_mem_tail->size;
+/*
+ * DESCRIPTION
+ * 	改变 ptr 指向的内存的大小，保留原来的内容.
+ * 	缩小时把多余的部分切分成空闲块；扩大时如果后面的块空闲并且足够大，直接合并进来，
+ * 	否则重新分配并复制。ptr 为NULL时相当于 my_malloc，numbytes 为0时相当于 my_free。
+ * RETURN VALUE
+ * 	新的地址，失败时返回NULL，原来的内存不变
+ */
+void *my_realloc(void *ptr, size_t numbytes)
+{
+	if (!trap_context()) {
+		return (void *)sys_mem(MEM_REALLOC, (reg_t)ptr, numbytes);
+	}
+	if (ptr == NULL) {
+		return my_malloc(numbytes);
+	}
+	if (numbytes == 0) {
+		my_free(ptr);
+		return NULL;
+	}
+	char *head = (char *)ptr - MCB_SIZE;
+	struct mem_control_block *mcb = (struct mem_control_block *)head;
+	uint32_t size = _block_size(numbytes);
+
+	if (!_block_valid(head)) {
+		return NULL;
+	}
+	if (size <= mcb->size) {
+		_shrink(head, size);
+		return ptr;
+	}
+
+	// 原地扩大：后面的块空闲时，两个块加起来足够大就合并，再切掉多余的部分
+	struct mem_control_block *next = (struct mem_control_block *)(head + mcb->size);
+	if ((char *)next < (char *)last_valid_address && !next->is_used &&
+		next->size >= size - mcb->size) {
+		uint32_t total = mcb->size + next->size;
+		_heap_used += next->size;
+		_heap_grow(head + _grow_size(total, size));
+		_mcb_set(head, total, 1);
+		_shrink(head, size);
+		if (_heap_used > _heap_peak) {
+			_heap_peak = _heap_used;
+		}
+		return ptr;
+	}
+
+	void *p = my_malloc(numbytes);
+	if (p == NULL) {
+		return NULL;
+	}
+	memcpy(p, ptr, mcb->size - 2 * MCB_SIZE);
+	my_free(ptr);
+	return p;
 }
 
-uint8_t next_is_used(void *ptr){
-	struct mem_control_block *mem_head = ptr - sizeof(struct mem_control_block);
-	struct mem_control_block *next_mem_head = ptr - sizeof(struct mem_control_block) + mem_head->size;
-	return next_mem_head->is_used;
+/*
+ * DESCRIPTION
+ * 	分配按 align 对齐的内存，用于DMA缓冲区和按cache line对齐的数据.
+ * 	多申请 align + MIN_BLOCK 字节，对齐地址之前的部分切分成空闲块，多余的尾部也切掉。
+ * 	返回的内存用 my_free 释放。
+ * RETURN VALUE
+ * 	分配的内存，失败或者 align 不是2的幂时返回NULL
+ */
+void *my_aligned_alloc(size_t align, size_t numbytes)
+{
+	if (align == 0 || (align & (align - 1))) {
+		return NULL;
+	}
+	if (!trap_context()) {
+		return (void *)sys_mem(MEM_ALIGNED, align, numbytes);
+	}
+	if (align <= MALLOC_ALIGN) {
+		return my_malloc(numbytes);
+	}
+	if (numbytes > MALLOC_PAGES * PAGE_SIZE || align > MALLOC_PAGES * PAGE_SIZE) {
+		_heap_failed++;
+		return NULL;
+	}
+	char *p = my_malloc(numbytes + align + MIN_BLOCK);
+	if (p == NULL || (uintptr_t)p % align == 0) {
+		if (p) {
+			_shrink(p - MCB_SIZE, _block_size(numbytes));
+		}
+		return p;
+	}
+	// 对齐地址之前至少留出 MIN_BLOCK 字节，才能切分成空闲块
+	char *a = (char *)(((uintptr_t)p + MIN_BLOCK + align - 1) & ~(align - 1));
+	char *head = p - MCB_SIZE;
+	uint32_t front = a - p;
+	_mcb_set(a - MCB_SIZE, ((struct mem_control_block *)head)->size - front, 1);
+	_heap_used -= front;
+	_merge_free(head, front);
+	_shrink(a - MCB_SIZE, _block_size(numbytes));
+	return a;
 }
 
-uint8_t next_mem_size(void *ptr){
-	struct mem_control_block *mem_head = ptr - sizeof(struct mem_control_block);
-	struct mem_control_block *next_mem_head = ptr - sizeof(struct mem_control_block) + mem_head->size;
-	return next_mem_head->size;
+/*
+ * DESCRIPTION
+ * 	遍历整个堆，检查堆的不变式：
+ * 	- 每个块按 MALLOC_ALIGN 对齐，不小于 MIN_BLOCK，不越过堆的末尾
+ * 	- 块的头部和尾部一致，不一致说明前面的块越界写
+ * 	- 没有两个相邻的空闲块(释放时已经合并)
+ * 	- 所有块正好覆盖整个堆，已分配的字节数和统计一致
+ * 	同时统计空闲块的个数、最大的空闲块和碎片率。stats 可以为NULL.
+ * RETURN VALUE
+ * 	0: 通过
+ * 	-1: 堆被破坏，输出第一个出错的块
+ */
+int heap_get_stats(struct heap_stats *stats)
+{
+	if (!trap_context()) {
+		//trap中不能直接写任务的栈(开启虚拟内存时是任务的虚拟地址)，先写到内核的缓冲区再复制
+		static struct heap_stats buf;
+		static struct sleeplock lock;
+		sleep_lock(&lock);
+		int ret = sys_mem(MEM_HEAP_STATS, (reg_t)&buf, 0);
+		if (stats) {
+			*stats = buf;
+		}
+		sleep_unlock(&lock);
+		return ret;
+	}
+	char *cur = managed_memory_start;
+	int pre_free = 0;
+	uint32_t used = 0, free = 0, free_blocks = 0, largest = 0;
+
+	while (cur < (char *)last_valid_address) {
+		struct mem_control_block *mcb = (struct mem_control_block *)cur;
+		struct mem_control_block *tail;
+		if (mcb->size < MIN_BLOCK || mcb->size % MALLOC_ALIGN ||
+			mcb->size > (uint32_t)((char *)last_valid_address - cur)) {
+			printf("heap: block 0x%x has bad size %d\n", cur, mcb->size);
+			return -1;
+		}
+		tail = _mcb_tail(mcb);
+		if (tail->size != mcb->size || tail->is_used != mcb->is_used) {
+			printf("heap: block 0x%x head and tail differ\n", cur);
+			return -1;
+		}
+		if (pre_free && !mcb->is_used) {
+			printf("heap: free block 0x%x not merged\n", cur);
+			return -1;
+		}
+		if (mcb->is_used) {
+			used += mcb->size;
+		} else {
+			free += mcb->size;
+			free_blocks++;
+			if (mcb->size > largest) {
+				largest = mcb->size;
+			}
+		}
+		pre_free = !mcb->is_used;
+		cur += mcb->size;
+	}
+	if (cur != (char *)last_valid_address) {
+		printf("heap: blocks end at 0x%x\n", cur);
+		return -1;
+	}
+	if (used != _heap_used) {
+		printf("heap: %d bytes in use, expected %d\n", used, _heap_used);
+		return -1;
+	}
+
+	if (stats) {
+		stats->used_bytes = used;
+		stats->peak_bytes = _heap_peak;
+		stats->free_bytes = free;
+		stats->free_blocks = free_blocks;
+		stats->largest_free = largest;
+		// 堆最大 MALLOC_PAGES 页，乘100不会溢出
+		stats->frag_percent = free ? 100 - largest * 100 / free : 0;
+		stats->allocs = _heap_allocs;
+		stats->frees = _heap_frees;
+		stats->failed = _heap_failed;
+		stats->bad_frees = _heap_bad_frees;
+	}
+	return 0;
 }
 
-void my_free(void *ptr) {  // ptr 是要回收的空间
-	struct mem_control_block *free;
-	free = ptr - sizeof(struct mem_control_block); // 找到该内存块的控制信息的地址
-	
-	
-	printf("ptr: 0x%x, pre is used: %d\n", ptr, pre_is_used(ptr));
-	printf("ptr: 0x%x, pre mem size: %d\n", ptr, pre_mem_size(ptr));
-	printf("ptr: 0x%x, next is used: %d\n", ptr, next_is_used(ptr));
-	printf("ptr: 0x%x, next mem size: %d\n", ptr, next_mem_size(ptr));	
-	
+int heap_check(void)
+{
+	return heap_get_stats(NULL);
+}
 
+/*
+ * DESCRIPTION
+ * 	输出堆的统计信息.
+ */
+void heap_report(void)
+{
+	struct heap_stats st;
+	if (heap_get_stats(&st) < 0) {
+		return;
+	}
+	printf("heap: %d used, %d peak, %d free in %d blocks, largest %d, fragmentation %d percent\n",
+		st.used_bytes, st.peak_bytes, st.free_bytes, st.free_blocks, st.largest_free, st.frag_percent);
+	printf("heap: %d allocs, %d frees, %d failed, %d bad frees\n",
+		st.allocs, st.frees, st.failed, st.bad_frees);
+}
 
-	uint8_t preIsUsed = pre_is_used(ptr);
-	uint8_t nextIsUsed = next_is_used(ptr);
-	uint32_t preMemSize = pre_mem_size(ptr);
-	uint32_t nextMemSize = next_mem_size(ptr);
-	if(preIsUsed && !nextIsUsed){
-		// 后面的内存块空闲
-		if(nextMemSize == 0){
-			struct mem_control_block *free_tail = ptr - 2*sizeof(struct mem_control_block) + free->size;
-			free->is_used = 0;  // 该空间置为可用
-			free_tail->is_used = 0;  // 该空间置为可用
-		}else{
-			uint32_t newSize = free->size + nextMemSize;
-			struct mem_control_block *next_mem_tail = ptr - 2*sizeof(struct mem_control_block) + free->size + nextMemSize;
-			struct mem_control_block *next_mem_head = ptr - sizeof(struct mem_control_block) + free->size;
-			struct mem_control_block *free_tail = ptr - 2*sizeof(struct mem_control_block) + free->size;
-
-			next_mem_head->is_used = 0;
-			next_mem_head->size = 0;
-			free_tail->is_used = 0;
-			free_tail->size = 0;
-
-			next_mem_tail->is_used = 0;
-			next_mem_tail->size = newSize;
-			free->is_used = 0;  // 该空间置为可用
-			free->size = newSize;			
-		}
-		
-
-	}else if(!preIsUsed && nextIsUsed){
-		// 前面的内存块空闲
-		if(preMemSize == 0){
-			struct mem_control_block *free_tail = ptr - 2*sizeof(struct mem_control_block) + free->size;
-			free->is_used = 0;
-			free_tail->is_used = 0;  // 该空间置为可用
-		}else{
-			uint32_t newSize = free->size + preMemSize;
-			struct mem_control_block *pre_mem_head = ptr - sizeof(struct mem_control_block) - preMemSize;
-			struct mem_control_block *pre_mem_tail = ptr - 2*sizeof(struct mem_control_block);
-			struct mem_control_block *free_tail = ptr - 2*sizeof(struct mem_control_block) + free->size;
-
-			free->is_used = 0;
-			free->size = 0;	
-			pre_mem_tail->is_used = 0;
-			pre_mem_tail->size = 0;
-
-			pre_mem_head->is_used = 0;
-			pre_mem_head->size = newSize;
-			free_tail->is_used = 0;  // 该空间置为可用
-			free_tail->size = newSize;
+/*
+ * DESCRIPTION
+ * 	检查页描述符：已分配的页中，除了每次分配的最后一页，后面必须紧跟着同一次分配的页.
+ * RETURN VALUE
+ * 	0: 通过
+ * 	-1: 描述符被破坏
+ */
+int page_check(void)
+{
+	if (!trap_context()) {
+		return sys_mem(MEM_PAGE_CHECK, 0, 0);
+	}
+	for (uint32_t i = 0; i < _num_cleared; i++) {
+		struct Page *page = _page(i);
+		if (_is_free(page)) {
+			if (_is_last(page)) {
+				printf("page_check: free page %d marked last\n", i);
+				return -1;
+			}
+			continue;
 		}
-		
-	}else if(!preIsUsed && !nextIsUsed){
-		// 前后的内存块空闲
-		if(nextMemSize == 0 && preMemSize == 0){
-			struct mem_control_block *free_tail = ptr - 2*sizeof(struct mem_control_block) + free->size;
-			free->is_used = 0;  // 该空间置为可用
-			free_tail->is_used = 0;  // 该空间置为可用
-		}else{
-			uint32_t newSize = free->size + preMemSize + nextMemSize;
-			
-			struct mem_control_block *pre_mem_head = ptr - sizeof(struct mem_control_block) - preMemSize;
-			struct mem_control_block *pre_mem_tail = ptr - 2*sizeof(struct mem_control_block);
-			struct mem_control_block *free_tail = ptr - 2*sizeof(struct mem_control_block) + free->size;
-			struct mem_control_block *next_mem_head = ptr - sizeof(struct mem_control_block) + free->size;
-			struct mem_control_block *next_mem_tail = ptr - sizeof(struct mem_control_block) + free->size + nextMemSize;
-
-			pre_mem_tail->is_used = 0;
-			pre_mem_tail->size = 0;
-			free_tail->is_used = 0;
-			free_tail->size = 0;
-			next_mem_head->is_used = 0;
-			next_mem_head->size = 0;
-			
-			pre_mem_head->is_used = 0;
-			pre_mem_head->size = newSize;
-			next_mem_tail->is_used = 0;
-			next_mem_tail->size = newSize;
+		if (!_is_last(page) && (i + 1 >= _num_pages || _is_free(_page(i + 1)))) {
+			printf("page_check: allocation at page %d has no last page\n", i);
+			return -1;
 		}
-		
 	}
+	return 0;
+}
+
+/*
+ * page_test 的随机压力测试：PAGE_TEST_SLOTS 个槽位，每次随机选一个，
+ * 空的就分配并填充该槽位的字节，非空的先检查内容没有被其他分配覆盖再释放
+ */
+/* 在QEMU中运行的次数，make host-test 在主机上运行 1000000 次 */
+#ifndef PAGE_TEST_OPS
+#define PAGE_TEST_OPS 100000
+#endif
+#define PAGE_TEST_SLOTS 64
+#define PAGE_TEST_MAX_BYTES 512
+#define PAGE_TEST_MAX_PAGES 4
+/* 每隔多少次操作检查一次不变式 */
+#define PAGE_TEST_CHECK 1024
+
+struct page_test_slot {
+	uint8_t *p;
+	uint32_t size;
+	int pages;  // 为0时 p 来自 my_malloc，否则来自 page_alloc
+};
 
-	return;
+static int _slot_verify(struct page_test_slot *slot, uint8_t tag)
+{
+	uint32_t step = slot->pages ? PAGE_SIZE / 4 : 1; // 整页只抽查，否则太慢
+	for (uint32_t i = 0; i < slot->size; i += step) {
+		if (slot->p[i] != tag) {
+			return -1;
+		}
+	}
+	return 0;
 }
 
-void showInfo(void *m_p, int blockSize){
-	printf("m_p = 0x%x\n m_p is used: %d, m_p size is %d\n", m_p, ((struct mem_control_block *)(m_p-blockSize))->is_used, \
-		((struct mem_control_block *)(m_p-blockSize))->size);
+static void _slot_fill(struct page_test_slot *slot, uint8_t tag)
+{
+	uint32_t step = slot->pages ? PAGE_SIZE / 4 : 1;
+	for (uint32_t i = 0; i < slot->size; i += step) {
+		slot->p[i] = tag;
+	}
 }
 
-void page_test()
+#if !MALLOC_DEBUG
+/* 重复释放和越界写坏尾部的释放必须被拒绝，并且不破坏堆 */
+static int _bad_free_test(void)
 {
-	printf("PAGE_LAST: 0x%x\n", PAGE_LAST);
-	printf("managed_memory_start: 0x%x\n", managed_memory_start);
-	printf("sizeof(struct mem_control_block): 0x%x\n", sizeof(struct mem_control_block));
-	int blockSize = sizeof(struct mem_control_block);
-	
-	{
-		printf("=======Test backward merge=======\n");
-		void *m_p = my_malloc(32);
-		showInfo(m_p, blockSize);
-		void *m_p1 = my_malloc(32);
-		showInfo(m_p1, blockSize);
-		
-		void *m_p2 = my_malloc(32);
-		showInfo(m_p2, blockSize);
-		
-		printf("m_p = 0x%x, next_mem_size is %d\n", m_p2, next_mem_size(m_p2));
-		my_free(m_p2);
-		printf("m_p = 0x%x, next_mem_size is %d\n", m_p2, next_mem_size(m_p2));
-		my_free(m_p1);
-		//void *m_p3 = my_malloc(32);
-		//showInfo(m_p3, blockSize);
-		//my_free(m_p3);
-		my_free(m_p);
-	}
-
-	void *m_p3 = 0x8000d008;
-	showInfo(m_p3, blockSize);
-
-
-	{
-		// 测试向前合并
-		printf("=======Test forward merge=======\n");
-		void *m_p = my_malloc(32);
-		showInfo(m_p, blockSize);
-		void *m_p1 = my_malloc(32);
-		showInfo(m_p1, blockSize);
-		
-		void *m_p2 = my_malloc(32);
-		showInfo(m_p2, blockSize);
-		my_free(m_p);
-		my_free(m_p1);
-		my_free(m_p2);
-		//void *m_p3 = my_malloc(32);
-		//showInfo(m_p3, blockSize);
-	}
-
-	{
-		// 测试前后合并
-		printf("=======Test back/forward merge=======\n");
-		void *m_p = my_malloc(32);
-		showInfo(m_p, blockSize);
-		void *m_p1 = my_malloc(32);
-		showInfo(m_p1, blockSize);
-		
-		void *m_p2 = my_malloc(2);
-		showInfo(m_p2, blockSize);
-		my_free(m_p);
-		my_free(m_p2);
-		my_free(m_p1);
-		//void *m_p3 = my_malloc(32);
-		//showInfo(m_p3, blockSize);
-	}	
+	struct heap_stats st0, st1;
+	int errors = 0;
+
+	heap_get_stats(&st0);
+	char *p = my_malloc(8);
+	char *q = my_malloc(8);  // 挡在后面，p 释放时不会和后面的空闲块合并
+	my_free(p);
+	my_free(p);
+	// 越界写一个字节，写坏 q 的尾部
+	struct mem_control_block *tail = _mcb_tail((struct mem_control_block *)(q - MCB_SIZE));
+	struct mem_control_block saved = *tail;
+	q[8] = 0x5a;
+	my_free(q);
+	*tail = saved;
+	my_free(q);
+	heap_get_stats(&st1);
+
+	if (st1.bad_frees - st0.bad_frees != 2 || st1.used_bytes != st0.used_bytes || heap_check() < 0) {
+		printf("page_test: bad frees not caught\n");
+		errors++;
+	}
+	return errors;
 }
+#endif
+
+/*
+ * DESCRIPTION
+ * 	my_malloc/my_calloc/my_realloc/my_aligned_alloc/my_free 和 page_alloc/page_free 的随机压力测试.
+ * 	检查分配出去的内存互不重叠，并定期检查堆和页描述符的不变式，
+ * 	最后输出每次操作的平均cycle数。只能在任务中调用，测试结束时释放所有内存。
+ * RETURN VALUE
+ * 	出错的次数
+ */
+static struct page_test_slot slots[PAGE_TEST_SLOTS]; //任务的栈很小，放在bss中
 
+int page_test()
+{
+	uint32_t seed = 1;
+	int errors = 0;
+	uint32_t allocs = 0;
+	uint32_t check_cycles = 0;
+
+	for (int i = 0; i < PAGE_TEST_SLOTS; i++) {
+		slots[i].p = NULL;
+	}
+
+	uint32_t start = ucycle();
+	for (uint32_t op = 0; op < PAGE_TEST_OPS; op++) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t r = seed >> 8;
+		int i = r % PAGE_TEST_SLOTS;
+		struct page_test_slot *slot = &slots[i];
+		uint8_t tag = (uint8_t)(i + 1);
+
+		if (slot->p) {
+			if (_slot_verify(slot, tag) < 0) {
+				printf("page_test: slot %d at 0x%x overwritten\n", i, slot->p);
+				errors++;
+			}
+			if (slot->pages) {
+				page_free(slot->p);
+				slot->p = NULL;
+			} else if ((r >> 21) % 4 == 0) {
+				//改变大小，原来的内容必须保留
+				uint32_t size = 1 + (r >> 12) % PAGE_TEST_MAX_BYTES;
+				uint8_t *p = my_realloc(slot->p, size);
+				if (p) {
+					slot->p = p;
+					slot->size = size < slot->size ? size : slot->size;
+					if (_slot_verify(slot, tag) < 0) {
+						printf("page_test: slot %d lost data in realloc\n", i);
+						errors++;
+					}
+					slot->size = size;
+					_slot_fill(slot, tag);
+				}
+			} else {
+				my_free(slot->p);
+				slot->p = NULL;
+			}
+		} else {
+			//1/8的槽位分配整页
+			slot->pages = (r / PAGE_TEST_SLOTS) % 8 == 0 ? 1 + (r >> 12) % PAGE_TEST_MAX_PAGES : 0;
+			if (slot->pages) {
+				slot->size = slot->pages * PAGE_SIZE;
+				slot->p = (uint8_t *)page_alloc(slot->pages);
+			} else {
+				uint32_t kind = (r >> 21) % 4;
+				uint32_t align = kind == 1 ? 64 : MALLOC_ALIGN;
+				slot->size = 1 + (r >> 12) % PAGE_TEST_MAX_BYTES;
+				if (kind == 0) {
+					slot->p = (uint8_t *)my_calloc(slot->size, 1);
+					if (slot->p && _slot_verify(slot, 0) < 0) {
+						printf("page_test: calloc 0x%x is not zeroed\n", slot->p);
+						errors++;
+					}
+				} else if (kind == 1) {
+					slot->p = (uint8_t *)my_aligned_alloc(align, slot->size);
+				} else {
+					slot->p = (uint8_t *)my_malloc(slot->size);
+				}
+				if (slot->p && ((uintptr_t)slot->p % align)) {
+					printf("page_test: 0x%x is not aligned\n", slot->p);
+					errors++;
+				}
+			}
+			if (slot->p) {
+				_slot_fill(slot, tag);
+				allocs++;
+			}
+		}
+
+		if (op % PAGE_TEST_CHECK == 0) {
+			//检查的时间不计入每次操作的cycle数
+			uint32_t check_start = ucycle();
+			if (heap_check() < 0 || page_check() < 0) {
+				errors++;
+			}
+			check_cycles += ucycle() - check_start;
+		}
+	}
+	uint32_t cycles = ucycle() - start - check_cycles;
+
+	for (int i = 0; i < PAGE_TEST_SLOTS; i++) {
+		if (slots[i].p == NULL) {
+			continue;
+		}
+		if (slots[i].pages) {
+			page_free(slots[i].p);
+		} else {
+			my_free(slots[i].p);
+		}
+	}
+	if (heap_check() < 0 || page_check() < 0) {
+		errors++;
+	}
+#if !MALLOC_DEBUG
+	errors += _bad_free_test();
+#endif
+	printf("page_test: %d ops, %d allocations, %d errors, %d cycles/op\n",
+		PAGE_TEST_OPS, allocs, errors, cycles / PAGE_TEST_OPS);
+	return errors;
+}
@@ -0,0 +1,64 @@
+#include "../os.h"
+
+/*
+ * PMP(Physical Memory Protection) 隔离
+ * 没有MMU的核上用PMP代替页表保护内存。PMP只检查S/U模式的访问，内核运行在M模式不受影响。
+ * 每个任务的PMP设置在创建时计算好，保存在上下文中，switch_to 只需要写8个CSR(RV64上7个)：
+ * - entry 0~1: 用户程序的代码段 .utext，TOR，R/X
+ * - entry 2~3: 用户程序的数据段 .udata，TOR，R/W
+ * - entry 4~5: 任务自己的栈，TOR，R/W
+ * - entry 7:   整个地址空间，NAPOT，只对非U模式的任务打开
+ * 没有任何表项匹配时，U模式的访问失败，在 trap_handler 中报告。
+ */
+
+extern uintptr_t UTEXT_START;
+extern uintptr_t UTEXT_END;
+extern uintptr_t UDATA_START;
+extern uintptr_t UDATA_END;
+
+//8个表项的配置，RV32 分成 pmpcfg0 和 pmpcfg1，RV64 全部在 pmpcfg0 中
+static void _set_cfg(struct context* ctx, uint64_t cfg)
+{
+	ctx->pmpcfg0 = (reg_t)cfg;
+#if __riscv_xlen == 64
+	ctx->pmpcfg1 = 0;
+#else
+	ctx->pmpcfg1 = (reg_t)(cfg >> 32);
+#endif
+}
+
+void pmp_init()
+{
+	/* entry 7 covers the whole address space, enabled per task */
+	uint64_t cfg = PMP_CFG(7, PMP_NAPOT | PMP_R | PMP_W | PMP_X);
+	w_pmpaddr7((reg_t)-1);
+#if __riscv_xlen == 64
+	w_pmpcfg0(cfg);
+#else
+	w_pmpcfg0(0);
+	w_pmpcfg1((reg_t)(cfg >> 32));
+#endif
+}
+
+/*
+ * 计算任务的PMP设置，任务的栈必须已经分配好
+ */
+void pmp_task_init(TaskNode* task_node, struct context* ctx)
+{
+	if (ctx->mode != MSTATUS_MPP_U) {
+		_set_cfg(ctx, PMP_CFG(7, PMP_NAPOT | PMP_R | PMP_W | PMP_X));
+		for (int i = 0; i < 6; i++) {
+			ctx->pmpaddr[i] = 0;
+		}
+		return;
+	}
+
+	ctx->pmpaddr[0] = PMP_ADDR(UTEXT_START);
+	ctx->pmpaddr[1] = PMP_ADDR(UTEXT_END);
+	ctx->pmpaddr[2] = PMP_ADDR(UDATA_START);
+	ctx->pmpaddr[3] = PMP_ADDR(UDATA_END);
+	ctx->pmpaddr[4] = PMP_ADDR(task_node->stack);
+	ctx->pmpaddr[5] = PMP_ADDR(task_node->stack + task_node->stack_size);
+	_set_cfg(ctx, PMP_CFG(1, PMP_TOR | PMP_R | PMP_X) | PMP_CFG(3, PMP_TOR | PMP_R | PMP_W) |
+		PMP_CFG(5, PMP_TOR | PMP_R | PMP_W));
+}
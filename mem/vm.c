@@ -0,0 +1,376 @@
+#include "../os.h"
+
+/*
+ * Sv32 虚拟内存
+ * 内核(trap、调度、定时器)仍然运行在M模式，M模式不经过地址翻译；
+ * 任务运行在S模式，每个任务都有自己的页表，切换任务时在 switch_to 中切换satp。
+ * 内核的内存和外设按恒等映射(虚拟地址 == 物理地址)，全部使用4MB的大页，
+ * 并标记为全局页，所有任务的根页表共享这些页表项，TLB只需要很少的表项。
+ * 任务私有的映射使用4KB的页，二级页表从 page_alloc 分配。
+ * U模式的用户任务不映射内核，只能看到用户程序的代码、数据和自己的栈。
+ *
+ * 任务的栈和堆是按需分配的(demand-zero)：创建任务时只保留虚拟地址区间，不建立映射，
+ * 第一次访问时在页错误处理中分配。读访问先映射到共享的只读全零页，
+ * 第一次写时再分配私有的物理页(写时复制)，只读不写的页不占用内存。
+ * 按需分配的页在页表项中用 PTE_OWNED 标记，销毁页表时一起释放。
+ */
+
+/* 页表项保留给软件的位：该页是按需分配的，属于这个页表 */
+#define PTE_OWNED PTE_RSW0
+
+/* 用户程序的代码段和数据段，见 os.ld */
+extern uintptr_t UTEXT_START;
+extern uintptr_t UTEXT_END;
+extern uintptr_t UDATA_START;
+extern uintptr_t UDATA_END;
+
+/* RAM的范围见 os.ld */
+#define RAM_START 0x80000000
+#define RAM_SIZE (128 * 1024 * 1024)
+
+/* 内核映射的模板，创建任务页表时整体复制，除了测试设备以外只包含大页 */
+static pagetable_t kernel_pagetable;
+
+/* 正在使用的ASID，每一位对应一个，ASID 0 留给不开启地址翻译的情况 */
+static uint32_t _asid_used[(SATP_ASID_MAX + 1) / 32] = {1};
+static uint32_t _next_asid = 1; // 下一次从这里开始查找空闲的ASID，尽量推迟复用
+
+/* 所有任务共享的全零页，只读映射 */
+static void *_zero_page_pa;
+
+static void _zero_page(void *page)
+{
+	memset(page, 0, PAGE_SIZE);
+}
+
+//按大页建立恒等映射，地址和大小都必须是4MB对齐的
+static void _map_megapages(pagetable_t pt, uint32_t pa, uint32_t size, uint32_t perm)
+{
+	for (uint32_t a = pa; a - pa < size; a += MEGAPAGE_SIZE) {
+		pt[PX(1, a)] = PA2PTE(a) | perm | PTE_V;
+	}
+}
+
+void vm_init()
+{
+	kernel_pagetable = (pagetable_t)page_alloc(1);
+	_zero_page(kernel_pagetable);
+
+	/* RAM: kernel image, heap and every task stack */
+	_map_megapages(kernel_pagetable, RAM_START, RAM_SIZE,
+		PTE_R | PTE_W | PTE_X | PTE_G | PTE_A | PTE_D);
+	/* CLINT, tasks read mtime and raise software interrupts through it */
+	_map_megapages(kernel_pagetable, CLINT_BASE, MEGAPAGE_SIZE,
+		PTE_R | PTE_W | PTE_G | PTE_A | PTE_D);
+	/* UART0 and the virtio MMIO slots */
+	_map_megapages(kernel_pagetable, UART0, MEGAPAGE_SIZE,
+		PTE_R | PTE_W | PTE_G | PTE_A | PTE_D);
+	/*
+	 * test device, the benchmark task powers off QEMU through it. Only this 4KB page is
+	 * mapped, a megapage would also map address 0 and NULL pointers would no longer fault.
+	 * The second level table is shared by every task, vm_destroy does not free it.
+	 */
+	if (vm_map(kernel_pagetable, VIRT_TEST, VIRT_TEST, PAGE_SIZE, PTE_R | PTE_W | PTE_G) < 0) {
+		panic("vm_init: cannot map the test device");
+	}
+
+	_zero_page_pa = page_alloc(1);
+	_zero_page(_zero_page_pa);
+
+	printf("VM: Sv32, kernel mapped with 4MB megapages, root page table 0x%x\n", kernel_pagetable);
+}
+
+/*
+ * DESCRIPTION
+ * 	为任务创建页表，根页表中已经包含内核的映射.
+ * RETURN VALUE
+ * 	根页表，失败时返回NULL
+ */
+pagetable_t vm_create()
+{
+	pagetable_t pt = (pagetable_t)page_alloc(1);
+	if (pt == NULL) {
+		return NULL;
+	}
+	memcpy(pt, kernel_pagetable, PAGE_SIZE);
+	return pt;
+}
+
+/*
+ * DESCRIPTION
+ * 	为U模式的用户任务创建页表.
+ * 	页表中不包含内核的映射，只映射用户程序的代码段(只读、可执行)和数据段(可读写)，
+ * 	任务的栈由调用者用 vm_map 映射。
+ * RETURN VALUE
+ * 	根页表，失败时返回NULL
+ */
+pagetable_t vm_create_user()
+{
+	pagetable_t pt = (pagetable_t)page_alloc(1);
+	if (pt == NULL) {
+		return NULL;
+	}
+	_zero_page(pt);
+	if (vm_map(pt, UTEXT_START, UTEXT_START, UTEXT_END - UTEXT_START, PTE_U | PTE_R | PTE_X) < 0 ||
+		vm_map(pt, UDATA_START, UDATA_START, UDATA_END - UDATA_START, PTE_U | PTE_R | PTE_W) < 0) {
+		vm_destroy(pt);
+		return NULL;
+	}
+	return pt;
+}
+
+/*
+ * 返回 va 对应的最后一级页表项，alloc 不为0时按需分配二级页表
+ */
+static pte_t *_walk(pagetable_t pt, uint32_t va, int alloc)
+{
+	pte_t *pte = &pt[PX(1, va)];
+	if (*pte & PTE_V) {
+		if (*pte & (PTE_R | PTE_W | PTE_X)) {
+			// 已经被大页映射
+			return NULL;
+		}
+	} else {
+		if (!alloc) {
+			return NULL;
+		}
+		pagetable_t l0 = (pagetable_t)page_alloc(1);
+		if (l0 == NULL) {
+			return NULL;
+		}
+		_zero_page(l0);
+		*pte = PA2PTE(l0) | PTE_V;
+	}
+	pagetable_t l0 = (pagetable_t)PTE2PA(*pte);
+	return &l0[PX(0, va)];
+}
+
+/*
+ * DESCRIPTION
+ * 	在页表中建立 [va, va + size) 到 [pa, pa + size) 的4KB页映射.
+ * 	- perm: PTE_R/PTE_W/PTE_X/PTE_U 的组合
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 地址未按页对齐、和大页冲突或页表分配失败
+ */
+int vm_map(pagetable_t pt, uint32_t va, uint32_t pa, uint32_t size, uint32_t perm)
+{
+	if ((va | pa | size) & (PAGE_SIZE - 1)) {
+		return -1;
+	}
+	for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+		pte_t *pte = _walk(pt, va + off, 1);
+		if (pte == NULL) {
+			return -1;
+		}
+		*pte = PA2PTE(pa + off) | perm | PTE_A | PTE_D | PTE_V;
+	}
+	return 0;
+}
+
+/*
+ * 释放任务页表：按需分配的页、二级页表和根页表，内核的映射是共享的，不需要释放
+ */
+void vm_destroy(pagetable_t pt)
+{
+	for (int i = 0; i < PAGE_SIZE / sizeof(pte_t); i++) {
+		pte_t pte = pt[i];
+		//和内核页表共享的二级页表不属于这个任务
+		if (pte == kernel_pagetable[i]) {
+			continue;
+		}
+		if ((pte & PTE_V) && !(pte & (PTE_R | PTE_W | PTE_X))) {
+			pagetable_t l0 = (pagetable_t)PTE2PA(pte);
+			for (int j = 0; j < PAGE_SIZE / sizeof(pte_t); j++) {
+				if ((l0[j] & PTE_V) && (l0[j] & PTE_OWNED)) {
+					page_free((void *)PTE2PA(l0[j]));
+				}
+			}
+			page_free(l0);
+		}
+	}
+	page_free(pt);
+}
+
+/*
+ * DESCRIPTION
+ * 	查找 va 所在的4KB页映射到的物理页.
+ * RETURN VALUE
+ * 	物理页的地址，没有映射时返回0
+ */
+uint32_t vm_lookup(pagetable_t pt, uint32_t va)
+{
+	pte_t *pte = _walk(pt, va, 0);
+	if (pte == NULL || !(*pte & PTE_V)) {
+		return 0;
+	}
+	return PTE2PA(*pte);
+}
+
+/*
+ * DESCRIPTION
+ * 	为 va 所在的页分配一个属于该页表的私有物理页，随页表一起释放.
+ * 	该页已经有私有页时直接返回它并加上 perm 中的权限；
+ * 	已经映射了共享的页(例如零复制映射的只读页)时，先把原来的内容复制到私有页中。
+ * RETURN VALUE
+ * 	物理页的地址，内存不足或和大页冲突时返回NULL
+ */
+void *vm_alloc(pagetable_t pt, uint32_t va, uint32_t perm)
+{
+	pte_t *pte = _walk(pt, va, 1);
+	if (pte == NULL) {
+		return NULL;
+	}
+	if ((*pte & PTE_V) && (*pte & PTE_OWNED)) {
+		*pte |= perm;
+		return (void *)PTE2PA(*pte);
+	}
+	uint32_t *page = (uint32_t *)page_alloc(1);
+	if (page == NULL) {
+		return NULL;
+	}
+	if (*pte & PTE_V) {
+		memcpy(page, (void *)PTE2PA(*pte), PAGE_SIZE);
+		perm |= *pte & (PTE_U | PTE_R | PTE_W | PTE_X);
+	} else {
+		_zero_page(page);
+	}
+	*pte = PA2PTE(page) | perm | PTE_A | PTE_D | PTE_OWNED | PTE_V;
+	return page;
+}
+
+//va 是否位于按需分配的栈或堆区间中
+static int _demand_zero(uint32_t va)
+{
+	return (va >= VM_STACK_TOP - VM_STACK_SIZE && va < VM_STACK_TOP) ||
+		(va >= VM_HEAP_BASE && va - VM_HEAP_BASE < VM_HEAP_SIZE);
+}
+
+/*
+ * DESCRIPTION
+ * 	处理任务的页错误，在 trap_handler 中调用.
+ * 	va 位于栈或堆的保留区间时：读访问映射共享的全零页，写访问分配一个清零的物理页。
+ * 	- write: 是否是写访问(store page fault)
+ * 	- user: 任务是否运行在U模式，决定页表项是否带 PTE_U
+ * RETURN VALUE
+ * 	0: 已经建立映射，重新执行出错的指令即可
+ * 	-1: 非法访问或内存不足，由调用者结束该任务
+ */
+int vm_fault(pagetable_t pt, uint32_t va, int write, int user)
+{
+	if (!_demand_zero(va)) {
+		return -1;
+	}
+	pte_t *pte = _walk(pt, va, 1);
+	if (pte == NULL) {
+		return -1;
+	}
+	uint32_t perm = (user ? PTE_U : 0) | PTE_A;
+
+	if (!write) {
+		if (*pte & PTE_V) {
+			//已经映射，页错误不是由按需分配引起的
+			return -1;
+		}
+		*pte = PA2PTE(_zero_page_pa) | perm | PTE_R | PTE_V;
+	} else {
+		if ((*pte & PTE_V) && PTE2PA(*pte) != (uintptr_t)_zero_page_pa) {
+			return -1;
+		}
+		void *page = page_alloc(1);
+		if (page == NULL) {
+			return -1;
+		}
+		_zero_page(page);
+		*pte = PA2PTE(page) | perm | PTE_R | PTE_W | PTE_D | PTE_OWNED | PTE_V;
+	}
+	//页表项从无效变为有效、或者从全零页换成私有页，都需要刷新TLB
+	sfence_vma();
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	统计 [va, va + size) 中已经分配了物理页的大小，用于统计栈的最高水位.
+ */
+uint32_t vm_committed(pagetable_t pt, uint32_t va, uint32_t size)
+{
+	uint32_t committed = 0;
+	for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+		pte_t *pte = _walk(pt, va + off, 0);
+		if (pte && (*pte & PTE_V) && (*pte & PTE_OWNED)) {
+			committed += PAGE_SIZE;
+		}
+	}
+	return committed;
+}
+
+/*
+ * DESCRIPTION
+ * 	按任务的页表把 [va, va + len) 复制到内核的缓冲区 dst 中.
+ * 	内核运行在M模式，不经过地址翻译，访问任务的虚拟地址必须先查页表。
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 其中有没有映射的页
+ */
+int vm_copyin(pagetable_t pt, void* dst, uint32_t va, uint32_t len)
+{
+	char *d = (char *)dst;
+	while (len > 0) {
+		uint32_t pa;
+		pte_t *l1 = &pt[PX(1, va)];
+		if (!(*l1 & PTE_V)) {
+			return -1;
+		}
+		if (*l1 & (PTE_R | PTE_W | PTE_X)) {
+			//大页
+			pa = PTE2PA(*l1) + (va & (MEGAPAGE_SIZE - 1));
+		} else {
+			pte_t *pte = _walk(pt, va, 0);
+			if (pte == NULL || !(*pte & PTE_V)) {
+				return -1;
+			}
+			pa = PTE2PA(*pte) + (va & (PAGE_SIZE - 1));
+		}
+		uint32_t n = PAGE_SIZE - (va & (PAGE_SIZE - 1));
+		if (n > len) {
+			n = len;
+		}
+		memcpy(d, (void *)(uintptr_t)pa, n);
+		d += n;
+		va += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	为页表分配一个ASID，返回切换到该地址空间时写入satp的值.
+ * 	同时存在的任务使用不同的ASID，切换satp时不需要刷新TLB；
+ * 	任务退出时用 vm_free_asid 归还ASID，再次分配时先刷新这个ASID在TLB中残留的表项。
+ * RETURN VALUE
+ * 	satp的值，ASID全部被占用时返回0
+ */
+reg_t vm_satp(pagetable_t pt)
+{
+	for (uint32_t n = 0; n < SATP_ASID_MAX; n++) {
+		uint32_t asid = _next_asid;
+		_next_asid = _next_asid == SATP_ASID_MAX ? 1 : _next_asid + 1;
+		if (!(_asid_used[asid / 32] & (1u << (asid % 32)))) {
+			_asid_used[asid / 32] |= 1u << (asid % 32);
+			sfence_vma_asid(asid);
+			return SATP_SV32_ASID(pt, asid);
+		}
+	}
+	return 0;
+}
+
+//归还 vm_satp 分配的ASID
+void vm_free_asid(reg_t satp)
+{
+	uint32_t asid = (satp >> SATP_ASID_SHIFT) & SATP_ASID_MAX;
+	if (asid != 0) {
+		_asid_used[asid / 32] &= ~(1u << (asid % 32));
+	}
+}
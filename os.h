@@ -4,13 +4,43 @@
 #include "types.h"
 #include "platform.h"
 #include "riscv.h"
+/* 编译时配置，make 根据 common.mk 中的 CONFIG_* 变量生成，见 tools/mkconfig.py */
+#include "config.h"
 
 #include <stddef.h>
 #include <stdarg.h>
 
-#define MAX_TASKS 10
-#define STACK_SIZE 1024
-#define MAX_PRIORITY 256
+#define MAX_TASKS CONFIG_MAX_TASKS       // 每个优先级的任务数
+#define STACK_SIZE CONFIG_STACK_SIZE
+#define MAX_PRIORITY CONFIG_MAX_PRIORITY // 最低优先级留给空闲任务，MAX_PRIORITY-2 给块缓存和键值存储的后台任务
+#if MAX_PRIORITY < 3
+#error "CONFIG_MAX_PRIORITY must be at least 3"
+#endif
+/* 优先级老化的默认间隔(mtime的tick)，0表示关闭 */
+#define SCHED_AGING_INTERVAL 0
+/* 虚拟内存：为1时任务运行在S模式，每个任务使用自己的Sv32页表 */
+/*
+ * 开启虚拟内存时，每个地址空间中栈和堆的保留区间，第一次访问时才分配物理页。
+ * 栈从 VM_STACK_TOP 向下增长，栈和堆之间隔一个不映射的页。
+ */
+#define VM_STACK_TOP 0x40000000
+#define VM_STACK_SIZE (64 * 1024)
+#define VM_HEAP_BASE (VM_STACK_TOP + 4096)
+#define VM_HEAP_SIZE (1024 * 1024)
+/* 从ELF镜像加载的程序必须链接在这个区间中，见 apps/app.ld */
+#define VM_IMAGE_BASE 0x20000000
+#define VM_IMAGE_SIZE (16 * 1024 * 1024)
+/* PMP隔离：为1时切换任务时重新设置PMP，U模式的任务只能访问自己的栈和用户程序 */
+#if CONFIG_VM && CONFIG_PMP
+#error "CONFIG_PMP is meant for cores without paging, it can not be used with CONFIG_VM"
+#endif
+#if CONFIG_VM && __riscv_xlen == 64
+#error "CONFIG_VM uses Sv32 page tables, which only exist on RV32"
+#endif
+/* 基准测试：为1时 os_main 只运行 bench/bench.c 中的微基准测试，由 make bench 设置 */
+#ifndef CONFIG_BENCH
+#define CONFIG_BENCH 0
+#endif
 
 /* uart */
 extern int uart_putc(char ch);
@@ -20,14 +50,151 @@ extern void uart_puts(char *s);
 extern int  printf(const char* s, ...);
 extern void panic(char *s);
 
+/* string */
+//内存和字符串函数，见 lib/string.c
+extern void *memset(void *dst, int c, size_t n);
+extern void *memcpy(void *dst, const void *src, size_t n);
+extern void *memmove(void *dst, const void *src, size_t n);
+extern int memcmp(const void *a, const void *b, size_t n);
+extern size_t strlen(const char *s);
+
+/* clock */
+/*
+ * 内核唯一的时间基准：CLINT 的 mtime，频率 CLINT_TIMEBASE_FREQ，开机时为0，单调递增。
+ * 定时器、调度器、trace 和各种统计都从这里取时间，单位是 mtime 的 tick。
+ */
+#define CLOCK_NS_PER_TICK (1000000000 / CLINT_TIMEBASE_FREQ)
+#define CLOCK_TICKS_PER_US (CLINT_TIMEBASE_FREQ / 1000000)
+#if CLOCK_NS_PER_TICK * CLINT_TIMEBASE_FREQ != 1000000000 || CLOCK_TICKS_PER_US * 1000000 != CLINT_TIMEBASE_FREQ
+#error "the clock conversions need CLINT_TIMEBASE_FREQ to be a whole number of MHz"
+#endif
+
+/*
+ * 64位的 mtime。RV64 一次读完；RV32 先读高32位再读低32位，
+ * 高32位变了说明读的过程中低32位发生了进位，重新读，不会读到撕裂的值。
+ */
+static inline uint64_t clock_ticks(void)
+{
+#if __riscv_xlen == 64
+	return *(volatile uint64_t*)CLINT_MTIME;
+#else
+	volatile uint32_t* mtime = (volatile uint32_t*)CLINT_MTIME;
+	uint32_t hi, lo;
+	do {
+		hi = mtime[1];
+		lo = mtime[0];
+	} while (mtime[1] != hi);
+	return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
+//只读 mtime 的低32位，一次MMIO读，用于测量不超过 2^32 tick(约7分钟)的间隔
+static inline uint32_t clock_ticks32(void)
+{
+	return *(volatile uint32_t*)CLINT_MTIME;
+}
+
+static inline uint64_t clock_ticks_to_ns(uint64_t ticks)
+{
+	return ticks * CLOCK_NS_PER_TICK;
+}
+
+//开机以来的纳秒数
+static inline uint64_t clock_now_ns(void)
+{
+	return clock_ticks_to_ns(clock_ticks());
+}
+
+//间隔的微秒数，RV32 上没有64位除法，间隔按32位计算
+static inline uint32_t clock_ticks_to_us(uint32_t ticks)
+{
+	return ticks / CLOCK_TICKS_PER_US;
+}
+
+static inline uint64_t clock_us_to_ticks(uint64_t us)
+{
+	return us * CLOCK_TICKS_PER_US;
+}
+
+/*
+ * 64位的cycle计数器，读CSR不需要访问总线，比 mtime 便宜，适合测量很短的代码。
+ * RV32 和 clock_ticks 一样用 cycleh/cycle/cycleh 的顺序避免撕裂。
+ */
+static inline uint64_t clock_cycles(void)
+{
+#if __riscv_xlen == 64
+	return r_cycle();
+#else
+	uint32_t hi, lo;
+	do {
+		hi = r_cycleh();
+		lo = r_cycle();
+	} while (r_cycleh() != hi);
+	return ((uint64_t)hi << 32) | lo;
+#endif
+}
+
 /* memory management */
+#define PAGE_SIZE 4096
+//页分配器和字节级内存管理只在启动过程和trap中执行，任务中调用时通过 SYS_MEM 进入trap，见 mem/page.c
 extern void *page_alloc(int npages);
 extern void page_free(void *p);
 //字节级内存管理
 extern void *my_malloc(size_t size); 
 extern void my_free(void *ptr);
+extern void *my_calloc(size_t nmemb, size_t size);
+extern void *my_realloc(void *ptr, size_t size);
+extern void *my_aligned_alloc(size_t align, size_t size);
+//堆的统计
+struct heap_stats {
+	uint32_t used_bytes;   // 已分配块的字节数，包括控制块
+	uint32_t peak_bytes;   // used_bytes 的最大值
+	uint32_t free_bytes;
+	uint32_t free_blocks;
+	uint32_t largest_free; // 最大的空闲块
+	uint32_t frag_percent; // 碎片率：不在最大空闲块中的空闲字节的百分比
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t failed;       // 分配失败的次数
+	uint32_t bad_frees;    // 被拒绝的释放和realloc：重复释放、野指针和越界写
+};
+extern int heap_get_stats(struct heap_stats *stats);
+extern void heap_report(void);
+//内存管理的不变式检查和随机压力测试，返回出错的次数
+extern int heap_check(void);
+extern int page_check(void);
+extern int page_test(void);
+
+/* arena */
+//区域分配器：按指针递增分配，整体释放，见 mem/arena.c
+struct arena;
+extern struct arena* arena_create(void);
+extern void* arena_alloc(struct arena* a, size_t size);
+extern void arena_reset(struct arena* a);
+extern void arena_destroy(struct arena* a);
+extern void arena_get_usage(struct arena* a, uint32_t* bytes, uint32_t* npages);
+//从当前任务的区域中分配，任务退出时整体释放
+extern void* task_alloc(size_t size);
+
+/* virtual memory */
+extern void vm_init(void);
+extern pagetable_t vm_create(void);
+extern pagetable_t vm_create_user(void);
+extern int vm_map(pagetable_t pt, uint32_t va, uint32_t pa, uint32_t size, uint32_t perm);
+extern void vm_destroy(pagetable_t pt);
+extern reg_t vm_satp(pagetable_t pt);
+extern void vm_free_asid(reg_t satp);
+extern int vm_fault(pagetable_t pt, uint32_t va, int write, int user);
+extern uint32_t vm_committed(pagetable_t pt, uint32_t va, uint32_t size);
+extern int vm_copyin(pagetable_t pt, void* dst, uint32_t va, uint32_t len);
+extern uint32_t vm_lookup(pagetable_t pt, uint32_t va);
+extern void* vm_alloc(pagetable_t pt, uint32_t va, uint32_t perm);
+
+/* physical memory protection */
+extern void pmp_init(void);
 
 /* task management */
+//每个字段一个寄存器宽，entry.S 按 REGBYTES 计算偏移，修改时两边要一致
 struct context {
 	/* ignore x0 */
 	reg_t ra;
@@ -64,26 +231,279 @@ struct context {
 	// upon is trap frame
 
 	// save the pc to run in next schedule cycle
-	reg_t pc; // offset: 31 *4 = 124
+	reg_t pc; // offset: 31 * REGBYTES
+
+	// address space and privilege mode, used by switch_to
+	reg_t satp; // offset: 32 * REGBYTES, 0 means no translation
+	reg_t mode; // offset: 33 * REGBYTES, value for mstatus.MPP
+
+	// PMP settings of the task, loaded by switch_to when CONFIG_PMP is on
+	reg_t pmpcfg0; // offset: 34 * REGBYTES
+	reg_t pmpcfg1; // offset: 35 * REGBYTES, not used on RV64
+	reg_t pmpaddr[6]; // offset: 36 * REGBYTES, pmpaddr0 ~ pmpaddr5
+};
+
+//任务的消息队列
+#define MSG_QUEUE_LEN CONFIG_MSG_QUEUE_LEN
+#if MSG_QUEUE_LEN < 1 || MSG_QUEUE_LEN > 255
+#error "CONFIG_MSG_QUEUE_LEN must be between 1 and 255"
+#endif
+struct mailbox {
+	uint32_t msgs[MSG_QUEUE_LEN];
+	uint8_t head;
+	uint8_t count;
 };
 
 // 双向任务节点
 typedef struct taskNode{
 	struct context* task;
-	uint32_t timeslice;
+	uint32_t timeslice; // 时间片长度，单位为mtime的tick
+	uint32_t budget;    // 当前时间片剩余的预算
 	uint32_t task_id;
+	int priority;       // 有效优先级，即所在的链表，EDF任务为 TASK_PRIORITY_EDF
+	int base_priority;  // 创建时指定的优先级，老化提升后会回到该优先级
+	uint64_t ready_since; // 上一次停止运行的时刻，用于优先级老化
+	uint8_t* stack;     // 栈空间的最低地址
+	uint32_t stack_size;
+	pagetable_t pagetable; // 任务的页表，未开启虚拟内存时为NULL
+	uint8_t exiting;    // 任务已调用task_exit，等待调度器回收
+	uint32_t restarts;  // 出错时还可以自动重启的次数
+	void (*entry)(void* param); // 入口函数和参数，用于重启
+	void* param;
+	uint8_t yielded;    // 是否主动让出了CPU
+	uint8_t blocked;    // 阻塞中(睡眠或等待消息)，不在就绪链表中
+	uint8_t waiting_msg; // 阻塞在 sys_recv 上
+	void* wait_chan;    // 阻塞在 sys_wait 上时等待的地址
+	uint64_t wake_time; // 睡眠结束的时刻
+	struct mailbox mbox;
+	struct arena* arena; // task_alloc 使用的区域，任务退出或重启时释放
+	struct taskNode* wait_next; // 睡眠链表
+	struct taskNode* all_next;  // 所有任务的链表，用于按id查找
 	struct taskNode* pre;
 	struct taskNode* next;
 }TaskNode;
 
+#define TASK_PRIORITY_EDF (-1)
+
 extern void task_delay(volatile int count);
 extern void task_yield();
+extern void sched_resched(void);
 
 //优先级任务管理
 extern int task_create_priority(void (*start_routin)(void* param), void* param, int priority, uint32_t timeslice);
 extern int add_taskNode(TaskNode* first, TaskNode* tail, TaskNode* task_new_node, int priority);
 extern int datch_taskNode(TaskNode* task_node);
 extern void task_exit(void);
+extern void sched_set_aging(uint32_t interval);
+extern void task_fault(struct context* ctx, reg_t cause, reg_t epc, reg_t tval);
+extern int task_set_restart(uint32_t task_id, uint32_t max_restarts);
+extern uint32_t task_stack_high_water(TaskNode* task_node);
+extern void task_stack_report(void);
+extern int task_create_user(void (*start_routin)(void* param), void* param, int priority, uint32_t timeslice);
+/* 在任务的页表中加载程序镜像，通过 entry 返回入口地址，失败时返回-1 */
+typedef int (*task_loader_t)(pagetable_t pt, const void* image, uint32_t size, reg_t* entry);
+extern int task_create_loaded(task_loader_t load, const void* image, uint32_t size, void* param, int priority, uint32_t timeslice);
+/* 创建任务的参数，任务中创建任务时通过 SYS_TASK_CREATE 传入trap */
+struct task_args {
+	void (*entry)(void* param);
+	void* param;
+	int priority;
+	uint32_t timeslice;
+	int user;
+	task_loader_t load;
+	const void* image;
+	uint32_t size;
+	int periodic;	//不为0时创建EDF周期任务，使用下面三个参数
+	uint32_t period;
+	uint32_t wcet;
+	uint32_t deadline;
+};
+extern int task_create_args(const struct task_args* a);
+extern TaskNode* task_find(uint32_t task_id);
+extern void task_block(TaskNode* task_node);
+extern void task_wakeup(TaskNode* task_node);
+extern void task_sleep(TaskNode* task_node, uint32_t ticks);
+extern void task_wake_chan(void* chan);
+//就绪链表的不变式检查和随机压力测试，返回出错的次数
+extern int sched_check(void);
+extern void sched_check_start(void);
+extern uint32_t sched_check_stop(void);
+extern int sched_test(void);
+
+//任务间消息
+extern int msg_send(uint32_t task_id, uint32_t msg);
+extern int msg_recv(TaskNode* task_node, uint32_t* msg);
+
+/* system call */
+//系统调用号，a7中保存调用号，a0~a2保存参数，返回值在a0中
+#define SYS_GETTID 0 // 返回任务id
+#define SYS_YIELD  1 // 让出CPU
+#define SYS_SLEEP  2 // a0: 睡眠的mtime tick数
+#define SYS_EXIT   3 // 退出任务，不会返回
+#define SYS_WRITE  4 // a0: 缓冲区，a1: 长度，输出到串口
+#define SYS_TIMER  5 // a0: 超时(TIMER_TICK)，a1: 超时后发送给自己的消息
+#define SYS_SEND   6 // a0: 目标任务id，a1: 消息
+#define SYS_RECV   7 // 阻塞直到收到消息，返回消息
+#define SYS_WAIT   8 // a0: 地址，a1: 值，*a0 == a1 时阻塞，直到 task_wake_chan(a0)，只供内核任务使用
+#define SYS_TIMER_ADD 9  // a0: 定时器链表节点，加入定时器链表，只供内核任务使用
+#define SYS_TIMER_DEL 10 // a0: 定时器链表节点，从定时器链表中取出，只供内核任务使用
+#define SYS_WAKE   11 // a0: 地址，唤醒 sys_wait(a0, ...) 上阻塞的任务，只供内核任务使用
+#define SYS_MEM    12 // a0: 操作 MEM_*，a1、a2: 参数，在trap中执行内存分配器的操作，只供内核任务使用
+#define SYS_TASK_CREATE 13 // a0: struct task_args，在trap中创建任务，只供内核任务使用
+#define SYS_JOB_END 14 // 结束当前的EDF作业，只供EDF任务使用
+#define NR_SYSCALLS 15
+
+/* SYS_MEM 的操作，返回值和对应的函数相同 */
+#define MEM_MALLOC  0 // a1: 字节数
+#define MEM_FREE    1 // a1: 地址
+#define MEM_CALLOC  2 // a1: 元素个数，a2: 元素大小
+#define MEM_REALLOC 3 // a1: 地址，a2: 字节数
+#define MEM_ALIGNED 4 // a1: 对齐，a2: 字节数
+#define MEM_PAGE_ALLOC 5 // a1: 页数
+#define MEM_PAGE_FREE  6 // a1: 地址
+#define MEM_HEAP_STATS 7 // a1: 内核中的 struct heap_stats
+#define MEM_PAGE_CHECK 8
+
+extern void do_syscall(struct context* ctx);
+
+//用户任务使用的系统调用接口，见 user/ulib.c
+extern int sys_gettid(void);
+extern void sys_yield(void);
+extern void sys_sleep(uint32_t ticks);
+extern void sys_exit(void);
+extern int sys_write(const char* buf, uint32_t len);
+extern int sys_timer(uint32_t timeout, uint32_t msg);
+extern int sys_send(uint32_t task_id, uint32_t msg);
+extern uint32_t sys_recv(void);
+extern int sys_wait(volatile void* addr, uint32_t val);
+struct TimerNode;
+extern int sys_timer_add(struct TimerNode* node);
+extern int sys_timer_del(struct TimerNode* node);
+extern int sys_wake(volatile void* addr);
+extern reg_t sys_mem(int op, reg_t arg0, reg_t arg1);
+extern int sys_task_create(const struct task_args* a);
+extern int sys_job_end(void);
+extern int uprintf(const char* s, ...);
+extern uint32_t ucycle(void);
+
+//EDF周期任务管理
+extern int task_create_periodic(void (*start_routin)(void* param), void* param, uint32_t period, uint32_t wcet, uint32_t deadline);
+extern uint32_t task_deadline_misses(int id);
+extern int edf_job_done(void);
+
+extern void pmp_task_init(TaskNode* task_node, struct context* ctx);
+
+/* virtio block device */
+#define BLK_SECTOR_SIZE 512
+#define BLK_OK      0
+#define BLK_ERROR   (-1)
+#define BLK_PENDING 1
+
+//异步的磁盘请求，提交后由中断处理设置状态并调用完成回调
+struct blk_req {
+	uint32_t sector;    // 起始扇区
+	void* buf;          // 数据缓冲区
+	uint32_t len;       // 字节数，扇区大小的整数倍
+	uint8_t write;      // 1: 写磁盘，0: 读磁盘
+	volatile int status; // BLK_PENDING / BLK_OK / BLK_ERROR
+	void (*done)(struct blk_req* req); // 完成回调，在中断上下文中调用
+	void* arg;          // 留给调用者使用
+};
+
+/*
+ * 块设备：以 BLOCK_SIZE 为单位的设备，请求仍按扇区描述
+ * submit 异步提交一批请求，语义和 virtio_blk_submit 相同
+ */
+#define BLOCK_SIZE PAGE_SIZE
+#define BLOCK_SECTORS (BLOCK_SIZE / BLK_SECTOR_SIZE)
+
+struct blk_dev {
+	const char* name;
+	uint32_t nblocks;
+	int (*submit)(struct blk_dev* dev, struct blk_req* reqs[], int n);
+	void* priv;
+};
+
+extern int virtio_blk_init(void);
+extern struct blk_dev* virtio_blk_dev(void);
+extern int virtio_blk_submit(struct blk_req* reqs[], int n);
+extern uint32_t virtio_blk_capacity(void);
+extern void virtio_blk_stats(void);
+
+/* block cache */
+struct buf {
+	struct blk_dev* dev;
+	uint32_t blockno;
+	uint8_t* data;      // BLOCK_SIZE 大小的页
+	volatile uint32_t io; // 读写进行中
+	volatile uint8_t valid; // data 中是磁盘上的内容
+	volatile uint8_t dirty; // 修改过，还没有写回
+	uint32_t refcnt;
+	struct buf* hnext;  // 哈希链
+	struct buf* prev;   // LRU链表
+	struct buf* next;
+	struct blk_req req;
+};
+
+struct bcache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+	uint32_t readaheads; // 预读的块数
+	uint32_t writebacks; // 写回的块数
+};
+
+extern struct buf* bread(struct blk_dev* dev, uint32_t blockno);
+extern void bwrite(struct buf* b);
+extern void brelse(struct buf* b);
+extern void bcache_flush(void);
+extern void bcache_get_stats(struct bcache_stats* stats);
+
+/* ram disk */
+extern struct blk_dev* ramdisk_create(uint32_t nblocks);
+
+/* key-value store */
+#define KV_MAX_KEY 32
+#define KV_MAX_VALUE 1024
+
+struct kv_stats {
+	uint32_t puts;
+	uint32_t gets;
+	uint32_t dels;
+	uint32_t commits;
+	uint32_t compactions;
+	uint32_t user_bytes; // put 写入的键和值的字节数
+	uint32_t log_bytes;  // 写入日志的字节数，包括记录头、提交记录和压缩时的复制
+};
+
+extern int kv_mount(struct blk_dev* dev);
+extern int kv_put(const char* key, const void* val, uint32_t len);
+extern int kv_get(const char* key, void* buf, uint32_t len);
+extern int kv_del(const char* key);
+extern int kv_commit(void);
+extern void kv_get_stats(struct kv_stats* stats);
+
+/* romfs */
+struct romfs_file {
+	const char* name;
+	const uint8_t* data; // 文件在镜像中的位置
+	uint32_t size;
+	uint32_t pos;        // romfs_read 的读写位置
+};
+
+extern int romfs_open(const char* path, struct romfs_file* f);
+extern int romfs_read(struct romfs_file* f, void* buf, uint32_t len);
+extern const void* romfs_map(struct romfs_file* f, uint32_t off, uint32_t len);
+extern void romfs_list(void);
+
+/* elf loader */
+extern int elf_load(pagetable_t pt, const void* image, uint32_t size, reg_t* entry);
+extern int task_create_elf(const void* image, uint32_t size, void* param, int priority, uint32_t timeslice);
+extern int task_create_elf_file(const char* path, void* param, int priority, uint32_t timeslice);
+
+/* trap */
+extern void trap_test(void);
+extern int trap_context(void);
 
 /* plic */
 extern int plic_claim(void);
@@ -95,22 +515,71 @@ struct spinlock{
 	int locked;
 };
 
+extern void lock_init(struct spinlock* lk);
 extern int spin_lock(struct spinlock* lk);
 extern int spin_unlock(struct spinlock* lk);
 
+//睡眠锁：拿不到锁的任务阻塞等待，持有锁的任务可以被抢占。只供内核任务使用，不能在中断和EDF任务中使用
+struct sleeplock {
+	volatile uint32_t locked;
+	volatile uint32_t waiters;
+};
+
+extern void sleeplock_init(struct sleeplock* lk);
+extern void sleep_lock(struct sleeplock* lk);
+extern void sleep_unlock(struct sleeplock* lk);
+
 /* software timer */
 struct timer {
 	void (*func)(void *arg);
 	void *arg;
-	uint32_t timeout_tick;
+	uint64_t expires; // 超时时刻(mtime)
 };
 struct TimerNode {
 	struct timer* timer;
 	struct TimerNode* next;
 };
 
+/* 软件定时器超时时间的单位(mtime)，默认1秒 */
+#define TIMER_TICK CONFIG_TIMER_INTERVAL
+
+#if CONFIG_TIMER
 extern struct timer *timer_create(void (*handler)(void *arg), void *arg, uint32_t timeout);
 extern void timer_delete(struct timer *timer);
 extern int add_TimeNode(struct TimerNode* dummyHead, struct TimerNode* node);
+extern void timer_insert(struct TimerNode* node);
+extern void timer_remove(struct TimerNode* node);
+extern int timer_test(void);
+extern int timer_list_check(void);
+extern uint64_t timer_next_expiry(void);
+#endif
+
+/* benchmarks */
+extern void bench_start(void);
+
+/* trace */
+//内核事件追踪
+#define TRACE_EV_SWITCH 1 // 任务切换，arg0: 切出的任务id，arg1: 切入的任务id
+#define TRACE_EV_TRAP   2 // 中断/异常，arg0: mcause，arg1: mepc
+#define TRACE_EV_LOCK   3 // 获得自旋锁，arg0: 锁地址，arg1: 自旋次数
+#define TRACE_EV_TIMER  4 // 软件定时器超时，arg0: 定时器地址，arg1: 超时时刻的低32位
+
+struct trace_record {
+	uint64_t timestamp; // mtime
+	uint8_t hart;
+	uint8_t event;
+	uint16_t reserved;
+	uint32_t arg0;
+	uint32_t arg1;
+};
+
+#if CONFIG_TRACE
+extern void trace_event(uint8_t event, uint32_t arg0, uint32_t arg1);
+extern void trace_dump(void);
+#else
+//追踪被裁剪掉时调用点不产生任何代码
+static inline void trace_event(uint8_t event, uint32_t arg0, uint32_t arg1) {}
+static inline void trace_dump(void) {}
+#endif
 
 #endif /* __OS_H__ */
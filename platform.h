@@ -12,10 +12,16 @@
  */
 #define MAXNUM_CPU 8
 
+/*
+ * size of the kernel stack of each hart, used at boot and by trap_vector
+ */
+#define KSTACK_SIZE 2048
+
 /*
  * MemoryMap
  * see https://github.com/qemu/qemu/blob/master/hw/riscv/virt.c, virt_memmap[]
  * 0x00001000 -- boot ROM, provided by qemu
+ * 0x00100000 -- test device (poweroff/reboot)
  * 0x02000000 -- CLINT
  * 0x0C000000 -- PLIC
  * 0x10000000 -- UART0
@@ -23,6 +29,13 @@
  * 0x80000000 -- boot ROM jumps here in machine mode, where we load our kernel
  */
 
+/*
+ * Writing VIRT_TEST_PASS to the test device powers off QEMU, used by the
+ * benchmark build to end the run.
+ */
+#define VIRT_TEST 0x00100000L
+#define VIRT_TEST_PASS 0x5555
+
 /* This machine puts UART registers here in physical memory. */
 #define UART0 0x10000000L
 
@@ -36,6 +49,13 @@
  */
 #define UART0_IRQ 10
 
+/*
+ * virtio mmio interface, the first of the eight slots.
+ * Slot i is at VIRTIO0 + i * 0x1000 and uses interrupt source 1 + i.
+ */
+#define VIRTIO0 0x10001000L
+#define VIRTIO0_IRQ 1
+
 /*
  * This machine puts platform-level interrupt controller (PLIC) here.
  * Here only list PLIC registers in Machine mode.
@@ -86,7 +106,13 @@
   * interrupt can be cleared by writing 0 to the MSIP bit in mip.
   * On reset, each msip register is cleared to zero.
   */
+#ifdef HOST_TEST
+/* 在主机上测试时CLINT是 host/hal.c 中的一块内存 */
+extern unsigned char hal_clint[];
+#define CLINT_BASE ((uintptr_t)hal_clint)
+#else
 #define CLINT_BASE 0x2000000L
+#endif
 #define CLINT_MSIP(hartid) (CLINT_BASE + 4 * (hartid))
 #define CLINT_MTIMECMP(hartid) (CLINT_BASE + 0x4000 + 8 * (hartid))
 #define CLINT_MTIME (CLINT_BASE + 0xBFF8) // cycles since boot.
@@ -25,6 +25,9 @@ static inline reg_t r_mhartid()
 
 /* Machine Status Register, mstatus */
 #define MSTATUS_MPP (3 << 11)
+#define MSTATUS_MPP_M (3 << 11)
+#define MSTATUS_MPP_S (1 << 11)
+#define MSTATUS_MPP_U (0 << 11)
 #define MSTATUS_SPP (1 << 8)
 
 #define MSTATUS_MPIE (1 << 7)
@@ -94,6 +97,45 @@ static inline void w_mie(reg_t x)
 	asm volatile("csrw mie, %0" : : "r" (x));
 }
 
+/*
+ * Counter-enable, allow the lower privilege modes to read
+ * cycle(CY), time(TM) and instret(IR)
+ */
+#define COUNTEREN_CY (1 << 0)
+#define COUNTEREN_TM (1 << 1)
+#define COUNTEREN_IR (1 << 2)
+
+static inline void w_mcounteren(reg_t x)
+{
+	asm volatile("csrw mcounteren, %0" : : "r" (x));
+}
+
+static inline void w_scounteren(reg_t x)
+{
+	asm volatile("csrw scounteren, %0" : : "r" (x));
+}
+
+/* cycle counter, readable in every mode once mcounteren/scounteren allow it */
+static inline reg_t r_cycle()
+{
+	reg_t x;
+	asm volatile("rdcycle %0" : "=r" (x));
+	return x;
+}
+
+#if __riscv_xlen != 64
+/* upper 32 bits of the cycle counter, RV32 only */
+static inline reg_t r_cycleh()
+{
+	reg_t x;
+	asm volatile("rdcycleh %0" : "=r" (x));
+	return x;
+}
+#endif
+
+/* the top bit of mcause is set for interrupts, the rest is the cause code */
+#define MCAUSE_INTR ((reg_t)1 << (sizeof(reg_t) * 8 - 1))
+
 static inline reg_t r_mcause()
 {
 	reg_t x;
@@ -101,4 +143,121 @@ static inline reg_t r_mcause()
 	return x;
 }
 
+/*
+ * Supervisor address translation and protection, satp
+ * Sv32: MODE(31) | ASID(30:22) | PPN(21:0)
+ */
+#define SATP_SV32 (1 << 31)
+#define SATP_ASID_SHIFT 22
+#define SATP_ASID_MAX 0x1ff
+#define SATP_SV32_ASID(pagetable, asid) \
+	(SATP_SV32 | ((reg_t)(asid) << SATP_ASID_SHIFT) | (((reg_t)(pagetable)) >> 12))
+
+/* root page table of a satp value */
+#define SATP2PT(satp) ((pagetable_t)(((satp) & 0x3FFFFF) << 12))
+
+static inline void w_satp(reg_t x)
+{
+	asm volatile("csrw satp, %0" : : "r" (x));
+}
+
+static inline reg_t r_satp()
+{
+	reg_t x;
+	asm volatile("csrr %0, satp" : "=r" (x));
+	return x;
+}
+
+/* flush all TLB entries */
+static inline void sfence_vma()
+{
+	asm volatile("sfence.vma zero, zero");
+}
+
+//只刷新某个ASID的非全局表项
+static inline void sfence_vma_asid(uint32_t asid)
+{
+	asm volatile("sfence.vma zero, %0" : : "r" (asid));
+}
+
+/*
+ * Sv32 page table entry
+ * PPN(31:10) | RSW(9:8) | D | A | G | U | X | W | R | V
+ */
+#define PTE_V (1 << 0)
+#define PTE_R (1 << 1)
+#define PTE_W (1 << 2)
+#define PTE_X (1 << 3)
+#define PTE_U (1 << 4)
+#define PTE_G (1 << 5)
+#define PTE_A (1 << 6)
+#define PTE_D (1 << 7)
+#define PTE_RSW0 (1 << 8) // reserved for software
+
+#define PA2PTE(pa) ((((uintptr_t)(pa)) >> 12) << 10)
+#define PTE2PA(pte) ((uintptr_t)((pte) >> 10) << 12)
+#define PTE_FLAGS(pte) ((pte) & 0x3FF)
+
+/* Sv32 has two levels: VPN[1] = va[31:22], VPN[0] = va[21:12] */
+#define PX(level, va) ((((uintptr_t)(va)) >> (12 + 10 * (level))) & 0x3FF)
+#define MEGAPAGE_SIZE (1 << 22)
+
+typedef uint32_t pte_t;
+typedef pte_t *pagetable_t; // 1024 PTEs
+
+/* Physical Memory Protection */
+#define PMP_R (1 << 0)
+#define PMP_W (1 << 1)
+#define PMP_X (1 << 2)
+#define PMP_TOR (1 << 3)
+#define PMP_NAPOT (3 << 3)
+/*
+ * config of entry 0~7, one byte each. RV32 splits it into pmpcfg0 (entry 0~3)
+ * and pmpcfg1 (entry 4~7), on RV64 all of it fits into pmpcfg0
+ */
+#define PMP_CFG(entry, cfg) ((uint64_t)(cfg) << (8 * (entry)))
+/* pmpaddr holds bits 33:2 (RV32) or 55:2 (RV64) of the address */
+#define PMP_ADDR(addr) ((reg_t)(addr) >> 2)
+
+static inline void w_pmpcfg0(reg_t x)
+{
+	asm volatile("csrw pmpcfg0, %0" : : "r" (x));
+}
+
+#if __riscv_xlen != 64
+static inline void w_pmpcfg1(reg_t x)
+{
+	asm volatile("csrw pmpcfg1, %0" : : "r" (x));
+}
+#endif
+
+static inline void w_pmpaddr0(reg_t x)
+{
+	asm volatile("csrw pmpaddr0, %0" : : "r" (x));
+}
+
+static inline void w_pmpaddr7(reg_t x)
+{
+	asm volatile("csrw pmpaddr7, %0" : : "r" (x));
+}
+
+/* wait for interrupt, the hart sleeps until an interrupt is pending */
+static inline void wfi()
+{
+	asm volatile("wfi");
+}
+
+/* Machine Trap Value, the faulting address of an access fault */
+static inline reg_t r_mtval()
+{
+	reg_t x;
+	asm volatile("csrr %0, mtval" : "=r" (x));
+	return x;
+}
+
+#ifdef HOST_TEST
+/* 在主机上测试时上面的函数换成 host/hal.h 中的宏，CSR由 host/hal.c 模拟 */
+#include "host/hal.h"
+#endif
+
 #endif /* __RISCV_H__ */
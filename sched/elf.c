@@ -0,0 +1,165 @@
+#include "../os.h"
+
+/*
+ * ELF32加载器
+ * 把单独链接的程序(见 apps/)加载到新的U模式任务中，不需要把程序链接进内核。
+ * 只处理 PT_LOAD 段，段必须位于 [VM_IMAGE_BASE, VM_IMAGE_BASE + VM_IMAGE_SIZE) 中：
+ * - 只读的段直接把镜像所在的页映射给任务，不复制，加载时间和程序大小无关
+ * - 可写的段、以及镜像中的位置没有按页对齐的页，分配私有页并复制，.bss 部分清零
+ * 镜像必须在任务结束之前一直有效，romfs 中的文件满足这个要求，并且ELF文件按页对齐存放。
+ * 加载的程序需要 CONFIG_VM，而Sv32只有RV32，所以只支持ELF32。
+ */
+
+#define EI_NIDENT 16
+#define ELFCLASS32 1
+#define ELFDATA2LSB 1
+#define ET_EXEC 2
+#define EM_RISCV 243
+#define PT_LOAD 1
+#define PF_X 1
+#define PF_W 2
+#define PF_R 4
+
+struct elf32_ehdr {
+	uint8_t e_ident[EI_NIDENT];
+	uint16_t e_type;
+	uint16_t e_machine;
+	uint32_t e_version;
+	uint32_t e_entry;
+	uint32_t e_phoff;
+	uint32_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;
+	uint16_t e_phnum;
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+};
+
+struct elf32_phdr {
+	uint32_t p_type;
+	uint32_t p_offset;
+	uint32_t p_vaddr;
+	uint32_t p_paddr;
+	uint32_t p_filesz;
+	uint32_t p_memsz;
+	uint32_t p_flags;
+	uint32_t p_align;
+};
+
+static int _in_image(uint32_t va, uint32_t len)
+{
+	return va >= VM_IMAGE_BASE && va - VM_IMAGE_BASE <= VM_IMAGE_SIZE && len <= VM_IMAGE_SIZE - (va - VM_IMAGE_BASE);
+}
+
+static int _check_header(const struct elf32_ehdr *eh, uint32_t size)
+{
+	if (size < sizeof(struct elf32_ehdr) ||
+		eh->e_ident[0] != 0x7f || eh->e_ident[1] != 'E' || eh->e_ident[2] != 'L' || eh->e_ident[3] != 'F' ||
+		eh->e_ident[4] != ELFCLASS32 || eh->e_ident[5] != ELFDATA2LSB ||
+		eh->e_type != ET_EXEC || eh->e_machine != EM_RISCV ||
+		eh->e_phentsize != sizeof(struct elf32_phdr) ||
+		eh->e_phoff > size || eh->e_phnum * sizeof(struct elf32_phdr) > size - eh->e_phoff ||
+		!_in_image(eh->e_entry, 4)) {
+		return -1;
+	}
+	return 0;
+}
+
+//映射一个段，页在镜像中按页对齐并且只读时直接映射，否则复制
+static int _load_segment(pagetable_t pt, const uint8_t *image, const struct elf32_phdr *ph)
+{
+	uint32_t perm = PTE_U;
+	perm |= (ph->p_flags & PF_R) ? PTE_R : 0;
+	perm |= (ph->p_flags & PF_W) ? PTE_W | PTE_R : 0;
+	perm |= (ph->p_flags & PF_X) ? PTE_X : 0;
+
+	uint32_t start = ph->p_vaddr & ~(PAGE_SIZE - 1);
+	uint32_t file_end = ph->p_vaddr + ph->p_filesz;
+	uint32_t mem_end = ph->p_vaddr + ph->p_memsz;
+
+	for (uint32_t va = start; va < mem_end; va += PAGE_SIZE) {
+		//页的起始地址在镜像中对应的位置，第一页可能在段开始之前，段的偏移和地址按页同余，不会小于0
+		const uint8_t *src = image + (ph->p_offset + va - ph->p_vaddr);
+		if (!(ph->p_flags & PF_W) && va + PAGE_SIZE <= file_end &&
+			((uintptr_t)src & (PAGE_SIZE - 1)) == 0 && vm_lookup(pt, va) == 0) {
+			if (vm_map(pt, va, (uintptr_t)src, PAGE_SIZE, perm) < 0) {
+				return -1;
+			}
+			continue;
+		}
+		uint8_t *page = (uint8_t *)vm_alloc(pt, va, perm);
+		if (page == NULL) {
+			return -1;
+		}
+		//只复制属于这个段文件部分的字节
+		uint32_t lo = va < ph->p_vaddr ? ph->p_vaddr : va;
+		uint32_t hi = va + PAGE_SIZE < file_end ? va + PAGE_SIZE : file_end;
+		if (lo < hi) {
+			memcpy(page + (lo - va), src + (lo - va), hi - lo);
+		}
+	}
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	把内存中的ELF32镜像加载到页表 pt 中，用作 task_create_loaded 的加载函数.
+ * RETURN VALUE
+ * 	0: 成功，entry 中是程序的入口地址
+ * 	-1: 不是RISC-V的ELF32可执行文件、段不在允许的区间中或内存不足
+ */
+int elf_load(pagetable_t pt, const void *image, uint32_t size, reg_t *entry)
+{
+	const struct elf32_ehdr *eh = (const struct elf32_ehdr *)image;
+
+	if (_check_header(eh, size) < 0) {
+		printf("elf: bad header\n");
+		return -1;
+	}
+	const struct elf32_phdr *ph = (const struct elf32_phdr *)((const uint8_t *)image + eh->e_phoff);
+	for (int i = 0; i < eh->e_phnum; i++, ph++) {
+		if (ph->p_type != PT_LOAD || ph->p_memsz == 0) {
+			continue;
+		}
+		if (ph->p_filesz > ph->p_memsz || ph->p_offset > size || ph->p_filesz > size - ph->p_offset ||
+			!_in_image(ph->p_vaddr, ph->p_memsz) ||
+			(ph->p_offset & (PAGE_SIZE - 1)) != (ph->p_vaddr & (PAGE_SIZE - 1))) {
+			printf("elf: bad segment %d\n", i);
+			return -1;
+		}
+		if (_load_segment(pt, (const uint8_t *)image, ph) < 0) {
+			printf("elf: out of memory\n");
+			return -1;
+		}
+	}
+	*entry = eh->e_entry;
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	从内存中的ELF镜像创建U模式的任务，param、priority、timeslice 与 task_create_priority 相同.
+ * RETURN VALUE
+ * 	>=0: 任务id
+ * 	-1: 加载失败或者没有开启 CONFIG_VM
+ */
+int task_create_elf(const void *image, uint32_t size, void *param, int priority, uint32_t timeslice)
+{
+	return task_create_loaded(elf_load, image, size, param, priority, timeslice);
+}
+
+/*
+ * DESCRIPTION
+ * 	从romfs中的ELF文件创建任务，只读的段直接映射romfs镜像中的页.
+ */
+int task_create_elf_file(const char *path, void *param, int priority, uint32_t timeslice)
+{
+	struct romfs_file f;
+	if (romfs_open(path, &f) < 0) {
+		printf("elf: %s not found\n", path);
+		return -1;
+	}
+	return task_create_elf(romfs_map(&f, 0, f.size), f.size, param, priority, timeslice);
+}
@@ -0,0 +1,57 @@
+#include "../os.h"
+
+/*
+ * 任务间消息
+ * 每个任务有一个定长的消息队列，消息是一个32位的值。
+ * 接收者阻塞在 sys_recv 上时，消息直接写入它的上下文中的a0，然后唤醒它，不经过队列。
+ * 这些函数在中断上下文中调用(系统调用、软件定时器)，不需要加锁。
+ */
+
+/*
+ * DESCRIPTION
+ * 	向任务发送一条消息.
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 任务不存在或消息队列已满
+ */
+int msg_send(uint32_t task_id, uint32_t msg)
+{
+	TaskNode* task_node = task_find(task_id);
+	if (task_node == NULL || task_node->exiting) {
+		return -1;
+	}
+
+	if (task_node->waiting_msg) {
+		task_node->waiting_msg = 0;
+		task_node->task->a0 = msg;
+		task_wakeup(task_node);
+		return 0;
+	}
+
+	struct mailbox* mbox = &task_node->mbox;
+	if (mbox->count == MSG_QUEUE_LEN) {
+		return -1;
+	}
+	mbox->msgs[(mbox->head + mbox->count) % MSG_QUEUE_LEN] = msg;
+	mbox->count++;
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	从任务的消息队列中取出最早的一条消息，不会阻塞.
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 队列为空
+ */
+int msg_recv(TaskNode* task_node, uint32_t* msg)
+{
+	struct mailbox* mbox = &task_node->mbox;
+	if (mbox->count == 0) {
+		return -1;
+	}
+	*msg = mbox->msgs[mbox->head];
+	mbox->head = (mbox->head + 1) % MSG_QUEUE_LEN;
+	mbox->count--;
+	return 0;
+}
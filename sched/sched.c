@@ -2,16 +2,165 @@
 
 /* defined in entry.S */
 extern void switch_to(struct context *next);
+/* defined in timer.c */
+extern void timer_arm(uint32_t interval);
 
+void schedule_priority(void);
 
-uint8_t task_stack[MAX_TASKS][STACK_SIZE];
-struct context ctx_tasks[MAX_TASKS];
+/* 剩余预算不足该值时视为时间片已用完，避免为很短的剩余时间再产生一次定时器中断 */
+#define MIN_TIMESLICE (CLINT_TIMEBASE_FREQ / 10000)
+/* 为1时每次调度都用 sched_check 检查就绪链表，用于调试 */
+#define SCHED_CHECK 0
+
+/* sched_check_start 之后每次调度都检查就绪链表和定时器链表，出错只计数，供自测使用 */
+static volatile int _checking = 0;
+static volatile uint32_t _check_errors = 0;
 
 TaskNode tasks_priority[MAX_PRIORITY][2]; //优先级数组，用来保存每一个优先级的任务链表的首尾
-uint8_t tasks_num[MAX_PRIORITY]; //每一个优先级中任务的数量
-uint8_t task_stack_priority[MAX_PRIORITY][MAX_TASKS][STACK_SIZE];//对应优先级的任务栈空间
+uint32_t tasks_num[MAX_PRIORITY]; //每一个优先级中就绪任务的数量，老化和唤醒会让它超过 MAX_TASKS
+#if !CONFIG_VM
+/* 任务栈在创建任务时填充，放在 .noinit 段中，启动时不需要清零 */
+uint8_t task_stack_priority[MAX_PRIORITY][MAX_TASKS][STACK_SIZE] __attribute__((aligned(16), section(".noinit")));//对应优先级的任务栈空间
+uint8_t task_stack_used[MAX_PRIORITY][MAX_TASKS]; //栈空间槽位是否已被占用
+#endif
+
+TaskNode* task_global_ptr; //正在运行的任务，全局变量暴露给timer.c
+static TaskNode* _all_tasks = NULL; //所有存活的任务，包括阻塞的任务和EDF任务
+static TaskNode* _sleep_list = NULL; //睡眠的任务，按唤醒时刻从早到晚排列
+static uint32_t _task_id_next = 0; //全局唯一的任务id
+static uint64_t _slice_start = 0; //正在运行的任务开始本次运行的时刻
+
+/*
+ * 优先级老化：就绪任务每等待 _aging_interval 个tick，有效优先级提高一级，
+ * 运行一次之后恢复到创建时的优先级。为0时关闭老化，即严格的优先级调度。
+ */
+static uint32_t _aging_interval = SCHED_AGING_INTERVAL;
+
+/*
+ * EDF(最早截止时间优先)周期任务
+ * 时间单位均为mtime的tick(CLINT_TIMEBASE_FREQ)。
+ * 每次释放时从入口函数重新开始一个作业，入口函数返回即作业完成。
+ */
+struct edf_task {
+	TaskNode node;          //任务节点，切换时和普通任务一样使用
+	struct context ctx;
+	void (*start_routin)(void* param);
+	void* param;
+	uint32_t period;
+	uint32_t wcet;
+	uint32_t deadline;      //相对截止时间
+	uint32_t util;          //wcet / min(deadline, period)，定点数，1 << EDF_UTIL_SHIFT 表示100%
+	uint64_t release;       //下一个作业的释放时刻
+	uint64_t abs_deadline;  //当前作业的绝对截止时刻
+	uint32_t misses;        //错过截止时间的作业数
+	uint8_t used;
+	uint8_t active;         //当前作业是否还未完成
+};
+
+#define MAX_EDF_TASKS CONFIG_MAX_EDF_TASKS
+#define EDF_UTIL_SHIFT 16
+
+static struct edf_task edf_tasks[MAX_EDF_TASKS];
+#if !CONFIG_VM
+static uint8_t edf_stack[MAX_EDF_TASKS][STACK_SIZE] __attribute__((aligned(16), section(".noinit")));
+#endif
+static uint32_t edf_util_total = 0;
+
+static void edf_job_end(void);
+
+/*
+ * 栈溢出检测
+ * 栈从高地址向低地址增长，创建任务时在栈的最低处写入若干个canary字，
+ * 其余部分填充为 STACK_FILL。每次切换任务时检查切出任务的canary是否完好，
+ * 被改写时和异常一样按 task_set_restart 的策略重启或者结束该任务。
+ * 从栈底向上扫描第一个不等于 STACK_FILL 的字，就得到栈使用的最高水位。
+ * 开启虚拟内存时，栈是按需分配的虚拟地址区间，下方没有映射，溢出时直接产生页错误，
+ * 不需要canary；已经分配的物理页就是栈使用的最高水位。
+ */
+#define STACK_CANARY 0xDEADBEEF
+#define STACK_CANARY_WORDS 4
+#define STACK_FILL 0xA5A5A5A5
 
-TaskNode* task_global_ptr;
+static void task_stack_init(uint8_t* stack, uint32_t size)
+{
+#if !CONFIG_VM
+	uint32_t *p = (uint32_t *)stack;
+	int i = 0;
+	for (; i < STACK_CANARY_WORDS; i++) {
+		p[i] = STACK_CANARY;
+	}
+	for (; i < size / sizeof(uint32_t); i++) {
+		p[i] = STACK_FILL;
+	}
+#endif
+}
+
+static inline int task_stack_ok(TaskNode* task_node)
+{
+#if !CONFIG_VM
+	uint32_t *p = (uint32_t *)task_node->stack;
+	for (int i = 0; i < STACK_CANARY_WORDS; i++) {
+		if (p[i] != STACK_CANARY) {
+			return 0;
+		}
+	}
+#endif
+	return 1;
+}
+
+/*
+ * 为任务分配栈
+ * 开启虚拟内存时，所有任务的栈都位于各自地址空间中相同的保留区间，第一次访问时才分配物理页；
+ * 否则内核任务使用所在优先级的栈槽位，用户任务单独占用一页
+ */
+static int task_stack_alloc(TaskNode* task_node, int priority, int user)
+{
+#if CONFIG_VM
+	task_node->stack = (uint8_t*)(VM_STACK_TOP - VM_STACK_SIZE);
+	task_node->stack_size = VM_STACK_SIZE;
+#else
+	if (user) {
+		task_node->stack = (uint8_t*)page_alloc(1);
+		task_node->stack_size = PAGE_SIZE;
+		if (task_node->stack == NULL) {
+			return -1;
+		}
+		return 0;
+	}
+	//老化会让任务在优先级之间移动，tasks_num 只表示链表长度，栈空间按槽位分配
+	int slot = 0;
+	while (slot < MAX_TASKS && task_stack_used[priority][slot]) {
+		slot++;
+	}
+	//判断任务数量是否超过最大数目
+	if (slot >= MAX_TASKS) {
+		return -1;
+	}
+	task_stack_used[priority][slot] = 1;
+	task_node->stack = task_stack_priority[priority][slot];
+	task_node->stack_size = STACK_SIZE;
+#endif
+	return 0;
+}
+
+static void task_stack_free(TaskNode* task_node, int user)
+{
+#if !CONFIG_VM
+	if (user) {
+		page_free(task_node->stack);
+	} else {
+		//归还栈空间槽位
+		task_stack_used[task_node->base_priority][(task_node->stack - task_stack_priority[task_node->base_priority][0]) / STACK_SIZE] = 0;
+	}
+#endif
+}
+
+static void idle_task(void* param)
+{
+	while (1) {
+		wfi();
+	}
+}
 
 
 void sched_init()
@@ -20,6 +169,22 @@ void sched_init()
 	/* enable machine-mode software interrupts. */
 	w_mie(r_mie() | MIE_MSIE);
 
+#if CONFIG_PMP
+	pmp_init();
+#else
+	/*
+	 * With no PMP entry configured, S-mode and U-mode can not access any
+	 * memory. Open the whole physical address space to them, paging does
+	 * the protection when it is enabled.
+	 */
+	w_pmpaddr0((reg_t)-1);
+	w_pmpcfg0(PMP_NAPOT | PMP_R | PMP_W | PMP_X);
+#endif
+
+	//允许用户任务读取cycle、time和instret计数器
+	w_mcounteren(COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
+	w_scounteren(COUNTEREN_CY | COUNTEREN_TM | COUNTEREN_IR);
+
 	for(int i_pri = 0;i_pri < MAX_PRIORITY;i_pri++){
 		tasks_priority[i_pri][0].next = &tasks_priority[i_pri][1];
 		tasks_priority[i_pri][0].pre = NULL;
@@ -27,46 +192,508 @@ void sched_init()
 		tasks_priority[i_pri][1].pre = &tasks_priority[i_pri][0];
 	}
 
+	//空闲任务占据最低优先级，保证EDF任务都在等待释放时仍有任务可调度
+	task_create_priority(idle_task, NULL, MAX_PRIORITY - 1, CLINT_TIMEBASE_FREQ);
+}
+
+static inline uint64_t edf_now()
+{
+	return clock_ticks();
+}
+
+/*
+ * 设置任务的地址空间和运行模式
+ * 用户任务运行在U模式，只能访问用户程序的代码、数据和自己的栈，通过ecall进入内核；
+ * 其他任务在开启虚拟内存时运行在S模式并拥有自己的页表，否则和内核一样运行在M模式
+ */
+static int task_space_init(TaskNode* task_node, struct context* ctx, int user)
+{
+#if CONFIG_VM
+	task_node->pagetable = user ? vm_create_user() : vm_create();
+	if (task_node->pagetable == NULL) {
+		return -1;
+	}
+	ctx->satp = vm_satp(task_node->pagetable);
+	if (ctx->satp == 0) {
+		vm_destroy(task_node->pagetable);
+		return -1;
+	}
+	ctx->mode = user ? MSTATUS_MPP_U : MSTATUS_MPP_S;
+#else
+	task_node->pagetable = NULL;
+	ctx->satp = 0;
+	ctx->mode = user ? MSTATUS_MPP_U : MSTATUS_MPP_M;
+#endif
+#if CONFIG_PMP
+	pmp_task_init(task_node, ctx);
+#endif
+	return 0;
+}
+
+//开始一个新作业：从入口函数重新执行，返回时进入 edf_job_end
+static void edf_job_start(struct edf_task *t, uint64_t release)
+{
+	t->ctx.sp = (reg_t) &t->node.stack[t->node.stack_size];
+	t->ctx.pc = (reg_t) t->start_routin;
+	t->ctx.a0 = (reg_t) t->param;
+	t->ctx.ra = (reg_t) edf_job_end;
+	t->ctx.tp = r_tp();
+	t->abs_deadline = release + t->deadline;
+	t->active = 1;
+}
+
+/*
+ * 作业的入口函数返回后来到这里，在任务上下文中执行
+ * misses 和 active 也会被定时器中断中的 edf_release 修改，通过 SYS_JOB_END 在trap中更新
+ */
+static void edf_job_end(void)
+{
+	sys_job_end();
+	//作业已完成，不会再被调度，直到下一次释放重置上下文
+	while (1) {}
+}
+
+/*
+ * this routine should be called in interrupt context (interrupt is disabled)
+ * 结束当前运行的EDF作业，统计是否错过截止时间，然后调度其他任务
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 当前任务不是EDF任务
+ */
+int edf_job_done(void)
+{
+	if (task_global_ptr == NULL || task_global_ptr->priority != TASK_PRIORITY_EDF) {
+		return -1;
+	}
+	struct edf_task *t = (struct edf_task *)task_global_ptr;
+
+	if (edf_now() > t->abs_deadline) {
+		t->misses++;
+	}
+	t->active = 0;
+	task_global_ptr->yielded = 1;
+	schedule_priority();
+	return 0;
+}
+
+/*
+ * this routine should be called in interrupt context (interrupt is disabled)
+ * 释放所有到达释放时刻的EDF作业，由定时器中断驱动
+ */
+void edf_release(void)
+{
+	uint64_t now = edf_now();
+	for (int i = 0; i < MAX_EDF_TASKS; i++) {
+		struct edf_task *t = &edf_tasks[i];
+		if (!t->used || t->release > now) {
+			continue;
+		}
+		if (t->active) {
+			//上一个作业到下一次释放时仍未完成，放弃该作业
+			t->misses++;
+		}
+		edf_job_start(t, t->release);
+		t->release += t->period;
+		//错过了多个周期时，直接对齐到当前时间之后的下一个周期
+		while (t->release <= now) {
+			t->release += t->period;
+		}
+	}
+}
+
+//返回最早的下一次释放时刻，没有EDF任务时返回全1
+uint64_t edf_next_release(void)
+{
+	uint64_t next = (uint64_t)-1;
+	for (int i = 0; i < MAX_EDF_TASKS; i++) {
+		if (edf_tasks[i].used && edf_tasks[i].release < next) {
+			next = edf_tasks[i].release;
+		}
+	}
+	return next;
+}
+
+//将任务节点接到链表尾部，不检查任务数量
+static inline void _append_taskNode(TaskNode* tail, TaskNode* task_node)
+{
+	task_node->pre = tail->pre;
+	task_node->next = tail;
+	tail->pre->next = task_node;
+	tail->pre = task_node;
+}
+
+/*
+ * 让一个任务进入阻塞状态：脱离就绪链表，直到 task_wakeup 才会再被调度
+ * 在中断上下文中调用
+ */
+void task_block(TaskNode* task_node)
+{
+	datch_taskNode(task_node);
+	tasks_num[task_node->priority]--;
+	task_node->blocked = 1;
+}
+
+//唤醒阻塞的任务，放回原来优先级链表的末尾
+void task_wakeup(TaskNode* task_node)
+{
+	task_node->blocked = 0;
+	task_node->priority = task_node->base_priority;
+	task_node->ready_since = clock_ticks();
+	_append_taskNode(&tasks_priority[task_node->priority][1], task_node);
+	tasks_num[task_node->priority]++;
+}
+
+/*
+ * 让任务睡眠 ticks 个mtime的tick，在中断上下文中调用
+ * 睡眠链表按唤醒时刻排序，定时器中断只需要检查链表头部
+ */
+void task_sleep(TaskNode* task_node, uint32_t ticks)
+{
+	task_node->wake_time = clock_ticks() + ticks;
+	task_block(task_node);
+
+	TaskNode** pp = &_sleep_list;
+	while (*pp && (*pp)->wake_time <= task_node->wake_time) {
+		pp = &(*pp)->wait_next;
+	}
+	task_node->wait_next = *pp;
+	*pp = task_node;
+}
+
+/*
+ * this routine should be called in interrupt context (interrupt is disabled)
+ * 唤醒所有到达唤醒时刻的睡眠任务
+ */
+void task_wake_sleepers(void)
+{
+	uint64_t now = clock_ticks();
+	while (_sleep_list && _sleep_list->wake_time <= now) {
+		TaskNode* task_node = _sleep_list;
+		_sleep_list = task_node->wait_next;
+		task_node->wait_next = NULL;
+		task_wakeup(task_node);
+	}
+}
+
+//下一个需要定时器中断处理的事件：EDF作业释放、睡眠任务唤醒或软件定时器超时
+uint64_t sched_next_event(void)
+{
+	uint64_t next = edf_next_release();
+	if (_sleep_list && _sleep_list->wake_time < next) {
+		next = _sleep_list->wake_time;
+	}
+#if CONFIG_TIMER
+	uint64_t expiry = timer_next_expiry();
+	if (expiry < next) {
+		next = expiry;
+	}
+#endif
+	return next;
+}
+
+/*
+ * 唤醒所有阻塞在 sys_wait(chan, ...) 上的任务
+ * 在中断上下文中调用，例如IO完成时
+ */
+void task_wake_chan(void* chan)
+{
+	for (TaskNode* node = _all_tasks; node; node = node->all_next) {
+		if (node->blocked && node->wait_chan == chan) {
+			node->wait_chan = NULL;
+			task_wakeup(node);
+		}
+	}
+}
+
+//按任务id查找任务
+TaskNode* task_find(uint32_t task_id)
+{
+	for (TaskNode* node = _all_tasks; node; node = node->all_next) {
+		if (node->task_id == task_id) {
+			return node;
+		}
+	}
+	return NULL;
+}
+
+//选出绝对截止时刻最早的就绪作业
+static struct edf_task *edf_pick(void)
+{
+	struct edf_task *best = NULL;
+	for (int i = 0; i < MAX_EDF_TASKS; i++) {
+		struct edf_task *t = &edf_tasks[i];
+		if (t->used && t->active && (best == NULL || t->abs_deadline < best->abs_deadline)) {
+			best = t;
+		}
+	}
+	return best;
+}
+
+/*
+ * 计算 wcet / d 的定点利用率，结果向上取整，保证准入控制是保守的
+ * wcet << EDF_UTIL_SHIFT 会超过32位，小数部分逐位做除法，余数用64位保存，
+ * 不需要 libgcc 的64位除法。调用者保证 wcet <= d，结果不超过 1 << EDF_UTIL_SHIFT
+ */
+static uint32_t edf_util(uint32_t wcet, uint32_t d)
+{
+	uint32_t q = wcet / d;
+	uint64_t rem = wcet % d;
+	for (int i = 0; i < EDF_UTIL_SHIFT; i++) {
+		rem <<= 1;
+		q <<= 1;
+		if (rem >= d) {
+			rem -= d;
+			q |= 1;
+		}
+	}
+	return rem ? q + 1 : q;
+}
+
+//时间片轮转：将任务移到同优先级链表的末尾
+static void task_rotate(TaskNode* task_node)
+{
+	datch_taskNode(task_node);
+	_append_taskNode(&tasks_priority[task_node->priority][1], task_node);
+}
+
+/*
+ * 回收已经调用 task_exit 的任务，在中断上下文中执行
+ * 该任务的寄存器已经保存在它的上下文中，之后不会再被使用，可以直接释放
+ */
+static void task_reap(TaskNode* task_node)
+{
+	for (TaskNode** pp = &_all_tasks; *pp; pp = &(*pp)->all_next) {
+		if (*pp == task_node) {
+			*pp = task_node->all_next;
+			break;
+		}
+	}
+	if (task_node->pagetable) {
+		vm_free_asid(task_node->task->satp);
+		vm_destroy(task_node->pagetable);
+	}
+	arena_destroy(task_node->arena);
+	task_node->arena = NULL;
+	//EDF任务使用静态分配的节点和栈，只需要归还槽位和利用率
+	if (task_node->priority == TASK_PRIORITY_EDF) {
+		struct edf_task *t = (struct edf_task *)task_node;
+		t->used = 0;
+		t->active = 0;
+		edf_util_total -= t->util;
+		return;
+	}
+	if (!task_node->blocked) {
+		datch_taskNode(task_node);
+		tasks_num[task_node->priority]--;
+	}
+	task_stack_free(task_node, task_node->task->mode == MSTATUS_MPP_U);
+	my_free(task_node->task);
+	my_free(task_node);
+}
+
+//将任务移到另一个优先级链表的末尾
+static void task_move(TaskNode* task_node, int priority)
+{
+	datch_taskNode(task_node);
+	tasks_num[task_node->priority]--;
+	_append_taskNode(&tasks_priority[priority][1], task_node);
+	tasks_num[priority]++;
+	task_node->priority = priority;
+}
+
+/*
+ * 提升等待过久的就绪任务的有效优先级
+ * 最低优先级留给空闲任务，不参与老化
+ */
+static void task_aging(uint64_t now)
+{
+	for (int p = 1; p < MAX_PRIORITY - 1; p++) {
+		TaskNode * node = tasks_priority[p][0].next;
+		while (node != &tasks_priority[p][1]) {
+			TaskNode * next = node->next;
+			uint64_t waited = now - node->ready_since;
+			uint32_t boost = waited > 0xFFFFFFFF ? MAX_PRIORITY : (uint32_t)waited / _aging_interval;
+			int target = node->base_priority - (int)(boost < MAX_PRIORITY ? boost : MAX_PRIORITY);
+			if (target < 0) {
+				target = 0;
+			}
+			//p是从高到低遍历的，提升后的任务不会被再次访问
+			if (target < p) {
+				task_move(node, target);
+			}
+			node = next;
+		}
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	设置优先级老化的间隔，就绪任务每等待 interval 个tick提高一级优先级.
+ * 	- interval: 0 表示关闭老化
+ */
+void sched_set_aging(uint32_t interval)
+{
+	_aging_interval = interval;
+}
+
+/*
+ * DESCRIPTION
+ * 	检查就绪链表的不变式，调度时 SCHED_CHECK 为1才检查:
+ * 	- 双向链表的前后指针一致，从头部哨兵能走到尾部哨兵
+ * 	- 链表中任务的 priority 就是所在的优先级，并且没有阻塞
+ * 	- 链表长度等于 tasks_num
+ * RETURN VALUE
+ * 	0: 通过
+ * 	-1: 链表被破坏，输出出错的优先级
+ */
+int sched_check(void)
+{
+	for (int p = 0; p < MAX_PRIORITY; p++) {
+		TaskNode* head = &tasks_priority[p][0];
+		TaskNode* tail = &tasks_priority[p][1];
+		uint32_t n = 0;
+		TaskNode* node;
+		for (node = head; node != tail; node = node->next) {
+			if (node->next == NULL || node->next->pre != node || n > MAX_TASKS * MAX_PRIORITY) {
+				printf("sched_check: priority %d: broken link after %d tasks\n", p, n);
+				return -1;
+			}
+			if (node != head) {
+				if (node->priority != p || node->blocked) {
+					printf("sched_check: priority %d: task %d has priority %d, blocked %d\n",
+						p, node->task_id, node->priority, node->blocked);
+					return -1;
+				}
+				n++;
+			}
+		}
+		if (n != tasks_num[p]) {
+			printf("sched_check: priority %d: %d tasks in list, tasks_num %d\n", p, n, tasks_num[p]);
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	开始在每次调度时用 sched_check 和 timer_list_check 检查就绪链表和定时器链表.
+ * 	供自测使用，可以在任务中调用，出错的次数由 sched_check_stop 返回。
+ */
+void sched_check_start(void)
+{
+	_check_errors = 0;
+	_checking = 1;
+}
+
+/*
+ * DESCRIPTION
+ * 	停止调度时的检查.
+ * RETURN VALUE
+ * 	sched_check_start 之后检查出错的次数
+ */
+uint32_t sched_check_stop(void)
+{
+	_checking = 0;
+	return _check_errors;
 }
 
 /*
  * 实现基于优先级的FIFO任务调度算法
+ * 每个任务都有自己的时间片预算，调度时先结算切出任务本次运行用掉的时间：
+ * - 预算用完：重新装满预算，移到同优先级链表末尾，即时间片轮转
+ * - 主动让出CPU：移到链表末尾，但保留剩余的预算，下次运行时继续使用
+ * - 被抢占：留在链表头部，保留剩余的预算
+ * 被老化提升过优先级的任务运行之后回到原来的优先级。
+ * 再按切入任务的剩余预算设置下一次定时器中断。
  */
+static void task_dump_context(struct context* ctx);
+static void task_fault_recover(TaskNode* task_node);
 
 void schedule_priority()
 {
-	
-	//确定优先级
-	int priority = 0;
-	while(priority < MAX_PRIORITY){
-		if(tasks_num[priority] > 0){
-			break;
+	uint64_t now = clock_ticks();
+	TaskNode * cur_node = task_global_ptr;
+	TaskNode * next_node;
+
+	//切出的任务写穿了自己的栈，当作任务出错处理：按 task_set_restart 的策略重启或者结束它，其他任务继续运行
+	if (cur_node && !task_stack_ok(cur_node)) {
+		printf("task %d: stack overflow, stack 0x%x\n", cur_node->task_id, cur_node->stack);
+		task_dump_context(cur_node->task);
+		task_fault_recover(cur_node);
+	}
+
+	if (cur_node && cur_node->exiting) {
+		task_reap(cur_node);
+		cur_node = NULL;
+	}
+
+	//结算切出的任务，EDF任务不参与时间片轮转
+	if (cur_node && cur_node->priority != TASK_PRIORITY_EDF) {
+		uint32_t used = now - _slice_start;
+		int exhausted = used + MIN_TIMESLICE >= cur_node->budget;
+		cur_node->budget = exhausted ? cur_node->timeslice : cur_node->budget - used;
+		//阻塞的任务已经离开了就绪链表，被唤醒时会回到原来的优先级
+		if (!cur_node->blocked) {
+			if (cur_node->priority != cur_node->base_priority) {
+				task_move(cur_node, cur_node->base_priority);
+			} else if (exhausted || cur_node->yielded) {
+				task_rotate(cur_node);
+			}
 		}
-		priority++;
+		cur_node->yielded = 0;
+		cur_node->ready_since = now;
 	}
-	
-	//记录下要调用的下一个任务
-	struct context *next = tasks_priority[priority][0].next->task;
-	TaskNode * next_node = tasks_priority[priority][0].next;
-	
-	//将该任务移到链表末尾
-	datch_taskNode(next_node);
-	add_taskNode(&tasks_priority[priority][0], &tasks_priority[priority][1], next_node, priority);
 
-	//记录下一个将要调用的任务信息，全局变量暴露给timer.c
-	task_global_ptr = tasks_priority[priority][0].next;
+	if (_aging_interval) {
+		task_aging(now);
+	}
+
+#if SCHED_CHECK
+	if (sched_check() < 0) {
+		panic("sched_check");
+	}
+#endif
+	if (_checking) {
+		_check_errors += sched_check() < 0;
+#if CONFIG_TIMER
+		_check_errors += timer_list_check() < 0;
+#endif
+	}
+
+	//EDF任务的优先级高于所有固定优先级任务
+	struct edf_task *edf = edf_pick();
+	if (edf) {
+		next_node = &edf->node;
+		//EDF作业一直运行到完成，只在下一次释放时重新检查截止时间
+		timer_arm((uint32_t)-1);
+	} else {
+		//确定优先级
+		int priority = 0;
+		while(priority < MAX_PRIORITY){
+			if(tasks_num[priority] > 0){
+				break;
+			}
+			priority++;
+		}
+
+		//链表头部就是下一个要运行的任务
+		next_node = tasks_priority[priority][0].next;
+		//为切入的任务设置抢占定时器
+		timer_arm(next_node->budget);
+	}
+
+	trace_event(TRACE_EV_SWITCH, cur_node ? cur_node->task_id : (uint32_t)-1, next_node->task_id);
+	task_global_ptr = next_node;
+	_slice_start = now;
 	//跳转
-	switch_to(next);
-	
+	switch_to(next_node->task);
 }
 
 //将任务节点添加到任务链表尾部
 int add_taskNode(TaskNode* first, TaskNode* tail, TaskNode* task_new_node, int priority){
 	if (tasks_num[priority] < MAX_TASKS){
-		task_new_node->pre = tail->pre;
-		task_new_node->next = tail;
-		tail->pre->next = task_new_node;
-		tail->pre = task_new_node;		
+		_append_taskNode(tail, task_new_node);
 		return 0;
 	}else{
 		printf("超出最大任务数\n");
@@ -81,63 +708,403 @@ int datch_taskNode(TaskNode* task_node){
 	task_node->pre = NULL;
 	return 0;
 }
+//初始化任务节点中和调度相关的字段，并登记到任务表中
+static void task_node_init(TaskNode* task_node, struct context* ctx, int priority, uint32_t timeslice)
+{
+	task_node->task = ctx;
+	task_node->task_id = _task_id_next++;
+	task_node->priority = priority;
+	task_node->base_priority = priority;
+	task_node->ready_since = clock_ticks();
+	task_node->exiting = 0;
+	task_node->restarts = 0;
+	task_node->blocked = 0;
+	task_node->wait_next = NULL;
+	task_node->waiting_msg = 0;
+	task_node->wait_chan = NULL;
+	task_node->mbox.head = 0;
+	task_node->mbox.count = 0;
+	task_node->arena = NULL;
+	//设置运行时间片
+	task_node->timeslice = timeslice;
+	task_node->budget = timeslice;
+	task_node->yielded = 0;
+
+	task_node->all_next = _all_tasks;
+	_all_tasks = task_node;
+}
+
+static int _task_create(const struct task_args* a)
+{
+	void (*start_routin)(void* param) = a->entry;
+	void* param = a->param;
+	int priority = a->priority;
+	uint32_t timeslice = a->timeslice;
+	int user = a->user;
+	//创建上下文和任务节点
+	struct context* ctx_task = (struct context*)my_malloc(sizeof(struct context));
+	TaskNode* task_new_node = (TaskNode*)my_malloc(sizeof(TaskNode));
+	task_new_node->base_priority = priority;
+	if (task_stack_alloc(task_new_node, priority, user) < 0) {
+		my_free(task_new_node);
+		my_free(ctx_task);
+		return -1;
+	}
+	if (task_space_init(task_new_node, ctx_task, user) < 0) {
+		task_stack_free(task_new_node, user);
+		my_free(task_new_node);
+		my_free(ctx_task);
+		return -1;
+	}
+#if CONFIG_VM
+	//在任务加入就绪链表之前加载程序，入口地址由加载函数给出
+	if (a->load) {
+		reg_t entry;
+		if (a->load(task_new_node->pagetable, a->image, a->size, &entry) < 0) {
+			vm_free_asid(ctx_task->satp);
+			vm_destroy(task_new_node->pagetable);
+			task_stack_free(task_new_node, user);
+			my_free(task_new_node);
+			my_free(ctx_task);
+			return -1;
+		}
+		start_routin = (void (*)(void*)) entry;
+	}
+#endif
+	uint8_t* stack = task_new_node->stack;
+	uint32_t stack_size = task_new_node->stack_size;
+	task_stack_init(stack, stack_size);
+	//栈顶按16字节对齐
+	ctx_task->sp = (reg_t) &stack[stack_size];
+	ctx_task->pc = (reg_t) start_routin;
+	ctx_task->a0 = (reg_t) param;
+	ctx_task->tp = r_tp(); //tp中保存hartid
+	//任务入口函数返回时退出该任务
+	ctx_task->ra = user ? (reg_t) sys_exit : (reg_t) task_exit;
+
+	task_node_init(task_new_node, ctx_task, priority, timeslice);
+	task_new_node->entry = start_routin;
+	task_new_node->param = param;
+
+	//加入到对应优先级的任务链表
+	_append_taskNode(&tasks_priority[priority][1], task_new_node);
+
+	//递增任务数量
+	tasks_num[priority]++;
+	return task_new_node->task_id;
+}
+
+static int _task_create_periodic(const struct task_args* a)
+{
+	uint32_t period = a->period;
+	uint32_t wcet = a->wcet;
+	uint32_t deadline = a->deadline;
+
+	if (deadline == 0 || deadline > period) {
+		deadline = period;
+	}
+	if (a->entry == NULL || wcet == 0 || wcet > deadline) {
+		return -1;
+	}
+
+	uint32_t util = edf_util(wcet, deadline);
+	if (edf_util_total + util > (1 << EDF_UTIL_SHIFT)) {
+		printf("EDF admission failed, total utilization would exceed 1\n");
+		return -1;
+	}
+
+	for (int i = 0; i < MAX_EDF_TASKS; i++) {
+		struct edf_task *t = &edf_tasks[i];
+		if (t->used) {
+			continue;
+		}
+#if CONFIG_VM
+		t->node.stack = (uint8_t*)(VM_STACK_TOP - VM_STACK_SIZE);
+		t->node.stack_size = VM_STACK_SIZE;
+#else
+		t->node.stack = edf_stack[i];
+		t->node.stack_size = STACK_SIZE;
+#endif
+		if (task_space_init(&t->node, &t->ctx, 0) < 0) {
+			return -1;
+		}
+		task_stack_init(t->node.stack, t->node.stack_size);
+		task_node_init(&t->node, &t->ctx, TASK_PRIORITY_EDF, wcet);
+		t->node.entry = a->entry;
+		t->node.param = a->param;
+		t->start_routin = a->entry;
+		t->param = a->param;
+		t->period = period;
+		t->wcet = wcet;
+		t->deadline = deadline;
+		t->util = util;
+		t->misses = 0;
+
+		//第一个作业立即释放
+		uint64_t now = edf_now();
+		edf_job_start(t, now);
+		t->release = now + period;
+		edf_util_total += util;
+		t->used = 1;
+		//trap返回之后按新的释放时刻重新设置定时器
+		sched_resched();
+		return i;
+	}
+	return -1;
+}
+
+/*
+ * DESCRIPTION
+ * 	按照 a 创建任务，a->periodic 不为0时创建EDF周期任务.
+ * 	就绪链表、任务表和EDF任务表只在启动过程和trap中修改，
+ * 	任务中调用时通过 SYS_TASK_CREATE 进入trap再创建，不会和调度器竞争。
+ * 	开启虚拟内存时 a->image 必须位于内核的内存中(堆、数据段或romfs)，不能在调用者的栈上。
+ * RETURN VALUE
+ * 	与 task_create_priority、task_create_periodic 相同
+ */
+int task_create_args(const struct task_args* a)
+{
+	if (!trap_context()) {
+		return sys_task_create(a);
+	}
+	if (a->periodic) {
+		return _task_create_periodic(a);
+	}
+	return _task_create(a);
+}
+
 /*
  * DESCRIPTION
  * 	创建带有优先级的任务.
  * 	- start_routin: 任务入口
  * RETURN VALUE
- * 	0: 成功
+ * 	>=0: 任务id
  * 	-1: 出错
  */
 int task_create_priority(void (*start_routin)(void* param), void* param, int priority, uint32_t timeslice)
 {
-	//判断任务数量是否超过最大数目
-	if (tasks_num[priority] < MAX_TASKS) {
-		//创建上下文
-		struct context* ctx_task = (struct context*)my_malloc(sizeof(struct context));
-		ctx_task->sp = (reg_t) &task_stack_priority[priority][tasks_num[priority]][STACK_SIZE - 1];
-		ctx_task->pc = (reg_t) start_routin;
-		ctx_task->a0 = (reg_t) param;
-		//创建任务节点
-		TaskNode* task_new_node = (TaskNode*)my_malloc(sizeof(TaskNode));
-		task_new_node->task = ctx_task;
-		task_new_node->task_id = tasks_num[priority];
-		//设置运行时间片
-		task_new_node->timeslice = timeslice;
-
-		//加入到对应优先级的任务链表
-		add_taskNode(&tasks_priority[priority][0], &tasks_priority[priority][1], task_new_node, priority);
-
-		//递增任务数量
-		tasks_num[priority]++;
+	struct task_args a = {
+		.entry = start_routin, .param = param, .priority = priority, .timeslice = timeslice,
+	};
+	return task_create_args(&a);
+}
+
+/*
+ * DESCRIPTION
+ * 	创建运行在U模式的用户任务，参数与 task_create_priority 相同.
+ * 	用户任务的代码和数据必须位于 user/ 目录下，链接在 .utext/.udata 段中，
+ * 	只能通过 sys_* 系统调用使用内核的服务。
+ * RETURN VALUE
+ * 	>=0: 任务id
+ * 	-1: 出错
+ */
+int task_create_user(void (*start_routin)(void* param), void* param, int priority, uint32_t timeslice)
+{
+	struct task_args a = {
+		.entry = start_routin, .param = param, .priority = priority, .timeslice = timeslice, .user = 1,
+	};
+	return task_create_args(&a);
+}
+
+/*
+ * DESCRIPTION
+ * 	创建U模式的用户任务，程序不链接在内核中，而是由 load 从 image 加载到任务的页表中.
+ * 	load 返回之后任务才加入就绪链表，其余参数与 task_create_priority 相同。
+ * 	需要 CONFIG_VM，每个任务有自己的地址空间。
+ * RETURN VALUE
+ * 	>=0: 任务id
+ * 	-1: 出错、加载失败或者没有开启虚拟内存
+ */
+int task_create_loaded(task_loader_t load, const void* image, uint32_t size, void* param, int priority, uint32_t timeslice)
+{
+#if CONFIG_VM
+	struct task_args a = {
+		.param = param, .priority = priority, .timeslice = timeslice, .user = 1,
+		.load = load, .image = image, .size = size,
+	};
+	return task_create_args(&a);
+#else
+	return -1;
+#endif
+}
+
+/*
+ * DESCRIPTION
+ * 	创建EDF周期任务，每个周期从 start_routin 开始执行一个作业.
+ * 	- period: 周期
+ * 	- wcet: 最坏情况执行时间
+ * 	- deadline: 相对截止时间，0 表示等于周期
+ * 	时间单位均为mtime的tick。
+ * 	准入控制使用利用率上界：所有EDF任务的 wcet / min(deadline, period) 之和不超过1。
+ * RETURN VALUE
+ * 	>=0: EDF任务编号，用于查询错过截止时间的次数
+ * 	-1: 参数错误、超出最大任务数或无法通过准入控制
+ */
+int task_create_periodic(void (*start_routin)(void* param), void* param, uint32_t period, uint32_t wcet, uint32_t deadline)
+{
+	struct task_args a = {
+		.entry = start_routin, .param = param, .periodic = 1,
+		.period = period, .wcet = wcet, .deadline = deadline,
+	};
+	return task_create_args(&a);
+}
+
+/*
+ * RETURN VALUE
+ * 	EDF任务 id 错过截止时间的作业数，id 无效时返回0
+ */
+uint32_t task_deadline_misses(int id)
+{
+	if (id < 0 || id >= MAX_EDF_TASKS || !edf_tasks[id].used) {
 		return 0;
-	} else {
+	}
+	return edf_tasks[id].misses;
+}
+
+void task_exit()
+{
+	//任务可能运行在S模式，无法关中断，由调度器在中断上下文中回收该任务
+	task_global_ptr->exiting = 1;
+	task_yield();
+	//该任务不会再被调度
+	while (1) {}
+}
+
+/*
+ * DESCRIPTION
+ * 	统计任务栈使用的最高水位.
+ * RETURN VALUE
+ * 	任务运行以来使用过的最大栈空间(字节)
+ */
+uint32_t task_stack_high_water(TaskNode* task_node)
+{
+#if CONFIG_VM
+	return vm_committed(task_node->pagetable, (uint32_t)task_node->stack, task_node->stack_size);
+#else
+	uint32_t *p = (uint32_t *)task_node->stack;
+	int i = STACK_CANARY_WORDS;
+	while (i < task_node->stack_size / sizeof(uint32_t) && p[i] == STACK_FILL) {
+		i++;
+	}
+	return task_node->stack_size - i * sizeof(uint32_t);
+#endif
+}
+
+//输出所有任务的栈使用情况
+void task_stack_report(void)
+{
+	for (TaskNode * node = _all_tasks; node; node = node->all_next) {
+		printf("task %d: priority %d, stack used %d / %d bytes%s\n", node->task_id, node->base_priority,
+			task_stack_high_water(node), node->stack_size, task_stack_ok(node) ? "" : ", OVERFLOW");
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	设置任务出错后自动重启的次数，默认为0，即出错时结束该任务.
+ * 	EDF任务出错时只放弃当前作业，下一次释放时重新开始，次数用完之后才结束该任务。
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 任务不存在
+ */
+int task_set_restart(uint32_t task_id, uint32_t max_restarts)
+{
+	TaskNode* task_node = task_find(task_id);
+	if (task_node == NULL) {
 		return -1;
 	}
+	task_node->restarts = max_restarts;
+	return 0;
 }
 
+//从入口函数重新开始运行任务，保留任务id、优先级和地址空间
+static void task_restart(TaskNode* task_node)
+{
+	struct context* ctx = task_node->task;
+	reg_t* regs = (reg_t*)ctx;
 
+	//重启的任务从头开始，之前从区域中分配的对象都不再使用
+	arena_destroy(task_node->arena);
+	task_node->arena = NULL;
 
-void task_exit()
+	if (task_node->priority == TASK_PRIORITY_EDF) {
+		struct edf_task *t = (struct edf_task *)task_node;
+		t->misses++;
+		t->active = 0;
+		//下一次释放时作业从头开始，栈上没有需要保留的内容
+		task_stack_init(task_node->stack, task_node->stack_size);
+		return;
+	}
+
+	//通用寄存器清零，pc之后的地址空间和PMP设置保持不变
+	for (int i = 0; i < 31; i++) {
+		regs[i] = 0;
+	}
+	task_stack_init(task_node->stack, task_node->stack_size);
+	ctx->sp = (reg_t) &task_node->stack[task_node->stack_size];
+	ctx->pc = (reg_t) task_node->entry;
+	ctx->a0 = (reg_t) task_node->param;
+	ctx->tp = r_tp();
+	ctx->ra = ctx->mode == MSTATUS_MPP_U ? (reg_t) sys_exit : (reg_t) task_exit;
+	task_node->mbox.head = 0;
+	task_node->mbox.count = 0;
+	task_node->budget = task_node->timeslice;
+}
+
+/*
+ * 按 task_set_restart 设置的策略处理出错的任务：还有重启次数时重启，否则标记为退出，
+ * 由调度器回收。在中断上下文中调用
+ */
+static void task_fault_recover(TaskNode* task_node)
 {
-	//既然当前任务在调用这函数，则说明该任务优先级最高
-	//确定优先级
-	int priority = 0;
-	while(priority < MAX_PRIORITY){
-		if(tasks_num[priority] > 0){
-			break;
-		}
-		priority++;
+	if (task_node->restarts > 0) {
+		task_node->restarts--;
+		printf("task %d: restarting, %d restarts left\n", task_node->task_id, task_node->restarts);
+		task_restart(task_node);
+	} else {
+		printf("task %d: killed\n", task_node->task_id);
+		task_node->exiting = 1;
 	}
+}
 
-	//首先记录下当前调用的任务
-	TaskNode * cur_node = tasks_priority[priority][1].pre;
-	//将该任务节点脱离链表
-	datch_taskNode(cur_node);
-	//释放该节点的内存
-	my_free(cur_node);
-	tasks_num[priority]--;
-	return;
+//输出上下文中保存的寄存器
+static void task_dump_context(struct context* ctx)
+{
+	static const char* names[31] = {
+		"ra", "sp", "gp", "tp", "t0", "t1", "t2", "s0", "s1", "a0", "a1",
+		"a2", "a3", "a4", "a5", "a6", "a7", "s2", "s3", "s4", "s5", "s6",
+		"s7", "s8", "s9", "s10", "s11", "t3", "t4", "t5", "t6",
+	};
+	reg_t* regs = (reg_t*)ctx;
+	for (int i = 0; i < 31; i++) {
+		printf("%s%s = 0x%x%s", i % 4 ? "" : "  ", names[i], regs[i], i % 4 == 3 || i == 30 ? "\n" : "  ");
+	}
+}
+
+/*
+ * DESCRIPTION
+ * 	处理任务触发的同步异常，在 trap_handler 中调用.
+ * 	输出出错的任务、mcause/mepc/mtval 和寄存器，然后只结束这一个任务并回收它的资源，
+ * 	或者按照 task_set_restart 设置的策略重启它，其他任务继续运行。
+ * 	- ctx: 出错任务的上下文
+ * RETURN VALUE
+ * 	异常由任务触发时切换到其他任务，不会返回；
+ * 	异常发生在内核自身(启动阶段或中断处理中)时返回，由调用者处理。
+ */
+void task_fault(struct context* ctx, reg_t cause, reg_t epc, reg_t tval)
+{
+	TaskNode* task_node = task_global_ptr;
+
+	//任务运行时总是开着中断，MPIE为0说明异常发生在中断处理程序中
+	if (task_node == NULL || task_node->task != ctx || !(r_mstatus() & MSTATUS_MPIE)) {
+		return;
+	}
+
+	printf("task %d: exception, mcause = 0x%x, mepc = 0x%x, mtval = 0x%x\n",
+		task_node->task_id, cause, epc, tval);
+	task_dump_context(ctx);
+	task_fault_recover(task_node);
+	schedule_priority();
 }
 
 /*
@@ -148,9 +1115,26 @@ void task_exit()
  */
 void task_yield()
 {
+	//主动让出的任务在调度时移到链表末尾，并保留剩余的时间片预算
+	if (task_global_ptr) {
+		task_global_ptr->yielded = 1;
+	}
 	/* trigger a machine-level software interrupt */
-	int id = r_mhartid();
-	*(uint32_t*)CLINT_MSIP(id) = 1;
+	int id = r_tp(); // mhartid is not readable when the task runs in S-mode
+	*(volatile uint32_t*)CLINT_MSIP(id) = 1;
+	//切换回来时其他任务可能修改了内存，不能沿用让出之前读到的值
+	__sync_synchronize();
+}
+
+/*
+ * 请求调度器在中断上下文中重新选择任务并设置定时器，可以在任务中调用
+ * 和 task_yield 不同，当前任务不会被移到同优先级链表的末尾，时间片预算照常结算
+ */
+void sched_resched(void)
+{
+	int id = r_tp();
+	*(volatile uint32_t*)CLINT_MSIP(id) = 1;
+	__sync_synchronize();
 }
 
 /*
@@ -162,3 +1146,77 @@ void task_delay(volatile int count)
 	while (count--);
 }
 
+/*
+ * sched_test 的随机压力测试：创建 SCHED_TEST_TASKS 个和调用者同优先级的任务，
+ * 每个任务随机让出、睡眠或者忙等到被抢占，走真实的创建、轮转、阻塞、唤醒和回收路径，
+ * 每次调度都用 sched_check 检查就绪链表和 tasks_num
+ */
+#define SCHED_TEST_TASKS 8
+#define SCHED_TEST_OPS 20000 // 所有测试任务的操作总数
+#define SCHED_TEST_MAX_SLEEP (CLINT_TIMEBASE_FREQ / 10000) // mtime tick
+#define SCHED_TEST_TIMESLICE (CLINT_TIMEBASE_FREQ / 1000)
+
+static volatile uint32_t _test_done; // 已经结束的测试任务数
+
+static void _sched_test_task(void* param)
+{
+	uint32_t seed = (uint32_t)(uintptr_t)param;
+
+	for (int op = 0; op < SCHED_TEST_OPS / SCHED_TEST_TASKS; op++) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t r = seed >> 8;
+		switch (r % 4) {
+		case 0:
+			task_yield(); // task_rotate
+			break;
+		case 1:
+			sys_sleep(1 + (r >> 2) % SCHED_TEST_MAX_SLEEP); // task_block, task_wakeup
+			break;
+		default:
+			task_delay((r >> 2) % 1024); // 时间片用完时被抢占
+			break;
+		}
+	}
+	__sync_fetch_and_add(&_test_done, 1);
+	//返回时进入 task_exit，由调度器回收，tasks_num 减一
+}
+
+/*
+ * DESCRIPTION
+ * 	调度器的随机压力测试，只能在任务中调用. 结束之后调用者优先级的 tasks_num 必须恢复原值。
+ * RETURN VALUE
+ * 	出错的次数
+ */
+int sched_test(void)
+{
+	int priority = task_global_ptr->base_priority;
+	uint32_t before = tasks_num[priority];
+	int created = 0;
+	int errors = 0;
+
+	_test_done = 0;
+	sched_check_start();
+	for (int i = 0; i < SCHED_TEST_TASKS; i++) {
+		if (task_create_priority(_sched_test_task, (void*)(uintptr_t)(i + 1), priority, SCHED_TEST_TIMESLICE) >= 0) {
+			created++;
+		}
+	}
+	if (created == 0) {
+		printf("sched_test: cannot create tasks at priority %d\n", priority);
+		errors++;
+	}
+	while (_test_done < created) {
+		sys_sleep(CLINT_TIMEBASE_FREQ / 100);
+	}
+	//最后一个任务可能还没有退出
+	sys_sleep(CLINT_TIMEBASE_FREQ / 100);
+	errors += sched_check_stop();
+
+	if (tasks_num[priority] != before) {
+		printf("sched_test: priority %d has %d ready tasks, %d before the test\n",
+			priority, tasks_num[priority], before);
+		errors++;
+	}
+	printf("sched_test: %d tasks, %d ops, %d errors\n", created, SCHED_TEST_OPS, errors);
+	return errors;
+}
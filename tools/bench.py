@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+"""
+Collect the results of the RVOS micro-benchmarks and compare them with a
+stored baseline.
+
+"make bench" boots os-bench.elf (bench/bench.c) under QEMU and saves the
+console output to build/rv<XLEN>/<profile>/bench.log. Every benchmark
+prints one line:
+
+    BENCH <name> <iterations> <cycles per iteration>
+
+and the run ends with BENCH_END. Then:
+
+    python3 tools/bench.py --profile debug --init bench.log bench/baseline-rv32-debug.json
+
+prints a table against the baseline and exits with status 1 if a
+benchmark got slower than the threshold (default 20 percent), if one is
+missing, or if the run did not finish. A benchmark added after the
+baseline was taken is reported but does not fail. Every XLEN and build
+profile keeps its own baseline: cycle counts of the debug and release
+builds differ by far more than the threshold, so comparing against a
+baseline of another profile is an error, and so is an empty baseline.
+With --init a missing baseline is not an error: the results of this run
+are stored as the baseline and the script says so. That is what "make
+bench" does, so the first run on a fresh checkout records the baseline
+that later runs are compared against; commit it to share it. Without
+--init a missing baseline is an error. To replace the baseline with the
+current results:
+
+    python3 tools/bench.py --profile debug --update bench.log bench/baseline-rv32-debug.json
+
+which is what "make bench-baseline" does after "make bench-run".
+"""
+
+import argparse
+import json
+import os
+import sys
+
+
+def parse(path):
+    results = {}
+    finished = False
+    with open(path, errors="replace") as f:
+        for line in f:
+            fields = line.split()
+            if not fields:
+                continue
+            if fields[0] == "BENCH_END":
+                finished = True
+            elif fields[0] == "BENCH" and len(fields) == 4:
+                results[fields[1]] = {"iters": int(fields[2]), "cycles": int(fields[3])}
+    return results, finished
+
+
+def compare(results, baseline, threshold):
+    ok = True
+    print("%-16s %12s %12s %8s" % ("benchmark", "baseline", "current", "change"))
+    for name in sorted(set(results) | set(baseline)):
+        base = baseline.get(name)
+        cur = results.get(name)
+        if cur is None:
+            print("%-16s %12d %12s %8s  MISSING" % (name, base["cycles"], "-", "-"))
+            ok = False
+            continue
+        if base is None:
+            print("%-16s %12s %12d %8s  NEW" % (name, "-", cur["cycles"], "-"))
+            continue
+        change = (cur["cycles"] - base["cycles"]) * 100.0 / max(base["cycles"], 1)
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            ok = False
+        print("%-16s %12d %12d %+7.1f%%%s" % (name, base["cycles"], cur["cycles"], change, flag))
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("log", help="QEMU console output of the benchmark build")
+    parser.add_argument("baseline", help="baseline JSON file")
+    parser.add_argument("--update", action="store_true", help="store the results as the new baseline")
+    parser.add_argument("--init", action="store_true",
+                        help="store the results as the baseline if there is none yet")
+    parser.add_argument("--profile", default="debug", help="build profile the log was produced with")
+    parser.add_argument("--threshold", type=float, default=20.0,
+                        help="allowed slowdown in percent before failing")
+    args = parser.parse_args()
+
+    results, finished = parse(args.log)
+    if not finished:
+        sys.stderr.write("bench: %s has no BENCH_END, the run crashed or timed out\n" % args.log)
+        sys.exit(1)
+
+    if args.update or (args.init and not os.path.exists(args.baseline)):
+        if not results:
+            sys.stderr.write("bench: %s has no results, not storing an empty baseline\n" % args.log)
+            sys.exit(1)
+        with open(args.baseline, "w") as f:
+            json.dump({"profile": args.profile, "results": results}, f, indent=1, sort_keys=True)
+            f.write("\n")
+        if not args.update:
+            print("bench: no baseline yet, recorded this run as %s; later runs are compared"
+                  " against it, commit it to share it" % args.baseline)
+        print("bench: stored %d results of the %s profile in %s"
+              % (len(results), args.profile, args.baseline))
+        return
+
+    if not os.path.exists(args.baseline):
+        sys.stderr.write("bench: no baseline %s, store one with \"make bench-baseline\"\n"
+                         % args.baseline)
+        sys.exit(1)
+    with open(args.baseline) as f:
+        stored = json.load(f)
+    baseline = stored.get("results", {})
+    if not baseline:
+        sys.stderr.write("bench: baseline %s is empty, store one with \"make bench-baseline\"\n"
+                         % args.baseline)
+        sys.exit(1)
+    if stored.get("profile") != args.profile:
+        sys.stderr.write("bench: baseline %s was measured with the %s profile, not %s\n"
+                         % (args.baseline, stored.get("profile", "unknown"), args.profile))
+        sys.exit(1)
+    if not compare(results, baseline, args.threshold):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,59 @@
+#!/usr/bin/env python3
+"""
+Generate config.h, the compile-time configuration of the RVOS kernel.
+
+The options and their defaults live in common.mk as CONFIG_* make
+variables; the Makefile passes them here before anything is compiled:
+
+    python3 tools/mkconfig.py config.h CONFIG_MAX_TASKS=10 CONFIG_TIMER=1 ...
+
+so any of them can be overridden on the make command line, for example
+
+    make CONFIG_MAX_PRIORITY=8 CONFIG_TRACE=0 CONFIG_UART_RX=0
+
+Every value must be an integer. Each option is emitted inside #ifndef, so
+a -DCONFIG_...=... on the compiler command line still wins (the bench
+build uses that for CONFIG_BENCH).
+
+config.h is only rewritten when its contents change, so make rebuilds the
+kernel after a configuration change and not otherwise.
+"""
+
+import sys
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("usage: mkconfig.py config.h [CONFIG_NAME=value ...]")
+    path = sys.argv[1]
+
+    lines = [
+        "/* generated by tools/mkconfig.py from common.mk, do not edit */",
+        "#ifndef __CONFIG_H__",
+        "#define __CONFIG_H__",
+        "",
+    ]
+    for arg in sys.argv[2:]:
+        name, sep, value = arg.partition("=")
+        if not sep or not name.startswith("CONFIG_"):
+            sys.exit("mkconfig.py: bad option %r" % arg)
+        try:
+            int(value, 0)
+        except ValueError:
+            sys.exit("mkconfig.py: %s must be an integer, got %r" % (name, value))
+        lines += ["#ifndef %s" % name, "#define %s %s" % (name, value), "#endif"]
+    lines += ["", "#endif /* __CONFIG_H__ */", ""]
+    text = "\n".join(lines)
+
+    try:
+        with open(path) as f:
+            if f.read() == text:
+                return
+    except OSError:
+        pass
+    with open(path, "w") as f:
+        f.write(text)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Pack a host directory into an RVOS romfs image.
+
+The image is linked into the kernel by fs/romfs_image.S (section .romfs,
+see os.ld) and read in place by fs/romfs.c, so file data is never copied:
+
+    python3 tools/mkromfs.py romfs romfs.img [name=file ...]
+
+Each extra name=file argument adds a host file under the given path, so
+build outputs such as the ELF programs in apps/ can be packed without
+copying them into romfs/.
+
+Layout, all integers little-endian u32:
+
+    header   magic "ROMF", version, nfiles, nbuckets, image size,
+             offset of the entry table, offset of the name table
+    buckets  nbuckets entries, index of the first entry in the bucket
+             or 0xffffffff
+    entries  nfiles x { hash, next entry in the bucket, name offset,
+             data offset, size }
+    names    NUL-terminated paths relative to the packed directory,
+             "/" separated, without a leading "/"
+    data     file contents, each aligned to 16 bytes; ELF files are
+             aligned to 4096 bytes so their segments can be mapped
+             straight from the image
+
+Paths are hashed with 32-bit FNV-1a, keep in sync with _romfs_hash() in
+fs/romfs.c. nbuckets is a power of two no smaller than nfiles.
+"""
+
+import os
+import struct
+import sys
+
+# keep in sync with fs/romfs.c
+ROMFS_MAGIC = 0x464d4f52  # "ROMF"
+ROMFS_VERSION = 1
+NO_ENTRY = 0xffffffff
+HEADER = struct.Struct("<7I")
+ENTRY = struct.Struct("<5I")
+DATA_ALIGN = 16
+PAGE_SIZE = 4096
+
+
+def fnv1a(name):
+    h = 0x811c9dc5
+    for b in name.encode():
+        h ^= b
+        h = (h * 0x01000193) & 0xffffffff
+    return h
+
+
+def align(n, a):
+    return (n + a - 1) & ~(a - 1)
+
+
+def collect(root):
+    files = []
+    for d, dirs, names in os.walk(root):
+        dirs.sort()
+        for n in sorted(names):
+            path = os.path.join(d, n)
+            rel = os.path.relpath(path, root).replace(os.sep, "/")
+            with open(path, "rb") as f:
+                files.append((rel, f.read()))
+    return files
+
+
+def build(files):
+    nfiles = len(files)
+    nbuckets = 1
+    while nbuckets < nfiles:
+        nbuckets *= 2
+
+    entries_off = HEADER.size + 4 * nbuckets
+    names_off = entries_off + ENTRY.size * nfiles
+
+    names = b""
+    name_offs = []
+    for rel, _ in files:
+        name_offs.append(names_off + len(names))
+        names += rel.encode() + b"\0"
+
+    off = names_off + len(names)
+    data_offs = []
+    for _, data in files:
+        off = align(off, PAGE_SIZE if data[:4] == b"\x7fELF" else DATA_ALIGN)
+        data_offs.append(off)
+        off += len(data)
+    size = align(off, DATA_ALIGN)
+
+    # chain the entries of each bucket, later entries first
+    buckets = [NO_ENTRY] * nbuckets
+    nexts = [NO_ENTRY] * nfiles
+    hashes = []
+    for i, (rel, _) in enumerate(files):
+        h = fnv1a(rel)
+        hashes.append(h)
+        b = h & (nbuckets - 1)
+        nexts[i] = buckets[b]
+        buckets[b] = i
+
+    image = bytearray(size)
+    HEADER.pack_into(image, 0, ROMFS_MAGIC, ROMFS_VERSION, nfiles, nbuckets,
+                     size, entries_off, names_off)
+    struct.pack_into("<%dI" % nbuckets, image, HEADER.size, *buckets)
+    for i, (_, data) in enumerate(files):
+        ENTRY.pack_into(image, entries_off + ENTRY.size * i, hashes[i], nexts[i],
+                        name_offs[i], data_offs[i], len(data))
+        image[data_offs[i]:data_offs[i] + len(data)] = data
+    image[names_off:names_off + len(names)] = names
+    return bytes(image)
+
+
+def main():
+    if len(sys.argv) < 3:
+        sys.stderr.write("usage: %s <dir> <image> [name=file ...]\n" % sys.argv[0])
+        sys.exit(1)
+    files = collect(sys.argv[1])
+    for arg in sys.argv[3:]:
+        name, path = arg.split("=", 1)
+        with open(path, "rb") as f:
+            files.append((name.lstrip("/"), f.read()))
+    image = build(files)
+    with open(sys.argv[2], "wb") as f:
+        f.write(image)
+    print("romfs: %d files, %d bytes" % (len(files), len(image)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Compare the RVOS build profiles (PROFILE in common.mk) by size and speed.
+
+"make report" builds every profile into build/rv<XLEN>/<profile>, runs the
+micro-benchmarks of each one ("make bench-run", see tools/bench.py) and then
+calls:
+
+    python3 tools/report.py --size riscv64-unknown-elf-size --build build/rv32 \
+        debug release size lto
+
+It prints the text/data/bss size of <build>/<profile>/os.elf and the cycles
+per iteration of every benchmark in <build>/<profile>/bench.log, one column
+per profile. The percentages are relative to the first profile. A profile
+whose kernel or benchmark log is missing is shown as "-".
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+from bench import parse
+
+SECTIONS = ("text", "data", "bss")
+
+
+def elf_size(size_cmd, path):
+    # berkeley format: text data bss dec hex filename
+    out = subprocess.run([size_cmd, "-B", path], check=True,
+                         capture_output=True, text=True).stdout
+    fields = out.splitlines()[1].split()
+    return dict(zip(SECTIONS, (int(f) for f in fields[:3])))
+
+
+def change(value, base):
+    if value is None or base is None:
+        return ""
+    return "%+.0f%%" % ((value - base) * 100.0 / max(base, 1))
+
+
+def table(title, rows, profiles):
+    print(title)
+    print("%-16s" % "" + "".join("%18s" % p for p in profiles))
+    for name, values in rows:
+        cells = []
+        for i, v in enumerate(values):
+            if v is None:
+                cells.append("%18s" % "-")
+            else:
+                cells.append("%11d %6s" % (v, change(v, values[0]) if i else ""))
+        print("%-16s" % name + "".join(cells))
+    print()
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("--size", default="riscv64-unknown-elf-size",
+                    help="size command of the cross toolchain")
+    ap.add_argument("--build", default="build/rv32", help="directory of the profiles")
+    ap.add_argument("profiles", nargs="+")
+    args = ap.parse_args()
+
+    sizes = {}
+    benches = {}
+    for p in args.profiles:
+        elf = os.path.join(args.build, p, "os.elf")
+        if os.path.exists(elf):
+            sizes[p] = elf_size(args.size, elf)
+        log = os.path.join(args.build, p, "bench.log")
+        if os.path.exists(log):
+            results, finished = parse(log)
+            if not finished:
+                print("warning: %s did not finish" % log, file=sys.stderr)
+            benches[p] = results
+
+    rows = []
+    for s in SECTIONS + ("total",):
+        values = []
+        for p in args.profiles:
+            if p not in sizes:
+                values.append(None)
+            elif s == "total":
+                values.append(sum(sizes[p].values()))
+            else:
+                values.append(sizes[p][s])
+        rows.append((s, values))
+    table("size of os.elf (bytes)", rows, args.profiles)
+
+    names = sorted(set(n for r in benches.values() for n in r))
+    rows = []
+    for n in names:
+        values = []
+        for p in args.profiles:
+            r = benches.get(p, {}).get(n)
+            values.append(r["cycles"] if r else None)
+        rows.append((n, values))
+    if rows:
+        table("benchmarks (cycles per iteration)", rows, args.profiles)
+    else:
+        print("no benchmark results, is QEMU installed?")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,138 @@
+#!/usr/bin/env python3
+"""
+Convert an RVOS trace dump into Chrome trace / Perfetto JSON.
+
+The kernel prints its trace ring over UART (trace_dump(), or Ctrl-T on the
+console) as:
+
+    ==== TRACE BEGIN ====
+    T <hart> <ts_hi> <ts_lo> <event> <arg0> <arg1>
+    ...
+    ==== TRACE END ====
+
+with every field in hex. Save the QEMU console output to a file and run:
+
+    python3 tools/trace2json.py qemu.log > trace.json
+
+then open trace.json in chrome://tracing or https://ui.perfetto.dev.
+If the log holds several dumps, the last one is used.
+"""
+
+import json
+import sys
+
+# keep in sync with TRACE_EV_* in os.h
+TRACE_EV_SWITCH = 1
+TRACE_EV_TRAP = 2
+TRACE_EV_LOCK = 3
+TRACE_EV_TIMER = 4
+
+# mtime runs at CLINT_TIMEBASE_FREQ (10 MHz), trace timestamps are in us
+TICKS_PER_US = 10
+
+TRAP_NAMES = {
+    3: "software irq",
+    7: "timer irq",
+    11: "external irq",
+}
+
+NO_TASK = 0xffffffff
+
+
+def parse(lines):
+    records = []
+    inside = False
+    for line in lines:
+        line = line.strip()
+        if line.startswith("==== TRACE BEGIN"):
+            inside = True
+            records = []
+        elif line.startswith("==== TRACE END"):
+            inside = False
+        elif inside and line.startswith("T "):
+            fields = line.split()
+            if len(fields) != 7:
+                continue
+            hart, ts_hi, ts_lo, event, arg0, arg1 = (int(f, 16) for f in fields[1:])
+            records.append({
+                "hart": hart,
+                "ts": (ts_hi << 32) | ts_lo,
+                "event": event,
+                "arg0": arg0,
+                "arg1": arg1,
+            })
+    records.sort(key=lambda r: r["ts"])
+    return records
+
+
+def trap_name(cause):
+    if cause & 0x80000000:
+        return TRAP_NAMES.get(cause & 0xfff, "irq %d" % (cause & 0xfff))
+    return "exception %d" % (cause & 0xfff)
+
+
+def convert(records):
+    events = []
+    if not records:
+        return events
+    base = records[0]["ts"]
+
+    def us(ts):
+        return (ts - base) / TICKS_PER_US
+
+    running = {}  # hart -> (task id, start ts)
+    harts = set()
+    for r in records:
+        hart = r["hart"]
+        harts.add(hart)
+        ts = r["ts"]
+        if r["event"] == TRACE_EV_SWITCH:
+            if hart in running:
+                task, start = running[hart]
+                events.append({"name": "task %d" % task, "ph": "X", "pid": 0,
+                               "tid": hart, "ts": us(start), "dur": us(ts) - us(start)})
+            if r["arg1"] != NO_TASK:
+                running[hart] = (r["arg1"], ts)
+        elif r["event"] == TRACE_EV_TRAP:
+            events.append({"name": trap_name(r["arg0"]), "ph": "i", "s": "t", "pid": 0,
+                           "tid": hart, "ts": us(ts),
+                           "args": {"mcause": hex(r["arg0"]), "mepc": hex(r["arg1"])}})
+        elif r["event"] == TRACE_EV_LOCK:
+            events.append({"name": "spin_lock", "ph": "i", "s": "t", "pid": 0,
+                           "tid": hart, "ts": us(ts),
+                           "args": {"lock": hex(r["arg0"]), "spins": r["arg1"]}})
+        elif r["event"] == TRACE_EV_TIMER:
+            events.append({"name": "timer expired", "ph": "i", "s": "t", "pid": 0,
+                           "tid": hart, "ts": us(ts),
+                           "args": {"timer": hex(r["arg0"]), "expires": r["arg1"]}})
+        else:
+            events.append({"name": "event %d" % r["event"], "ph": "i", "s": "t", "pid": 0,
+                           "tid": hart, "ts": us(ts),
+                           "args": {"arg0": hex(r["arg0"]), "arg1": hex(r["arg1"])}})
+
+    # close the slices that are still running at the end of the dump
+    end = records[-1]["ts"]
+    for hart, (task, start) in running.items():
+        events.append({"name": "task %d" % task, "ph": "X", "pid": 0,
+                       "tid": hart, "ts": us(start), "dur": us(end) - us(start)})
+
+    events.append({"name": "process_name", "ph": "M", "pid": 0, "args": {"name": "RVOS"}})
+    for hart in sorted(harts):
+        events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": hart,
+                       "args": {"name": "hart %d" % hart}})
+    return events
+
+
+def main():
+    if len(sys.argv) > 1:
+        with open(sys.argv[1], errors="replace") as f:
+            lines = f.readlines()
+    else:
+        lines = sys.stdin.readlines()
+    json.dump({"traceEvents": convert(parse(lines)), "displayTimeUnit": "ns"},
+              sys.stdout, indent=1)
+    sys.stdout.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,68 @@
+#include "../os.h"
+
+/*
+ * 内核事件追踪
+ * 每个hart拥有一个独立的环形缓冲区，记录为定长的 struct trace_record。
+ * 写入时只用一次原子加法占据槽位，不加锁，因此可以在调度、trap、
+ * 自旋锁等任意上下文中调用，开销远小于printf。
+ * 缓冲区写满后覆盖最旧的记录，trace_dump() 按时间顺序输出剩余的记录。
+ */
+
+#if CONFIG_TRACE
+
+#define TRACE_RECORDS CONFIG_TRACE_RECORDS // 每个hart的记录数，必须是2的幂
+#if TRACE_RECORDS < 1 || (TRACE_RECORDS & (TRACE_RECORDS - 1))
+#error "CONFIG_TRACE_RECORDS must be a power of two"
+#endif
+
+static struct trace_record trace_buf[MAXNUM_CPU][TRACE_RECORDS];
+static uint32_t trace_head[MAXNUM_CPU]; // 下一条记录的序号，只增不减
+static volatile int trace_enabled = 1;
+
+void trace_event(uint8_t event, uint32_t arg0, uint32_t arg1)
+{
+	if (!trace_enabled) {
+		return;
+	}
+	// 任务上下文中可能读不到mhartid，这里和plic一样使用tp中保存的hartid
+	int hart = r_tp() & (MAXNUM_CPU - 1);
+	// 先原子地占一个槽位，被中断嵌套时也不会写到同一条记录
+	uint32_t seq = __sync_fetch_and_add(&trace_head[hart], 1);
+	struct trace_record *r = &trace_buf[hart][seq & (TRACE_RECORDS - 1)];
+
+	r->timestamp = clock_ticks();
+	r->hart = hart;
+	r->event = event;
+	r->reserved = 0;
+	r->arg0 = arg0;
+	r->arg1 = arg1;
+}
+
+/*
+ * DESCRIPTION
+ * 	通过UART输出所有hart的追踪记录，每条记录一行，格式为：
+ * 	T <hart> <timestamp高32位> <timestamp低32位> <event> <arg0> <arg1>
+ * 	数值均为十六进制，由 tools/trace2json.py 转换为 Chrome trace 格式。
+ */
+void trace_dump(void)
+{
+	// 输出期间暂停记录，避免printf本身产生的事件覆盖正在输出的记录
+	trace_enabled = 0;
+
+	printf("==== TRACE BEGIN ====\n");
+	for (int hart = 0; hart < MAXNUM_CPU; hart++) {
+		uint32_t head = trace_head[hart];
+		uint32_t seq = head > TRACE_RECORDS ? head - TRACE_RECORDS : 0;
+		for (; seq < head; seq++) {
+			struct trace_record *r = &trace_buf[hart][seq & (TRACE_RECORDS - 1)];
+			printf("T %x %x %x %x %x %x\n", r->hart,
+				(uint32_t)(r->timestamp >> 32), (uint32_t)r->timestamp,
+				r->event, r->arg0, r->arg1);
+		}
+	}
+	printf("==== TRACE END ====\n");
+
+	trace_enabled = 1;
+}
+
+#endif /* CONFIG_TRACE */
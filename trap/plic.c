@@ -20,7 +20,10 @@ void plic_init(void)
 	// #define PLIC_PRIORITY(id) (PLIC_BASE + (id) * 4)，设置PLIC的priotity寄存器
 	// 用来指定中断源的优先级
 	// UART0_IRQ 是UART的中断源，在这里是由qemu决定的
-	*(uint32_t*)PLIC_PRIORITY(UART0_IRQ) = 1;
+#if CONFIG_UART_RX
+	*(volatile uint32_t*)PLIC_PRIORITY(UART0_IRQ) = 1;
+#endif
+	*(volatile uint32_t*)PLIC_PRIORITY(VIRTIO0_IRQ) = 1;
  
 	/*
 	 * Enable UART0
@@ -28,8 +31,8 @@ void plic_init(void)
 	 * Each global interrupt can be enabled by setting the corresponding 
 	 * bit in the enables registers.
 	 */
-	// 针对该 hart 使能 UART0 的中断源
-	*(uint32_t*)PLIC_MENABLE(hart)= (1 << UART0_IRQ);
+	// 针对该 hart 使能 UART0 和 virtio 磁盘的中断源，CONFIG_UART_RX 为0时不使能 UART0
+	*(volatile uint32_t*)PLIC_MENABLE(hart)= (CONFIG_UART_RX << UART0_IRQ) | (1 << VIRTIO0_IRQ);
 
 	/* 
 	 * Set priority threshold for UART0.
@@ -41,7 +44,7 @@ void plic_init(void)
 	 * Notice, the threshold is global for PLIC, not for each interrupt source.
 	 */
 	// 设置该 hart 的中断优先级的阈值，优先级小于该阈值的不响应
-	*(uint32_t*)PLIC_MTHRESHOLD(hart) = 0;
+	*(volatile uint32_t*)PLIC_MTHRESHOLD(hart) = 0;
 
 	/* enable machine-mode global interrupts. */
 	// 使能machine模式下的全局中断
@@ -70,7 +73,7 @@ void plic_init(void)
 int plic_claim(void)
 {
 	int hart = r_tp();
-	int irq = *(uint32_t*)PLIC_MCLAIM(hart); // 读 PLIC 的 claim 寄存器
+	int irq = *(volatile uint32_t*)PLIC_MCLAIM(hart); // 读 PLIC 的 claim 寄存器
 	return irq;
 }
 
@@ -88,5 +91,5 @@ int plic_claim(void)
 void plic_complete(int irq)
 {
 	int hart = r_tp();
-	*(uint32_t*)PLIC_MCOMPLETE(hart) = irq;
+	*(volatile uint32_t*)PLIC_MCOMPLETE(hart) = irq;
 }
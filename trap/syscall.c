@@ -0,0 +1,339 @@
+#include "../os.h"
+
+/*
+ * 系统调用
+ * 任务执行ecall进入trap_handler，a7中是系统调用号，a0、a1是参数，返回值写回上下文中的a0。
+ * 会阻塞的系统调用(yield、sleep、exit、recv)直接调用调度器切换到其他任务，不会返回到trap_handler。
+ */
+
+extern TaskNode* task_global_ptr;
+extern void schedule_priority(void);
+
+extern uintptr_t UTEXT_START;
+extern uintptr_t UTEXT_END;
+extern uintptr_t UDATA_START;
+extern uintptr_t UDATA_END;
+
+//[addr, addr + len) 是否落在 [start, end) 中
+static int _in_range(uintptr_t addr, uint32_t len, uintptr_t start, uintptr_t end)
+{
+	return addr >= start && addr <= end && len <= end - addr;
+}
+
+/*
+ * 检查用户任务传入的缓冲区，只能位于用户程序的代码段、数据段、加载的程序镜像或者它自己的栈、堆中
+ * 内核任务可以访问所有内存
+ */
+static int uaccess_ok(TaskNode* task_node, uintptr_t addr, uint32_t len)
+{
+	if (task_node->task->mode != MSTATUS_MPP_U) {
+		return 1;
+	}
+	return _in_range(addr, len, UTEXT_START, UTEXT_END) ||
+		_in_range(addr, len, UDATA_START, UDATA_END) ||
+#if CONFIG_VM
+		_in_range(addr, len, VM_HEAP_BASE, VM_HEAP_BASE + VM_HEAP_SIZE) ||
+		_in_range(addr, len, VM_IMAGE_BASE, VM_IMAGE_BASE + VM_IMAGE_SIZE) ||
+#endif
+		_in_range(addr, len, (uintptr_t)task_node->stack, (uintptr_t)task_node->stack + task_node->stack_size);
+}
+
+/*
+ * 把任务的缓冲区复制到内核中
+ * 任务有自己的页表时，栈和堆的虚拟地址和物理地址不同，需要按页表翻译
+ */
+static int ucopyin(TaskNode* task_node, void* dst, uintptr_t addr, uint32_t len)
+{
+#if CONFIG_VM
+	if (task_node->pagetable) {
+		return vm_copyin(task_node->pagetable, dst, addr, len);
+	}
+#endif
+	memcpy(dst, (void*)addr, len);
+	return 0;
+}
+
+static reg_t sys_gettid_handler(struct context* ctx)
+{
+	return task_global_ptr->task_id;
+}
+
+static reg_t sys_yield_handler(struct context* ctx)
+{
+	ctx->a0 = 0;
+	task_global_ptr->yielded = 1;
+	schedule_priority();
+	return 0;
+}
+
+static reg_t sys_sleep_handler(struct context* ctx)
+{
+	//EDF任务由周期释放驱动，不能阻塞
+	if (task_global_ptr->priority == TASK_PRIORITY_EDF) {
+		return -1;
+	}
+	uint32_t ticks = ctx->a0;
+	ctx->a0 = 0;
+	task_sleep(task_global_ptr, ticks);
+	schedule_priority();
+	return 0;
+}
+
+static reg_t sys_exit_handler(struct context* ctx)
+{
+	task_global_ptr->exiting = 1;
+	schedule_priority();
+	return 0;
+}
+
+static reg_t sys_write_handler(struct context* ctx)
+{
+	uintptr_t buf = ctx->a0;
+	uint32_t len = ctx->a1;
+	char chunk[64];
+	uint32_t n;
+
+	if (!uaccess_ok(task_global_ptr, buf, len)) {
+		return -1;
+	}
+	for (uint32_t off = 0; off < len; off += n) {
+		n = len - off < sizeof(chunk) ? len - off : sizeof(chunk);
+		if (ucopyin(task_global_ptr, chunk, buf + off, n) < 0) {
+			return -1;
+		}
+		for (uint32_t i = 0; i < n; i++) {
+			uart_putc(chunk[i]);
+		}
+	}
+	return len;
+}
+
+#if CONFIG_TIMER
+/*
+ * 用户定时器超时后给任务发送的消息
+ * 系统调用在中断上下文中执行，不能使用堆，用户定时器从静态的池中分配，
+ * 触发时在定时器中断中归还，用户任务最多只能占用 UTIMER_MAX 个定时器
+ */
+#define UTIMER_MAX 32
+
+struct utimer {
+	struct timer timer;
+	struct TimerNode node;
+	uint32_t task_id;
+	uint32_t msg;
+	uint8_t used;
+};
+
+static struct utimer _utimers[UTIMER_MAX];
+
+static void utimer_func(void* arg)
+{
+	struct utimer* ut = (struct utimer*)arg;
+	msg_send(ut->task_id, ut->msg);
+	ut->used = 0;
+}
+
+static reg_t sys_timer_handler(struct context* ctx)
+{
+	if (ctx->a0 == 0) {
+		return -1;
+	}
+	for (int i = 0; i < UTIMER_MAX; i++) {
+		struct utimer* ut = &_utimers[i];
+		if (ut->used) {
+			continue;
+		}
+		ut->used = 1;
+		ut->task_id = task_global_ptr->task_id;
+		ut->msg = ctx->a1;
+		ut->timer.func = utimer_func;
+		ut->timer.arg = ut;
+		ut->timer.expires = clock_ticks() + (uint64_t)ctx->a0 * TIMER_TICK;
+		ut->node.timer = &ut->timer;
+		timer_insert(&ut->node);
+		return 0;
+	}
+	return -1;
+}
+
+//内核任务通过这两个系统调用修改定时器链表，见 timer_create 和 timer_delete
+static reg_t sys_timer_add_handler(struct context* ctx)
+{
+	if (task_global_ptr->task->mode == MSTATUS_MPP_U) {
+		return -1;
+	}
+	timer_insert((struct TimerNode*)ctx->a0);
+	return 0;
+}
+
+static reg_t sys_timer_del_handler(struct context* ctx)
+{
+	if (task_global_ptr->task->mode == MSTATUS_MPP_U) {
+		return -1;
+	}
+	timer_remove((struct TimerNode*)ctx->a0);
+	return 0;
+}
+#else
+//软件定时器被裁剪掉时定时器相关的系统调用总是失败
+static reg_t sys_timer_handler(struct context* ctx)
+{
+	return -1;
+}
+
+static reg_t sys_timer_add_handler(struct context* ctx)
+{
+	return -1;
+}
+
+static reg_t sys_timer_del_handler(struct context* ctx)
+{
+	return -1;
+}
+#endif
+
+static reg_t sys_send_handler(struct context* ctx)
+{
+	return msg_send(ctx->a0, ctx->a1);
+}
+
+static reg_t sys_recv_handler(struct context* ctx)
+{
+	uint32_t msg;
+	if (msg_recv(task_global_ptr, &msg) == 0) {
+		return msg;
+	}
+	if (task_global_ptr->priority == TASK_PRIORITY_EDF) {
+		return -1;
+	}
+	//队列为空，阻塞等待，msg_send 会把消息写入a0
+	task_global_ptr->waiting_msg = 1;
+	task_block(task_global_ptr);
+	schedule_priority();
+	return 0;
+}
+
+/*
+ * 等待内核对象上的事件，地址由内核直接访问，所以只供内核任务使用
+ * 检查条件和阻塞都在关中断的trap中进行，不会丢失唤醒
+ */
+static reg_t sys_wait_handler(struct context* ctx)
+{
+	volatile uint32_t* addr = (volatile uint32_t*)ctx->a0;
+	if (task_global_ptr->task->mode == MSTATUS_MPP_U || task_global_ptr->priority == TASK_PRIORITY_EDF) {
+		return -1;
+	}
+	if (*addr != ctx->a1) {
+		return 0;
+	}
+	ctx->a0 = 0;
+	task_global_ptr->wait_chan = (void*)addr;
+	task_block(task_global_ptr);
+	schedule_priority();
+	return 0;
+}
+
+//在任务中唤醒 sys_wait 上阻塞的任务，被唤醒的任务优先级更高时立即切换
+static reg_t sys_wake_handler(struct context* ctx)
+{
+	void* chan = (void*)ctx->a0;
+	if (task_global_ptr->task->mode == MSTATUS_MPP_U) {
+		return -1;
+	}
+	ctx->a0 = 0;
+	task_wake_chan(chan);
+	schedule_priority();
+	return 0;
+}
+
+/*
+ * 内核任务通过这个系统调用使用页分配器和堆，分配器的数据结构只在trap中修改，见 my_malloc
+ * 参数和返回的地址都是内核中的地址，RAM在所有地址空间中都是恒等映射的
+ */
+static reg_t sys_mem_handler(struct context* ctx)
+{
+	reg_t a1 = ctx->a1;
+	reg_t a2 = ctx->a2;
+
+	if (task_global_ptr->task->mode == MSTATUS_MPP_U) {
+		return 0;
+	}
+	switch (ctx->a0) {
+	case MEM_MALLOC:
+		return (reg_t)my_malloc(a1);
+	case MEM_FREE:
+		my_free((void*)a1);
+		return 0;
+	case MEM_CALLOC:
+		return (reg_t)my_calloc(a1, a2);
+	case MEM_REALLOC:
+		return (reg_t)my_realloc((void*)a1, a2);
+	case MEM_ALIGNED:
+		return (reg_t)my_aligned_alloc(a1, a2);
+	case MEM_PAGE_ALLOC:
+		return (reg_t)page_alloc(a1);
+	case MEM_PAGE_FREE:
+		page_free((void*)a1);
+		return 0;
+	case MEM_HEAP_STATS:
+		return heap_get_stats((struct heap_stats*)a1);
+	case MEM_PAGE_CHECK:
+		return page_check();
+	}
+	return -1;
+}
+
+static reg_t sys_task_create_handler(struct context* ctx)
+{
+	struct task_args a;
+
+	if (task_global_ptr->task->mode == MSTATUS_MPP_U) {
+		return -1;
+	}
+	//参数在调用者的栈上，开启虚拟内存时要按任务的页表复制
+	if (ucopyin(task_global_ptr, &a, ctx->a0, sizeof(a)) < 0) {
+		return -1;
+	}
+	return task_create_args(&a);
+}
+
+static reg_t sys_job_end_handler(struct context* ctx)
+{
+	ctx->a0 = 0;
+	return edf_job_done();
+}
+
+static reg_t (*syscalls[NR_SYSCALLS])(struct context* ctx) = {
+	[SYS_GETTID] = sys_gettid_handler,
+	[SYS_YIELD]  = sys_yield_handler,
+	[SYS_SLEEP]  = sys_sleep_handler,
+	[SYS_EXIT]   = sys_exit_handler,
+	[SYS_WRITE]  = sys_write_handler,
+	[SYS_TIMER]  = sys_timer_handler,
+	[SYS_SEND]   = sys_send_handler,
+	[SYS_RECV]   = sys_recv_handler,
+	[SYS_WAIT]   = sys_wait_handler,
+	[SYS_TIMER_ADD] = sys_timer_add_handler,
+	[SYS_TIMER_DEL] = sys_timer_del_handler,
+	[SYS_WAKE]   = sys_wake_handler,
+	[SYS_MEM]    = sys_mem_handler,
+	[SYS_TASK_CREATE] = sys_task_create_handler,
+	[SYS_JOB_END] = sys_job_end_handler,
+};
+
+/*
+ * DESCRIPTION
+ * 	分发系统调用，ctx 是执行ecall的任务的上下文.
+ * 	调用前 ctx->pc 已经指向ecall的下一条指令，阻塞的系统调用切换任务之后，
+ * 	任务再次运行时从这里继续。
+ */
+void do_syscall(struct context* ctx)
+{
+	reg_t num = ctx->a7;
+	if (num >= NR_SYSCALLS) {
+		printf("task %d: unknown syscall %d\n", task_global_ptr->task_id, num);
+		ctx->a0 = -1;
+		return;
+	}
+	ctx->a0 = syscalls[num](ctx);
+}
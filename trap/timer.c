@@ -1,46 +1,86 @@
 #include "../os.h"
-/* interval ~= 1s */
-#define TIMER_INTERVAL CLINT_TIMEBASE_FREQ
-#define MAX_TIMER 10
-static uint32_t _tick = 0;
+/* 第一次定时器中断的间隔，之后由调度器按任务的时间片设置 */
+#define TIMER_INTERVAL CONFIG_TIMER_INTERVAL
 
 extern void schedule_priority(void);
+extern void edf_release(void);
+extern uint64_t sched_next_event(void);
+extern void task_wake_sleepers(void);
 extern TaskNode* task_global_ptr;
 
-extern struct spinlock lk;
-
-static struct timer timer_list[MAX_TIMER];
+#if CONFIG_TIMER
+//软件定时器链表，按超时时间排序，只包含还没有触发的定时器
 struct TimerNode dummyHead;
+#endif
+
+/*
+ * 写 mtimecmp，RV64 一次写完64位。
+ * RV32 只能分两次写：先把低32位写成最大值，写高32位的过程中比较值不会小于新值，不会误触发中断。
+ */
+static inline void _mtimecmp_write(int id, uint64_t when)
+{
+#if __riscv_xlen == 64
+	*(volatile uint64_t*)CLINT_MTIMECMP(id) = when;
+#else
+	volatile uint32_t* cmp = (volatile uint32_t*)CLINT_MTIMECMP(id);
+	cmp[0] = 0xffffffff;
+	cmp[1] = (uint32_t)(when >> 32);
+	cmp[0] = (uint32_t)when;
+#endif
+}
 
 /* load timer interval(in ticks) for next timer interrupt.*/
-void timer_load(int interval)
+void timer_load(uint32_t interval)
 {
 	/* each CPU has a separate source of timer interrupts. */
 	int id = r_mhartid();
 	
-	*(uint64_t*)CLINT_MTIMECMP(id) = *(uint64_t*)CLINT_MTIME + interval;
+	_mtimecmp_write(id, clock_ticks() + interval);
 }
 
+/*
+ * arm the preemption timer for the task about to run
+ * 为即将运行的任务设置定时器，但不能晚于下一个调度事件(EDF释放、睡眠任务唤醒、软件定时器超时)
+ */
+void timer_arm(uint32_t interval)
+{
+	uint64_t now = clock_ticks();
+	uint64_t next_release = sched_next_event();
 
-// 定时器初始化：1. 初始化软件定时器数组 2. 初始化mtimecmp 3. 开启定时器中断mie
+	if (next_release <= now) {
+		interval = 1;
+	} else if (next_release - now < interval) {
+		interval = next_release - now;
+	}
+	timer_load(interval);
+}
+
+/*
+ * make sure the next timer interrupt fires no later than mtime reaches 'when'
+ * this routine should be called in interrupt context (interrupt is disabled)
+ * 保证下一次定时器中断不晚于时刻when。先读后写 mtimecmp，在任务中调用时可能被打断，
+ * 覆盖调度器刚设置的更早的时刻，任务中用 sched_resched 让调度器重新设置定时器
+ */
+void timer_kick(uint64_t when)
+{
+	int id = r_tp();
+
+	if (when < *(volatile uint64_t*)CLINT_MTIMECMP(id)) {
+		_mtimecmp_write(id, when);
+	}
+}
+
+// 定时器初始化：1. 初始化软件定时器链表 2. 初始化mtimecmp 3. 开启定时器中断mie
 void timer_init()
 {
-	//
-	/*
-	struct timer *t = &(timer_list[0]);
-	for (int i = 0; i < MAX_TIMER; i++) {
-		t->func = NULL; // 用数组管理时，用func是否为NULL来判断是否有定时器任务
-		t->arg = NULL;
-		t++;
-	}	
-	*/
+#if CONFIG_TIMER
 	struct timer* t = (struct timer *)my_malloc(sizeof(struct timer));
 	t->func = NULL;
 	t->arg = NULL;
-	t->timeout_tick = 0;
+	t->expires = 0;
 	dummyHead.timer = t;
 	dummyHead.next = NULL;
-	
+#endif
 
 	/*
 	 * On reset, mtime is cleared to zero, but the mtimecmp registers 
@@ -52,6 +92,7 @@ void timer_init()
 	w_mie(r_mie() | MIE_MTIE);
 }
 
+#if CONFIG_TIMER
 // 添加 timeNode
 int add_TimeNode(struct TimerNode* dummyHead, struct TimerNode* node)
 {
@@ -62,7 +103,7 @@ int add_TimeNode(struct TimerNode* dummyHead, struct TimerNode* node)
 	struct TimerNode* pre = dummyHead;
 	struct TimerNode* cur = dummyHead->next;
 	while(cur){
-		if(cur->timer->timeout_tick >= node->timer->timeout_tick){
+		if(cur->timer->expires >= node->timer->expires){
 			node->next = cur;
 			pre->next = node;
 			return 0;
@@ -70,120 +111,267 @@ int add_TimeNode(struct TimerNode* dummyHead, struct TimerNode* node)
 		pre = cur;
 		cur = cur->next;
 	}
-	if(cur == NULL && pre->timer->timeout_tick < node->timer->timeout_tick){
+	if(cur == NULL && pre->timer->expires < node->timer->expires){
 		pre->next = node;
 	}
 	return 0;
 }
 
-// 创建软件定时器，超时处理函数、函数参数、超时时间
+/*
+ * 定时器链表只在中断上下文中修改：timer_check 在定时器中断中取出到期的定时器，
+ * 任务通过 SYS_TIMER_ADD/SYS_TIMER_DEL 系统调用加入和取出定时器，不会被中断打断。
+ * 定时器的内存由任务调用 my_malloc/my_free 分配和释放(它们通过 SYS_MEM 进入trap执行)，定时器中断处理中不使用堆。
+ */
+
+/* this routine should be called in interrupt context (interrupt is disabled) */
+// 把定时器加入链表，并保证定时器中断不晚于它的超时时刻
+void timer_insert(struct TimerNode* node)
+{
+	node->next = NULL;
+	add_TimeNode(&dummyHead, node);
+	timer_kick(node->timer->expires);
+}
+
+/* this routine should be called in interrupt context (interrupt is disabled) */
+// 把定时器从链表中取出，已经触发的定时器不在链表中
+void timer_remove(struct TimerNode* node)
+{
+	for (struct TimerNode* pre = &dummyHead; pre->next; pre = pre->next) {
+		if (pre->next == node) {
+			pre->next = node->next;
+			node->next = NULL;
+			return;
+		}
+	}
+}
+
+//timer_create 分配的定时器，定时器和链表节点一次分配
+struct ktimer {
+	struct timer timer;
+	struct TimerNode node;
+};
+
+/*
+ * DESCRIPTION
+ * 	创建软件定时器，timeout 个 TIMER_TICK 之后在定时器中断中调用 handler(arg).
+ * 	只能在任务中调用。定时器触发之后不再占用定时器链表，但内存仍然属于调用者，
+ * 	不论是否已经触发，都要用 timer_delete 释放。
+ * RETURN VALUE
+ * 	定时器，参数错误或内存不足时返回NULL
+ */
 struct timer *timer_create(void (*handler)(void *arg), void *arg, uint32_t timeout)
 {
-	/* TBD: params should be checked more, but now we just simplify this */
 	if (NULL == handler || 0 == timeout) {
 		return NULL;
 	}
 
-	/* use lock to protect the shared timer_list between multiple tasks */
-	//上锁 保护timer_list
-	spin_lock(&lk);	
+	struct ktimer* kt = (struct ktimer *)my_malloc(sizeof(struct ktimer));
+	if (kt == NULL) {
+		return NULL;
+	}
+	kt->timer.func = handler;
+	kt->timer.arg = arg;
+	kt->timer.expires = clock_ticks() + (uint64_t)timeout * TIMER_TICK;
+	kt->node.timer = &kt->timer;
+	kt->node.next = NULL;
 
-	// 设置软件定时器
-	struct timer* t = (struct timer *)my_malloc(sizeof(struct timer));
-	t->func = handler;
-	t->arg = arg;
-	t->timeout_tick = _tick + timeout;
-	struct TimerNode* tn = (struct TimerNode*)my_malloc(sizeof(struct TimerNode));
-	tn->timer = t;
-	tn->next = NULL;
+	sys_timer_add(&kt->node);
 
-	add_TimeNode(&dummyHead, tn);
+	return &kt->timer;
+}
 
-	// 解锁
-	spin_unlock(&lk);
+/*
+ * DESCRIPTION
+ * 	取消还没有触发的定时器，并释放 timer_create 分配的定时器. 只能在任务中调用。
+ */
+void timer_delete(struct timer *timer)
+{
+	struct ktimer* kt = (struct ktimer *)timer;
 
-	return t;
+	sys_timer_del(&kt->node);
+	my_free(kt);
 }
 
-// 删除定时器
-void timer_delete(struct timer *timer)
+/* this routine should be called in interrupt context (interrupt is disabled) */
+// 取出并执行所有到期的定时器，链表按超时时刻排序，只需要检查头部
+static inline void timer_check()
 {
-	// 上锁
-	spin_lock(&lk);
-	// 删除定时器
-	struct TimerNode* cur = dummyHead.next;
-	struct TimerNode* pre = &dummyHead;
-	while(cur){
-		if(cur->timer == timer){
-			pre->next = cur->next;
-			cur->next = NULL;
-			my_free(cur->timer);
-			my_free(cur);
-			break;
-		}
-		pre = cur;
-		cur = cur->next;
-	}
+	uint64_t now = clock_ticks();
 
-	// 解锁
-	spin_unlock(&lk);
+	while (dummyHead.next && dummyHead.next->timer->expires <= now) {
+		struct TimerNode* node = dummyHead.next;
+		struct timer* t = node->timer;
+		//先从链表中取出，处理函数可以释放或者重新使用这个定时器
+		dummyHead.next = node->next;
+		node->next = NULL;
+#if CONFIG_DEBUG
+		printf("timer->expires: %d\n", (uint32_t)t->expires);
+#endif
+		trace_event(TRACE_EV_TIMER, (uint32_t)(uintptr_t)t, (uint32_t)t->expires);
+		t->func(t->arg);
+	}
 }
 
-//有序链表的二分法来找到超时定时器的右边界
-struct TimerNode* find_TimeNode_rb(struct TimerNode* left, struct TimerNode* right, uint32_t _tick)
+/*
+ * DESCRIPTION
+ * 	最早的未触发的软件定时器的超时时刻，供调度器设置下一次定时器中断.
+ * RETURN VALUE
+ * 	超时时刻(mtime)，没有未触发的定时器时返回最大值
+ */
+uint64_t timer_next_expiry(void)
 {
-	
+	//链表按超时时间排序，触发的定时器已经被 timer_check 取出，只需要看头部
+	return dummyHead.next ? dummyHead.next->timer->expires : (uint64_t)-1;
 }
 
-/* this routine should be called in interrupt context (interrupt is disabled) */
-// 检查任务是否超时
-static inline void timer_check()
+/* timer_list_check 认为比这更长的链表有环 */
+#define TIMER_CHECK_MAX 65536
+
+/*
+ * DESCRIPTION
+ * 	检查定时器链表按超时时刻排序并且没有环. 在中断上下文中调用，sched_check_start 之后每次调度都检查。
+ * RETURN VALUE
+ * 	0: 通过
+ * 	-1: 链表被破坏，输出出错的节点
+ */
+int timer_list_check(void)
 {
-	struct TimerNode* cur = dummyHead.next;
-	struct TimerNode* pre = &dummyHead;
-	struct TimerNode* temp;
-	while(cur){
-		if(cur->timer->timeout_tick > _tick){
-			break; //找到了第一个不超时的任务
+	uint32_t n = 0;
+
+	for (struct TimerNode* cur = dummyHead.next; cur; cur = cur->next) {
+		if (++n > TIMER_CHECK_MAX) {
+			printf("timer_list_check: more than %d timers, the list has a loop\n", TIMER_CHECK_MAX);
+			return -1;
 		}
-		pre = cur;
-		cur = cur->next;
-	}
-	printf("pre->timer->timeout_tick: %d\n", pre->timer->timeout_tick);
-	if(pre != &dummyHead){
-		cur = dummyHead.next;
-		while(cur != pre->next){
-			if(cur->timer->func != NULL){
-				printf("cur->timer->timeout_tick: %d\n", cur->timer->timeout_tick);
-				cur->timer->func(cur->timer->arg);
-				cur->timer->func = NULL;
-				//temp = cur;
-				
-				//timer_delete(temp->timer);
-			}
-			cur = cur->next;
+		if (cur->next && cur->next->timer->expires < cur->timer->expires) {
+			printf("timer_list_check: timer 0x%x expires after the next one\n", cur->timer);
+			return -1;
 		}
 	}
-
-	
+	return 0;
 }
+#endif /* CONFIG_TIMER */
 
 void timer_handler() 
 {
-	_tick++;
-	printf("task_id: %d, time_slice: %d\n", task_global_ptr->task_id, task_global_ptr->timeslice);
+#if CONFIG_DEBUG
+	if (task_global_ptr) {
+		printf("task_id: %d, time_slice: %d, budget: %d\n", task_global_ptr->task_id, task_global_ptr->timeslice, task_global_ptr->budget);
+	}
+#endif
 	//printf("task_timeslice_0: %d, task_timeslice_1: %d\n", task_timeslice[0], task_timeslice[1]);
+#if CONFIG_TIMER
 	timer_check();
+#endif
 	/*
 	struct TimerNode* cur = dummyHead.next;
 	while(cur){
-		printf("cur->timer: 0x%x, timeout: %d\n", cur->timer, cur->timer->timeout_tick);
+		printf("cur->timer: 0x%x, expires: %d\n", cur->timer, (uint32_t)cur->timer->expires);
 		cur = cur->next;
 	}		
 	*/
 
 
-	timer_load(task_global_ptr->timeslice);
+	//释放到期的EDF作业，唤醒睡眠结束的任务
+	edf_release();
+	task_wake_sleepers();
 
+	//调度器会按切入任务的剩余预算重新设置定时器
 	schedule_priority();
 }
+
+#if CONFIG_TIMER
+/*
+ * timer_test 的随机压力测试：TIMER_TEST_SLOTS 个槽位，每次随机选一个，
+ * 空的就用 timer_create 创建定时器，非空的用 timer_delete 删除，走真实的系统调用和定时器链表。
+ * 每次操作之后让调度器在中断上下文中用 timer_list_check 检查链表。
+ * 最后创建几个很快到期的定时器，检查 timer_check 执行并取出了它们。
+ */
+#define TIMER_TEST_OPS 10000
+#define TIMER_TEST_SLOTS 32
+/* 超时时间远大于测试的时间，测试中不会触发；范围很小，相邻的超时时刻经常很接近 */
+#define TIMER_TEST_TIMEOUT 1000
+#define TIMER_TEST_RANGE 16
+#define TIMER_TEST_FIRE 4
+
+static struct timer* _test_timers[TIMER_TEST_SLOTS];
+static volatile uint32_t _test_fired;
+
+static void _timer_test_func(void* arg)
+{
+	_test_fired++;
+}
+
+/*
+ * DESCRIPTION
+ * 	timer_create/timer_delete 和定时器链表的随机压力测试，输出每次操作的平均cycle数.
+ * 	只能在任务中调用，大约需要 2 个 TIMER_TICK。
+ * RETURN VALUE
+ * 	出错的次数
+ */
+int timer_test(void)
+{
+	uint32_t seed = 1;
+	int errors = 0;
+	uint32_t cycles = 0;
+
+	sched_check_start();
+	for (uint32_t op = 0; op < TIMER_TEST_OPS; op++) {
+		seed = seed * 1103515245 + 12345;
+		uint32_t r = seed >> 8;
+		struct timer** slot = &_test_timers[r % TIMER_TEST_SLOTS];
+
+		uint32_t start = ucycle();
+		if (*slot) {
+			timer_delete(*slot);
+			*slot = NULL;
+		} else {
+			*slot = timer_create(_timer_test_func, NULL, TIMER_TEST_TIMEOUT + (r >> 8) % TIMER_TEST_RANGE);
+			errors += *slot == NULL;
+		}
+		cycles += ucycle() - start;
+
+		//链表头部不能晚于最早的测试定时器
+		uint64_t first = (uint64_t)-1;
+		for (int i = 0; i < TIMER_TEST_SLOTS; i++) {
+			if (_test_timers[i] && _test_timers[i]->expires < first) {
+				first = _test_timers[i]->expires;
+			}
+		}
+		if (timer_next_expiry() > first) {
+			printf("timer_test: next expiry is after timer expiring at %d\n", (uint32_t)first);
+			errors++;
+		}
+		sched_resched();
+	}
+	for (int i = 0; i < TIMER_TEST_SLOTS; i++) {
+		if (_test_timers[i]) {
+			timer_delete(_test_timers[i]);
+			_test_timers[i] = NULL;
+		}
+	}
+
+	//到期的定时器被 timer_check 取出并执行，之后仍然由 timer_delete 释放
+	_test_fired = 0;
+	for (int i = 0; i < TIMER_TEST_FIRE; i++) {
+		_test_timers[i] = timer_create(_timer_test_func, NULL, 1);
+		errors += _test_timers[i] == NULL;
+	}
+	sys_sleep(2 * TIMER_TICK);
+	if (_test_fired != TIMER_TEST_FIRE) {
+		printf("timer_test: %d of %d timers fired\n", _test_fired, TIMER_TEST_FIRE);
+		errors++;
+	}
+	for (int i = 0; i < TIMER_TEST_FIRE; i++) {
+		if (_test_timers[i]) {
+			timer_delete(_test_timers[i]);
+			_test_timers[i] = NULL;
+		}
+	}
+	errors += sched_check_stop();
+
+	printf("timer_test: %d ops, %d errors, %d cycles/op\n",
+		TIMER_TEST_OPS, errors, cycles / TIMER_TEST_OPS);
+	return errors;
+}
+#endif /* CONFIG_TIMER */
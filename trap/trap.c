@@ -2,8 +2,11 @@
 
 extern void trap_vector(void);
 extern void uart_isr(void);
+extern void virtio_blk_isr(void);
 extern void timer_handler(void);
 extern void schedule_priority(void);
+/* 每个hart的内核栈，见 start.S */
+extern uint8_t stacks[];
 
 
 void trap_init()
@@ -22,8 +25,13 @@ void external_interrupt_handler()
 {
 	int irq = plic_claim(); // 获得目前发生的最高优先级的中断源
 
+#if CONFIG_UART_RX
 	if (irq == UART0_IRQ){ // 如果是UART0的中断
       	uart_isr(); // 处理UART0中断的逻辑
+	} else
+#endif
+	if (irq == VIRTIO0_IRQ) { // virtio 磁盘的请求完成
+		virtio_blk_isr();
 	} else if (irq) {
 		printf("unexpected interrupt irq = %d\n", irq);
 	}
@@ -40,41 +48,63 @@ void external_interrupt_handler()
 * 异常 Synchronous trap  程序返回到原来指令的地址
 */
 
-reg_t trap_handler(reg_t epc, reg_t cause)
+reg_t trap_handler(reg_t epc, reg_t cause, struct context* ctx)
 {
 	reg_t return_pc = epc;
 	reg_t cause_code = cause & 0xfff;
+
+	//记录中的 mcause 固定是32位的格式，RV64 上把中断位移到第31位
+	trace_event(TRACE_EV_TRAP, (uint32_t)cause_code | ((cause & MCAUSE_INTR) ? 0x80000000 : 0), epc);
 	
-	if (cause & 0x80000000) {
+	if (cause & MCAUSE_INTR) {
 		/* Asynchronous trap - interrupt */
 		switch (cause_code) {
 		case 3:
+#if CONFIG_DEBUG
 			uart_puts("software interruption!\n");
+#endif
 			/*
 			 * acknowledge the software interrupt by clearing
     			 * the MSIP bit in mip.
 			 */
 			int id = r_mhartid();
-    		*(uint32_t*)CLINT_MSIP(id) = 0;
+    		*(volatile uint32_t*)CLINT_MSIP(id) = 0;
 
 			schedule_priority();
 
 			break;
 		case 7:
+#if CONFIG_DEBUG
 			uart_puts("timer interruption!\n");
+#endif
 			timer_handler();
 			break;
 		case 11:
+#if CONFIG_DEBUG
 			uart_puts("external interruption!\n");
+#endif
 			external_interrupt_handler();
 			break;
 		default:
 			uart_puts("unknown async exception!\n");
 			break;
 		}
+	} else if (cause_code == 8 || cause_code == 9 || cause_code == 11) {
+		/* Environment call from U/S/M-mode - system call */
+		//返回到ecall的下一条指令，阻塞的系统调用会在调度器中保存这个地址
+		ctx->pc = epc + 4;
+		do_syscall(ctx);
+		return_pc = ctx->pc;
+#if CONFIG_VM
+	} else if ((cause_code == 13 || cause_code == 15) && ctx->satp &&
+		vm_fault(SATP2PT(ctx->satp), r_mtval(), cause_code == 15, ctx->mode == MSTATUS_MPP_U) == 0) {
+		/* Load/Store page fault on a demand-zero page, retry the instruction */
+#endif
 	} else {
 		/* Synchronous trap - exception */
 		printf("Sync exceptions!, code = %d\n", cause_code);
+		//由任务触发的异常只结束该任务，task_fault 不会返回
+		task_fault(ctx, cause, epc, r_mtval());
 		panic("OOPS! What can I do!");
 		//return_pc += 4;
 	}
@@ -82,6 +112,22 @@ reg_t trap_handler(reg_t epc, reg_t cause)
 	return return_pc;
 }
 
+/*
+ * DESCRIPTION
+ * 	是否运行在内核栈上，即启动过程中或者trap处理中.
+ * 	这两种情况都不会被抢占，可以直接修改调度器和内存分配器的数据结构；
+ * 	任务运行在自己的栈上，随时可能被抢占，要通过系统调用进入trap再修改。
+ * RETURN VALUE
+ * 	1: 启动过程或trap中
+ * 	0: 任务中
+ */
+int trap_context(void)
+{
+	uint8_t here;
+	uint8_t *sp = &here;
+	return sp >= stacks && sp < stacks + KSTACK_SIZE * MAXNUM_CPU;
+}
+
 void trap_test()
 {
 	/*
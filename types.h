@@ -7,8 +7,14 @@ typedef unsigned int  uint32_t;
 typedef unsigned long long uint64_t;
 
 /*
- * RISCV32: register is 32bits width
- */ 
+ * register width, 32 bits on RV32 and 64 bits on RV64 (XLEN in common.mk)
+ * uintptr_t is an integer as wide as a pointer, for address arithmetic
+ */
+#if __riscv_xlen == 64
+typedef uint64_t reg_t;
+#else
 typedef uint32_t reg_t;
+#endif
+typedef reg_t uintptr_t;
 
 #endif /* __TYPES_H__ */
\ No newline at end of file
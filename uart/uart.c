@@ -63,6 +63,9 @@
 #define LSR_RX_READY (1 << 0)
 #define LSR_TX_IDLE  (1 << 5)
 
+/* Ctrl-T */
+#define TRACE_DUMP_KEY 0x14
+
 #define uart_read_reg(reg) (*(UART_REG(reg)))
 #define uart_write_reg(reg, v) (*(UART_REG(reg)) = (v))
 
@@ -104,12 +107,14 @@ void uart_init()
 	lcr = 0;
 	uart_write_reg(LCR, lcr | (3 << 0));
 
+#if CONFIG_UART_RX
 	/*
 	 * enable receive interrupts.
 	 */
 	// 使能接受中断
 	uint8_t ier = uart_read_reg(IER);
 	uart_write_reg(IER, ier | (1 << 0));
+#endif
 }
 
 int uart_putc(char ch)
@@ -127,6 +132,7 @@ void uart_puts(char *s)
 	}
 }
 
+#if CONFIG_UART_RX
 int uart_getc(void)
 {
 	// 如果接受寄存器有数据
@@ -148,9 +154,13 @@ void uart_isr(void)
 		int c = uart_getc();
 		if (c == -1) {
 			break;
+		} else if (c == TRACE_DUMP_KEY) {
+			// 按下 Ctrl-T 输出内核事件追踪记录
+			trace_dump();
 		} else {
 			uart_putc((char)c);
 			uart_putc('\n');
 		}
 	}
 }
+#endif /* CONFIG_UART_RX */
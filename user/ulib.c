@@ -0,0 +1,191 @@
+#include "../os.h"
+
+/*
+ * 用户任务使用的库：系统调用的封装和简单的格式化输出
+ * 这里的代码链接在 .utext 段中，U模式的任务只能调用这些函数，不能直接调用内核的函数
+ */
+
+static inline reg_t _syscall(reg_t num, reg_t arg0, reg_t arg1)
+{
+	register reg_t a0 asm("a0") = arg0;
+	register reg_t a1 asm("a1") = arg1;
+	register reg_t a7 asm("a7") = num;
+	asm volatile("ecall" : "+r" (a0) : "r" (a1), "r" (a7) : "memory");
+	return a0;
+}
+
+static inline reg_t _syscall3(reg_t num, reg_t arg0, reg_t arg1, reg_t arg2)
+{
+	register reg_t a0 asm("a0") = arg0;
+	register reg_t a1 asm("a1") = arg1;
+	register reg_t a2 asm("a2") = arg2;
+	register reg_t a7 asm("a7") = num;
+	asm volatile("ecall" : "+r" (a0) : "r" (a1), "r" (a2), "r" (a7) : "memory");
+	return a0;
+}
+
+int sys_gettid(void)
+{
+	return _syscall(SYS_GETTID, 0, 0);
+}
+
+void sys_yield(void)
+{
+	_syscall(SYS_YIELD, 0, 0);
+}
+
+void sys_sleep(uint32_t ticks)
+{
+	_syscall(SYS_SLEEP, ticks, 0);
+}
+
+// 用户任务的入口函数返回时也会跳转到这里
+void sys_exit(void)
+{
+	_syscall(SYS_EXIT, 0, 0);
+	while (1) {}
+}
+
+int sys_write(const char* buf, uint32_t len)
+{
+	return _syscall(SYS_WRITE, (reg_t)buf, len);
+}
+
+int sys_timer(uint32_t timeout, uint32_t msg)
+{
+	return _syscall(SYS_TIMER, timeout, msg);
+}
+
+int sys_send(uint32_t task_id, uint32_t msg)
+{
+	return _syscall(SYS_SEND, task_id, msg);
+}
+
+uint32_t sys_recv(void)
+{
+	return _syscall(SYS_RECV, 0, 0);
+}
+
+int sys_wait(volatile void* addr, uint32_t val)
+{
+	return _syscall(SYS_WAIT, (reg_t)addr, val);
+}
+
+int sys_wake(volatile void* addr)
+{
+	return _syscall(SYS_WAKE, (reg_t)addr, 0);
+}
+
+reg_t sys_mem(int op, reg_t arg0, reg_t arg1)
+{
+	return _syscall3(SYS_MEM, op, arg0, arg1);
+}
+
+int sys_task_create(const struct task_args* a)
+{
+	return _syscall(SYS_TASK_CREATE, (reg_t)a, 0);
+}
+
+int sys_job_end(void)
+{
+	return _syscall(SYS_JOB_END, 0, 0);
+}
+
+int sys_timer_add(struct TimerNode* node)
+{
+	return _syscall(SYS_TIMER_ADD, (reg_t)node, 0);
+}
+
+int sys_timer_del(struct TimerNode* node)
+{
+	return _syscall(SYS_TIMER_DEL, (reg_t)node, 0);
+}
+
+// 读取cycle计数器，需要内核在mcounteren中打开权限
+uint32_t ucycle(void)
+{
+	uint32_t x;
+	asm volatile("rdcycle %0" : "=r" (x));
+	return x;
+}
+
+//格式化输出到栈上的缓冲区，满了就用一次 sys_write 输出，支持 %d %x %s %c
+#define UPRINTF_BUF 64
+
+struct ubuf {
+	char buf[UPRINTF_BUF];
+	int len;
+	int total;
+};
+
+static void _uputc(struct ubuf* out, char ch)
+{
+	if (out->len == UPRINTF_BUF) {
+		sys_write(out->buf, out->len);
+		out->len = 0;
+	}
+	out->buf[out->len++] = ch;
+	out->total++;
+}
+
+int uprintf(const char* s, ...)
+{
+	struct ubuf out;
+	va_list vl;
+
+	out.len = 0;
+	out.total = 0;
+	va_start(vl, s);
+	for (; *s; s++) {
+		if (*s != '%' || s[1] == '\0') {
+			_uputc(&out, *s);
+			continue;
+		}
+		s++;
+		switch (*s) {
+		case 'd': {
+			int num = va_arg(vl, int);
+			unsigned int n = num;
+			char digits[10];
+			int i = 0;
+			if (num < 0) {
+				_uputc(&out, '-');
+				n = -num;
+			}
+			do {
+				digits[i++] = '0' + n % 10;
+				n /= 10;
+			} while (n);
+			while (i) {
+				_uputc(&out, digits[--i]);
+			}
+			break;
+		}
+		case 'x': {
+			unsigned int num = va_arg(vl, unsigned int);
+			for (int i = 28; i >= 0; i -= 4) {
+				_uputc(&out, "0123456789abcdef"[(num >> i) & 0xf]);
+			}
+			break;
+		}
+		case 's': {
+			const char* str = va_arg(vl, const char*);
+			while (*str) {
+				_uputc(&out, *str++);
+			}
+			break;
+		}
+		case 'c':
+			_uputc(&out, (char)va_arg(vl, int));
+			break;
+		default:
+			_uputc(&out, *s);
+			break;
+		}
+	}
+	va_end(vl);
+	if (out.len) {
+		sys_write(out.buf, out.len);
+	}
+	return out.total;
+}
@@ -165,6 +165,7 @@ void user_task9(void* param)
 {
 	uart_puts("Task 9: Created!\n");
 
+#if CONFIG_TIMER
 	struct timer *t1 = timer_create(timer_func, &person, 10);
 	if (NULL == t1) {
 		printf("timer_create() failed!\n");
@@ -177,6 +178,7 @@ void user_task9(void* param)
 	if (NULL == t3) {
 		printf("timer_create() failed!\n");
 	}
+#endif
 	int i = 1;
 	while (1) {
 		i++;
@@ -203,9 +205,502 @@ void user_task10(void* param)
 	}
 }
 
+// 测试EDF周期任务，时间单位为mtime的tick，10000 tick = 1ms
+#define EDF_MS (CLINT_TIMEBASE_FREQ / 1000)
+int edf_id0 = -1;
+int edf_id1 = -1;
+int edf_jobs0 = 0;
+int edf_jobs1 = 0;
+
+// 每个周期执行一次，函数返回即作业完成
+void user_periodic0(void* param)
+{
+	edf_jobs0++;
+	if (edf_jobs0 % 100 == 0) {
+		printf("Periodic 0: jobs %d, deadline misses %d\n", edf_jobs0, task_deadline_misses(edf_id0));
+	}
+}
+
+void user_periodic1(void* param)
+{
+	edf_jobs1++;
+	task_delay(1);
+	if (edf_jobs1 % 40 == 0) {
+		printf("Periodic 1: jobs %d, deadline misses %d\n", edf_jobs1, task_deadline_misses(edf_id1));
+	}
+}
+
+// 测试时间片公平性：同一优先级的三个任务，时间片之比为 1:2:3
+#define FAIR_TASKS 3
+#define FAIR_REPORT_INTERVAL CLINT_TIMEBASE_FREQ
+uint32_t fair_timeslice[FAIR_TASKS] = {100000, 200000, 300000};
+volatile uint32_t fair_counter[FAIR_TASKS];
+
+void user_fair_task(void* param)
+{
+	int i = (int)(uintptr_t)param;
+	while (1) {
+		fair_counter[i]++;
+	}
+}
+
+// 统计各任务的CPU占比(千分比)，并与时间片的比例对比
+void fair_report(void)
+{
+	uint32_t total = 0;
+	uint32_t total_slice = 0;
+	for (int i = 0; i < FAIR_TASKS; i++) {
+		total += fair_counter[i];
+		total_slice += fair_timeslice[i];
+	}
+	if (total == 0) {
+		return;
+	}
+	for (int i = 0; i < FAIR_TASKS; i++) {
+		// 除以1000防止乘法溢出
+		uint32_t share = fair_counter[i] / (total / 1000 + 1);
+		uint32_t expect = fair_timeslice[i] / (total_slice / 1000);
+		printf("fair task %d: share %d permille, expect %d permille\n", i, share, expect);
+	}
+}
+
+// 定时报告的任务，报告在任务中打印，不在定时器中断中重新创建定时器
+void user_fair_report_task(void* param)
+{
+	while (1) {
+		sys_sleep(FAIR_REPORT_INTERVAL);
+		fair_report();
+	}
+}
+
+// 测试优先级老化：优先级0的任务一直占用CPU，统计低优先级任务的最长等待时间
+#define AGING_TASKS 2
+#define AGING_INTERVAL (CLINT_TIMEBASE_FREQ / 100)
+#define AGING_REPORT_INTERVAL (2 * CLINT_TIMEBASE_FREQ)
+int aging_priority[AGING_TASKS] = {3, 7};
+uint32_t aging_max_wait[AGING_TASKS];
+uint32_t aging_runs[AGING_TASKS];
+
+void user_hog_task(void* param)
+{
+	while (1) {}
+}
+
+// 两次连续观察到mtime之间的间隔，就是该任务被其他任务占用CPU的时间
+void user_aging_task(void* param)
+{
+	int i = (int)(uintptr_t)param;
+	uint64_t last = clock_ticks();
+	while (1) {
+		uint64_t now = clock_ticks();
+		uint32_t wait = now - last;
+		// 间隔超过1ms才认为是被调度出去了一次
+		if (wait > CLINT_TIMEBASE_FREQ / 1000) {
+			aging_runs[i]++;
+			if (wait > aging_max_wait[i]) {
+				aging_max_wait[i] = wait;
+			}
+		}
+		last = now;
+	}
+}
+
+// 定时报告的任务，优先级0，和占用CPU的任务轮流运行
+void user_aging_report_task(void* param)
+{
+	while (1) {
+		sys_sleep(AGING_REPORT_INTERVAL);
+		for (int i = 0; i < AGING_TASKS; i++) {
+			printf("priority %d: scheduled %d times, worst-case wait %d us\n", aging_priority[i],
+				aging_runs[i], aging_max_wait[i] / (CLINT_TIMEBASE_FREQ / 1000000));
+		}
+	}
+}
+
+// 测试栈的最高水位统计：递归深度不同的任务占用的栈空间不同
+int user_recurse(int depth)
+{
+	volatile char frame[32];
+	frame[0] = depth;
+	if (depth == 0) {
+		return frame[0];
+	}
+	return user_recurse(depth - 1) + frame[0];
+}
+
+void user_stack_task(void* param)
+{
+	int depth = (int)(uintptr_t)param;
+	while (1) {
+		user_recurse(depth);
+		task_delay(DELAY);
+	}
+}
+
+// 定时打印各任务栈的最高水位
+void user_stack_report_task(void* param)
+{
+	while (1) {
+		sys_sleep(CLINT_TIMEBASE_FREQ);
+		task_stack_report();
+	}
+}
+
+// 测试U模式的用户任务：只能通过系统调用使用内核，生产者和消费者通过消息通信
+#define SYSCALL_BENCH_ROUNDS 1000
+
+void user_consumer(void* param)
+{
+	int tid = sys_gettid();
+	while (1) {
+		uint32_t msg = sys_recv();
+		uprintf("consumer %d: got %d\n", tid, msg);
+	}
+}
+
+void user_producer(void* param)
+{
+	uint32_t consumer = (uint32_t)(uintptr_t)param;
+	for (int i = 0; i < 20; i++) {
+		if (sys_send(consumer, i) < 0) {
+			uprintf("producer: mailbox of task %d is full\n", consumer);
+		}
+		sys_sleep(CLINT_TIMEBASE_FREQ / 10);
+	}
+	uprintf("producer: done\n");
+}
+
+// 软件定时器超时后内核给任务发送一条消息
+void user_timer_task(void* param)
+{
+	while (1) {
+		sys_timer(5, 0x5a);
+		uprintf("timer task: woken up by 0x%x\n", sys_recv());
+	}
+}
+
+// 空系统调用的开销：陷入、分发、返回
+void user_syscall_bench(void* param)
+{
+	while (1) {
+		uint32_t start = ucycle();
+		for (int i = 0; i < SYSCALL_BENCH_ROUNDS; i++) {
+			sys_gettid();
+		}
+		uint32_t cycles = ucycle() - start;
+		uprintf("null syscall: %d cycles per call\n", cycles / SYSCALL_BENCH_ROUNDS);
+		sys_sleep(CLINT_TIMEBASE_FREQ);
+	}
+}
+
+// 测试PMP隔离和任务切换的开销，分别在 CONFIG_PMP=0 和 CONFIG_PMP=1 时运行并对比
+#define SWITCH_BENCH_ROUNDS 1000
+
+void user_yield_task(void* param)
+{
+	while (1) {
+		sys_yield();
+	}
+}
+
+// 两个任务互相让出CPU，每次 sys_yield 对应两次任务切换
+void user_switch_bench(void* param)
+{
+	while (1) {
+		uint32_t start = ucycle();
+		for (int i = 0; i < SWITCH_BENCH_ROUNDS; i++) {
+			sys_yield();
+		}
+		uint32_t cycles = ucycle() - start;
+		uprintf("task switch: %d cycles per switch\n", cycles / (2 * SWITCH_BENCH_ROUNDS));
+	}
+}
+
+// 访问内核的内存，开启PMP时应当被拦截，只有该任务被结束而不是整个系统停止
+void user_bad_task(void* param)
+{
+	uprintf("bad task: writing to kernel memory\n");
+	*(volatile int *)0x80000000 = 0;
+	uprintf("bad task: the write was not blocked!\n");
+}
+
+// 测试异常恢复：任务触发访存异常后被重启两次，然后被结束，其他任务不受影响
+void user_fault_task(void* param)
+{
+	printf("fault task: started\n");
+	task_delay(DELAY);
+	trap_test();
+}
+
+// 测试按需分配的内存(需要 CONFIG_VM=1)：读过的页共享全零页，只有写过的页才分配物理内存
+#define DEMAND_WRITE_PAGES 8
+
+void user_demand_task(void* param)
+{
+	volatile uint32_t *heap = (uint32_t *)VM_HEAP_BASE;
+	TaskNode* self = task_find(sys_gettid());
+	uint32_t sum = 0;
+
+	for (uint32_t off = 0; off < VM_HEAP_SIZE; off += PAGE_SIZE) {
+		sum += heap[off / sizeof(uint32_t)];
+	}
+	printf("demand task: read %d heap pages, sum %d, committed %d bytes\n", VM_HEAP_SIZE / PAGE_SIZE, sum,
+		vm_committed(self->pagetable, VM_HEAP_BASE, VM_HEAP_SIZE));
+
+	for (int i = 0; i < DEMAND_WRITE_PAGES; i++) {
+		heap[i * PAGE_SIZE / sizeof(uint32_t)] = i;
+	}
+	printf("demand task: wrote %d heap pages, committed %d bytes\n", DEMAND_WRITE_PAGES,
+		vm_committed(self->pagetable, VM_HEAP_BASE, VM_HEAP_SIZE));
+	task_stack_report();
+}
+
+// 测试virtio磁盘：每批提交 BLK_BATCH 个随机读请求，任务阻塞在 sys_recv 上等待完成，统计IOPS
+#define BLK_BATCH 16
+#define BLK_BENCH_BATCHES 256
+
+struct blk_req blk_reqs[BLK_BATCH];
+uint8_t blk_bufs[BLK_BATCH][BLK_SECTOR_SIZE];
+
+// 请求完成时给提交请求的任务发送消息
+void blk_bench_done(struct blk_req* req)
+{
+	msg_send((uint32_t)(uintptr_t)req->arg, req - blk_reqs);
+}
+
+void user_blk_task(void* param)
+{
+	struct blk_req* reqs[BLK_BATCH];
+	uint32_t tid = sys_gettid();
+	uint32_t sectors = virtio_blk_capacity();
+	uint32_t seed = 1;
+	uint32_t errors = 0;
+
+	if (sectors == 0) {
+		printf("blk task: no disk\n");
+		return;
+	}
+	for (int i = 0; i < BLK_BATCH; i++) {
+		blk_reqs[i].buf = blk_bufs[i];
+		blk_reqs[i].len = BLK_SECTOR_SIZE;
+		blk_reqs[i].write = 0;
+		blk_reqs[i].done = blk_bench_done;
+		blk_reqs[i].arg = (void*)(uintptr_t)tid;
+		reqs[i] = &blk_reqs[i];
+	}
+
+	uint64_t start = clock_ticks();
+	for (int b = 0; b < BLK_BENCH_BATCHES; b++) {
+		for (int i = 0; i < BLK_BATCH; i++) {
+			seed = seed * 1103515245 + 12345;
+			blk_reqs[i].sector = seed % sectors;
+		}
+		int queued = 0;
+		while (queued < BLK_BATCH) {
+			queued += virtio_blk_submit(reqs + queued, BLK_BATCH - queued);
+		}
+		for (int i = 0; i < BLK_BATCH; i++) {
+			uint32_t id = sys_recv();
+			if (blk_reqs[id].status != BLK_OK) {
+				errors++;
+			}
+		}
+	}
+	uint32_t us = clock_ticks_to_us(clock_ticks() - start);
+	// 按毫秒计算，避免乘法溢出
+	printf("blk task: %d reads in %d us, %d IOPS, %d errors\n", BLK_BATCH * BLK_BENCH_BATCHES, us,
+		BLK_BATCH * BLK_BENCH_BATCHES * 1000 / (us / 1000 + 1), errors);
+	virtio_blk_stats();
+}
+
+// 测试块缓存：顺序读两遍磁盘开头的 BCACHE_BENCH_BLOCKS 个块，第一遍触发预读，第二遍全部命中
+#define BCACHE_BENCH_BLOCKS 64
+
+void user_bcache_task(void* param)
+{
+	struct blk_dev* dev = virtio_blk_dev();
+	struct bcache_stats stats;
+
+	if (dev == NULL) {
+		printf("bcache task: no disk\n");
+		return;
+	}
+	for (int pass = 0; pass < 2; pass++) {
+		uint64_t start = clock_ticks();
+		for (uint32_t i = 0; i < BCACHE_BENCH_BLOCKS && i < dev->nblocks; i++) {
+			struct buf* b = bread(dev, i);
+			if (!b->valid) {
+				printf("bcache task: read block %d failed\n", i);
+			}
+			brelse(b);
+		}
+		uint32_t us = clock_ticks_to_us(clock_ticks() - start);
+		printf("bcache task: pass %d, %d blocks in %d us\n", pass, BCACHE_BENCH_BLOCKS, us);
+	}
+
+	//改写一个块并写回
+	struct buf* b = bread(dev, 0);
+	b->data[0]++;
+	bwrite(b);
+	brelse(b);
+	bcache_flush();
+
+	bcache_get_stats(&stats);
+	printf("bcache task: hits %d, misses %d, evictions %d, readaheads %d, writebacks %d\n",
+		stats.hits, stats.misses, stats.evictions, stats.readaheads, stats.writebacks);
+}
+
+// 测试romfs：打印文件列表，按路径打开文件，复制读取和直接映射
+void user_romfs_task(void* param)
+{
+	struct romfs_file f;
+	char line[64];
+	int n;
+
+	romfs_list();
+	if (romfs_open("/etc/motd", &f) < 0) {
+		printf("romfs task: /etc/motd not found\n");
+		return;
+	}
+	while ((n = romfs_read(&f, line, sizeof(line) - 1)) > 0) {
+		line[n] = 0;
+		printf("%s", line);
+	}
+
+	if (romfs_open("etc/sched.conf", &f) == 0) {
+		const char* conf = romfs_map(&f, 0, f.size);
+		printf("romfs task: sched.conf %d bytes at 0x%x, first char '%c'\n", f.size, conf, conf[0]);
+	}
+	if (romfs_open("etc/none", &f) < 0) {
+		printf("romfs task: etc/none not found\n");
+	}
+}
+
+// 测试键值存储：在内存块设备上写入和读取，统计每秒的操作数和写放大
+#define KV_BENCH_BLOCKS 256
+#define KV_BENCH_KEYS 128
+#define KV_BENCH_PUTS 4096
+#define KV_BENCH_COMMIT 16
+#define KV_BENCH_VALUE 64
+
+static void kv_bench_key(char* key, uint32_t i)
+{
+	const char* hex = "0123456789abcdef";
+	key[0] = 'k';
+	for (int j = 0; j < 4; j++) {
+		key[1 + j] = hex[(i >> (12 - 4 * j)) & 0xf];
+	}
+	key[5] = 0;
+}
+
+void user_kv_task(void* param)
+{
+	struct blk_dev* dev = param ? virtio_blk_dev() : ramdisk_create(KV_BENCH_BLOCKS);
+	struct bcache_stats bs0, bs1;
+	struct kv_stats ks;
+	uint32_t val[KV_BENCH_VALUE / 4];
+	char key[8];
+	uint32_t errors = 0;
+
+	if (dev == NULL || kv_mount(dev) < 0) {
+		printf("kv task: mount failed\n");
+		return;
+	}
+	bcache_get_stats(&bs0);
+
+	uint64_t start = clock_ticks();
+	for (uint32_t i = 0; i < KV_BENCH_PUTS; i++) {
+		kv_bench_key(key, i % KV_BENCH_KEYS);
+		val[0] = i;
+		if (kv_put(key, val, sizeof(val)) < 0) {
+			errors++;
+		}
+		if (i % KV_BENCH_COMMIT == KV_BENCH_COMMIT - 1) {
+			kv_commit();
+		}
+	}
+	uint32_t put_us = clock_ticks_to_us(clock_ticks() - start);
+
+	start = clock_ticks();
+	for (uint32_t i = 0; i < KV_BENCH_PUTS; i++) {
+		kv_bench_key(key, i % KV_BENCH_KEYS);
+		if (kv_get(key, val, sizeof(val)) != sizeof(val) ||
+			val[0] != KV_BENCH_PUTS - KV_BENCH_KEYS + i % KV_BENCH_KEYS) {
+			errors++;
+		}
+	}
+	uint32_t get_us = clock_ticks_to_us(clock_ticks() - start);
+
+	bcache_get_stats(&bs1);
+	kv_get_stats(&ks);
+	// 写放大按百分比计算：日志的字节数，以及实际写回设备的字节数，相对于写入的键和值
+	uint32_t log_wa = ks.log_bytes / (ks.user_bytes / 100 + 1);
+	uint32_t dev_wa = (bs1.writebacks - bs0.writebacks) * BLOCK_SIZE / (ks.user_bytes / 100 + 1);
+	printf("kv task: %d puts in %d us, %d puts/s\n", KV_BENCH_PUTS, put_us, KV_BENCH_PUTS * 1000 / (put_us / 1000 + 1));
+	printf("kv task: %d gets in %d us, %d gets/s\n", KV_BENCH_PUTS, get_us, KV_BENCH_PUTS * 1000 / (get_us / 1000 + 1));
+	printf("kv task: write amplification log %d.%d%d, device %d.%d%d, %d compactions, %d errors\n",
+		log_wa / 100, log_wa / 10 % 10, log_wa % 10, dev_wa / 100, dev_wa / 10 % 10, dev_wa % 10,
+		ks.compactions, errors);
+}
+
+// 运行内存管理、就绪链表和定时器的自测，最后检查真实的堆和页描述符
+// 就绪链表和定时器链表在中断上下文中修改，自测期间由调度器检查
+void user_selftest_task(void* param)
+{
+	int errors = page_test() + sched_test();
+#if CONFIG_TIMER
+	errors += timer_test();
+#endif
+	errors += heap_check() + page_check();
+	heap_report();
+	printf("selftest: %s, %d errors\n", errors ? "FAILED" : "passed", errors);
+}
+
+#define ARENA_BENCH_OBJS 200
+#define ARENA_BENCH_SIZE 24
+
+// 短生命周期的工作任务：从任务的区域中分配大量小对象，退出时整体释放
+void user_arena_worker(void* param)
+{
+	uint32_t start = ucycle();
+	for (int i = 0; i < ARENA_BENCH_OBJS; i++) {
+		uint32_t* obj = task_alloc(ARENA_BENCH_SIZE);
+		if (obj == NULL) {
+			printf("arena worker %d: out of memory\n", (int)(uintptr_t)param);
+			return;
+		}
+		obj[0] = i;
+	}
+	printf("arena worker %d: %d objects, %d cycles/alloc\n",
+		(int)(uintptr_t)param, ARENA_BENCH_OBJS, (ucycle() - start) / ARENA_BENCH_OBJS);
+}
+
+// 对比 my_malloc/my_free 逐个释放的开销
+void user_arena_task(void* param)
+{
+	static uint32_t* objs[ARENA_BENCH_OBJS];
+	uint32_t start = ucycle();
+	for (int i = 0; i < ARENA_BENCH_OBJS; i++) {
+		objs[i] = my_malloc(ARENA_BENCH_SIZE);
+	}
+	for (int i = 0; i < ARENA_BENCH_OBJS; i++) {
+		my_free(objs[i]);
+	}
+	printf("arena task: my_malloc + my_free %d cycles/object\n", (ucycle() - start) / ARENA_BENCH_OBJS);
+
+	for (int i = 0; i < 4; i++) {
+		task_create_priority(user_arena_worker, (void*)(uintptr_t)i, 0, 10000000);
+	}
+}
+
 /* NOTICE: DON'T LOOP INFINITELY IN main() */
 void os_main(void)
 {
+#if CONFIG_BENCH
+	bench_start();
+	return;
+#endif
+
 	/*
 	// 1. 测试抢占式优先级多任务调度
 	char* param0 = "Task 0: priority 0\n";
@@ -238,6 +733,106 @@ void os_main(void)
 	char* param10 = "Task 10: priority 0\n";
 	task_create_priority(user_task10, param10, 0, 20000000);
 	//*/
+
+	/*
+	// 4. 测试EDF周期任务，EDF任务总是优先于固定优先级任务运行
+	edf_id0 = task_create_periodic(user_periodic0, NULL, 10 * EDF_MS, 2 * EDF_MS, 0);
+	edf_id1 = task_create_periodic(user_periodic1, NULL, 25 * EDF_MS, 10 * EDF_MS, 20 * EDF_MS);
+	// 利用率之和将超过1，应当被准入控制拒绝
+	if (task_create_periodic(user_periodic0, NULL, 10 * EDF_MS, 5 * EDF_MS, 0) < 0) {
+		printf("EDF task 2 rejected by admission control\n");
+	}
+	task_create_priority(user_task10, "Task 10: priority 0\n", 0, 20000000);
+	*/
+
+	/*
+	// 5. 测试时间片公平性，CPU占比应当与时间片之比一致
+	for (int i = 0; i < FAIR_TASKS; i++) {
+		task_create_priority(user_fair_task, (void*)i, 0, fair_timeslice[i]);
+	}
+	task_create_priority(user_fair_report_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 6. 测试优先级老化，关闭老化(间隔为0)时低优先级任务永远得不到运行
+	sched_set_aging(AGING_INTERVAL);
+	task_create_priority(user_hog_task, NULL, 0, 100000);
+	for (int i = 0; i < AGING_TASKS; i++) {
+		task_create_priority(user_aging_task, (void*)i, aging_priority[i], 100000);
+	}
+	task_create_priority(user_aging_report_task, NULL, 0, 100000);
+	*/
+
+	/*
+	// 7. 测试栈使用的最高水位统计
+	task_create_priority(user_stack_task, (void*)2, 0, 10000000);
+	task_create_priority(user_stack_task, (void*)10, 0, 10000000);
+	task_create_priority(user_stack_report_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 8. 测试U模式的用户任务和系统调用
+	int consumer = task_create_user(user_consumer, NULL, 0, 10000000);
+	task_create_user(user_producer, (void*)consumer, 0, 10000000);
+	task_create_user(user_timer_task, NULL, 0, 10000000);
+	task_create_user(user_syscall_bench, NULL, 1, 10000000);
+	*/
+
+	/*
+	// 9. 测试PMP隔离和任务切换开销
+	task_create_user(user_switch_bench, NULL, 0, 10000000);
+	task_create_user(user_yield_task, NULL, 0, 10000000);
+	task_create_user(user_bad_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 10. 测试异常恢复和任务重启策略
+	int fault_id = task_create_priority(user_fault_task, NULL, 0, 10000000);
+	task_set_restart(fault_id, 2);
+	task_create_priority(user_task10, "Task 10: priority 0\n", 0, 20000000);
+	*/
+
+	/*
+	// 11. 测试按需分配的栈和堆，需要 CONFIG_VM=1
+	task_create_priority(user_demand_task, NULL, 0, 10000000);
+	task_create_priority(user_stack_task, (void*)10, 0, 10000000);
+	*/
+
+	/*
+	// 12. 测试virtio磁盘的异步请求，需要 make run 创建的 disk.img
+	task_create_priority(user_blk_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 13. 测试块缓存的命中率和预读
+	task_create_priority(user_bcache_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 14. 测试只读文件系统romfs
+	task_create_priority(user_romfs_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 15. 测试键值存储的性能，参数不为NULL时使用virtio磁盘
+	task_create_priority(user_kv_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 16. 测试ELF加载器，从romfs启动两个 apps/hello.c 的实例，共享只读的代码页，需要 CONFIG_VM=1
+	task_create_elf_file("bin/hello", (void*)1, 0, 10000000);
+	task_create_elf_file("bin/hello", (void*)2, 0, 10000000);
+	*/
+
+	/*
+	// 17. 运行内存管理、就绪链表和定时器的随机自测
+	task_create_priority(user_selftest_task, NULL, 0, 10000000);
+	*/
+
+	/*
+	// 18. 测试任务的区域分配器，工作任务退出时区域整体释放
+	task_create_priority(user_arena_task, NULL, 0, 10000000);
+	*/
 	
 
 }
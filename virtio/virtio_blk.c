@@ -0,0 +1,328 @@
+#include "../os.h"
+#include "virtio.h"
+
+/*
+ * virtio-blk 磁盘驱动
+ * 使用 split virtqueue，每个请求由3个描述符组成：请求头、数据缓冲区、状态字节。
+ * 提交是异步的：virtio_blk_submit 把一批请求放进 avail ring 之后只通知设备一次就返回，
+ * 设备完成请求后通过 PLIC 产生中断，在 virtio_blk_isr 中设置请求的状态并调用完成回调。
+ *
+ * 提交者之间用自旋锁保护 avail ring；中断处理只读 used ring 并归还描述符，
+ * 描述符的空闲位图用原子指令修改，所以提交时不需要关中断。
+ */
+
+#define R(r) ((volatile uint32_t *)(VIRTIO0 + (r)))
+
+/* 队列长度，必须是2的幂 */
+#define NUM 64
+/* 每个请求占用的描述符个数 */
+#define DESC_PER_REQ 3
+
+static struct disk {
+	struct virtq_desc *desc;
+	struct virtq_avail *avail;
+	volatile struct virtq_used *used;
+
+	uint32_t free[NUM / 32]; // 空闲描述符位图，1表示空闲
+	uint16_t used_idx;       // 已经处理到的 used ring 位置，只在中断处理中访问
+
+	/* 以请求的第一个描述符为下标 */
+	struct blk_req *inflight[NUM];
+	struct virtio_blk_req ops[NUM];
+	volatile uint8_t status[NUM];
+
+	struct spinlock lock;
+	uint32_t capacity;       // 扇区数
+	int ready;
+
+	uint32_t submitted;
+	uint32_t completed;
+	uint32_t notifies;
+} disk;
+
+/* 分配一个空闲描述符，只有持有 disk.lock 的提交者会分配 */
+static int alloc_desc(void)
+{
+	for (int w = 0; w < NUM / 32; w++) {
+		uint32_t v = disk.free[w];
+		for (int b = 0; v && b < 32; b++) {
+			if (v & (1u << b)) {
+				__sync_fetch_and_and(&disk.free[w], ~(1u << b));
+				return w * 32 + b;
+			}
+		}
+	}
+	return -1;
+}
+
+/* 归还描述符，在中断处理中调用 */
+static void free_desc(int i)
+{
+	__sync_fetch_and_or(&disk.free[i / 32], 1u << (i % 32));
+}
+
+static void free_chain(int i)
+{
+	while (1) {
+		int flags = disk.desc[i].flags;
+		int next = disk.desc[i].next;
+		free_desc(i);
+		if (!(flags & VRING_DESC_F_NEXT)) {
+			break;
+		}
+		i = next;
+	}
+}
+
+static int alloc3_desc(int *idx)
+{
+	for (int i = 0; i < DESC_PER_REQ; i++) {
+		idx[i] = alloc_desc();
+		if (idx[i] < 0) {
+			for (int j = 0; j < i; j++) {
+				free_desc(idx[j]);
+			}
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	初始化 virtio-blk 设备，按照 virtio 规范 3.1.1 的顺序协商特性并设置队列.
+ * RETURN VALUE
+ * 	0: 成功
+ * 	-1: 没有找到磁盘设备
+ */
+int virtio_blk_init(void)
+{
+	uint32_t status = 0;
+
+	if (*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 ||
+		*R(VIRTIO_MMIO_VERSION) != 2 ||
+		*R(VIRTIO_MMIO_DEVICE_ID) != 2 ||
+		*R(VIRTIO_MMIO_VENDOR_ID) != 0x554d4551) {
+		printf("virtio-blk: no disk found\n");
+		return -1;
+	}
+
+	/* reset device */
+	*R(VIRTIO_MMIO_STATUS) = status;
+
+	status |= VIRTIO_CONFIG_S_ACKNOWLEDGE;
+	*R(VIRTIO_MMIO_STATUS) = status;
+	status |= VIRTIO_CONFIG_S_DRIVER;
+	*R(VIRTIO_MMIO_STATUS) = status;
+
+	/* negotiate features */
+	*R(VIRTIO_MMIO_DEVICE_FEATURES_SEL) = 0;
+	uint32_t features = *R(VIRTIO_MMIO_DEVICE_FEATURES);
+	features &= ~(1 << VIRTIO_BLK_F_RO);
+	features &= ~(1 << VIRTIO_BLK_F_SCSI);
+	features &= ~(1 << VIRTIO_BLK_F_CONFIG_WCE);
+	features &= ~(1 << VIRTIO_BLK_F_MQ);
+	features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
+	features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
+	features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
+	*R(VIRTIO_MMIO_DRIVER_FEATURES_SEL) = 0;
+	*R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
+	/* the modern interface requires VIRTIO_F_VERSION_1 */
+	*R(VIRTIO_MMIO_DRIVER_FEATURES_SEL) = 1;
+	*R(VIRTIO_MMIO_DRIVER_FEATURES) = 1 << (VIRTIO_F_VERSION_1 - 32);
+
+	/* tell device that feature negotiation is complete. */
+	status |= VIRTIO_CONFIG_S_FEATURES_OK;
+	*R(VIRTIO_MMIO_STATUS) = status;
+	if (!(*R(VIRTIO_MMIO_STATUS) & VIRTIO_CONFIG_S_FEATURES_OK)) {
+		printf("virtio-blk: FEATURES_OK unset\n");
+		return -1;
+	}
+
+	/* initialize queue 0. */
+	*R(VIRTIO_MMIO_QUEUE_SEL) = 0;
+	if (*R(VIRTIO_MMIO_QUEUE_READY)) {
+		printf("virtio-blk: queue should not be ready\n");
+		return -1;
+	}
+	if (*R(VIRTIO_MMIO_QUEUE_NUM_MAX) < NUM) {
+		printf("virtio-blk: max queue too short\n");
+		return -1;
+	}
+
+	/* 描述符表、avail ring 和 used ring 放在同一页中 */
+	char *page = (char *)page_alloc(1);
+	if (page == NULL) {
+		return -1;
+	}
+	memset(page, 0, PAGE_SIZE);
+	disk.desc = (struct virtq_desc *)page;
+	disk.avail = (struct virtq_avail *)(page + NUM * sizeof(struct virtq_desc));
+	disk.used = (struct virtq_used *)(page + PAGE_SIZE / 2);
+
+	*R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
+	*R(VIRTIO_MMIO_QUEUE_DESC_LOW) = (uint32_t)(uintptr_t)disk.desc;
+	*R(VIRTIO_MMIO_QUEUE_DESC_HIGH) = 0;
+	*R(VIRTIO_MMIO_DRIVER_DESC_LOW) = (uint32_t)(uintptr_t)disk.avail;
+	*R(VIRTIO_MMIO_DRIVER_DESC_HIGH) = 0;
+	*R(VIRTIO_MMIO_DEVICE_DESC_LOW) = (uint32_t)(uintptr_t)disk.used;
+	*R(VIRTIO_MMIO_DEVICE_DESC_HIGH) = 0;
+	*R(VIRTIO_MMIO_QUEUE_READY) = 1;
+
+	for (int i = 0; i < NUM / 32; i++) {
+		disk.free[i] = 0xffffffff;
+	}
+	disk.used_idx = 0;
+	disk.lock.locked = 0;
+
+	/* tell device we're completely ready. */
+	status |= VIRTIO_CONFIG_S_DRIVER_OK;
+	*R(VIRTIO_MMIO_STATUS) = status;
+
+	/* capacity is a 64-bit count of 512-byte sectors, the high half is ignored */
+	disk.capacity = *R(VIRTIO_MMIO_CONFIG);
+	disk.ready = 1;
+	printf("virtio-blk: %d sectors, queue size %d\n", disk.capacity, NUM);
+	return 0;
+}
+
+/*
+ * DESCRIPTION
+ * 	异步提交一批磁盘请求，所有请求放入 avail ring 之后只通知设备一次.
+ * 	请求完成时在中断上下文中设置 req->status，并调用 req->done (可以为NULL)。
+ * 	提交后直到完成之前，请求和缓冲区都不能被修改或释放。
+ * 	- reqs: 请求数组，缓冲区必须是内核可以直接访问的物理地址
+ * 	- n: 请求个数
+ * RETURN VALUE
+ * 	实际提交的请求个数，描述符不够时小于n，剩下的请求需要稍后重新提交
+ * 	-1: 设备不存在或请求参数错误
+ */
+int virtio_blk_submit(struct blk_req *reqs[], int n)
+{
+	int queued = 0;
+	int idx[DESC_PER_REQ];
+
+	if (!disk.ready) {
+		return -1;
+	}
+	for (int i = 0; i < n; i++) {
+		if (reqs[i]->len == 0 || reqs[i]->len % BLK_SECTOR_SIZE ||
+			reqs[i]->sector + reqs[i]->len / BLK_SECTOR_SIZE > disk.capacity) {
+			return -1;
+		}
+	}
+
+	spin_lock(&disk.lock);
+	for (; queued < n; queued++) {
+		struct blk_req *req = reqs[queued];
+		if (alloc3_desc(idx) < 0) {
+			break;
+		}
+
+		struct virtio_blk_req *op = &disk.ops[idx[0]];
+		op->type = req->write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+		op->reserved = 0;
+		op->sector = req->sector;
+
+		disk.desc[idx[0]].addr = (uintptr_t)op;
+		disk.desc[idx[0]].len = sizeof(struct virtio_blk_req);
+		disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
+		disk.desc[idx[0]].next = idx[1];
+
+		disk.desc[idx[1]].addr = (uintptr_t)req->buf;
+		disk.desc[idx[1]].len = req->len;
+		/* device reads the buffer for a write, writes it for a read */
+		disk.desc[idx[1]].flags = (req->write ? 0 : VRING_DESC_F_WRITE) | VRING_DESC_F_NEXT;
+		disk.desc[idx[1]].next = idx[2];
+
+		/* device writes 0 on success */
+		disk.status[idx[0]] = 0xff;
+		disk.desc[idx[2]].addr = (uintptr_t)&disk.status[idx[0]];
+		disk.desc[idx[2]].len = 1;
+		disk.desc[idx[2]].flags = VRING_DESC_F_WRITE;
+		disk.desc[idx[2]].next = 0;
+
+		req->status = BLK_PENDING;
+		disk.inflight[idx[0]] = req;
+
+		disk.avail->ring[(disk.avail->idx + queued) % NUM] = idx[0];
+	}
+
+	if (queued > 0) {
+		/* the descriptors and ring entries must be visible before idx */
+		__sync_synchronize();
+		disk.avail->idx += queued;
+		__sync_synchronize();
+		*R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0; // value is queue number
+		disk.submitted += queued;
+		disk.notifies++;
+	}
+	spin_unlock(&disk.lock);
+
+	return queued;
+}
+
+/*
+ * this routine should be called in interrupt context (interrupt is disabled)
+ * 处理设备完成的请求
+ */
+void virtio_blk_isr(void)
+{
+	/*
+	 * the device won't raise another interrupt until we tell it
+	 * we've seen this interrupt
+	 */
+	*R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+
+	__sync_synchronize();
+
+	/* the device increments disk.used->idx when it adds an entry */
+	while (disk.used_idx != disk.used->idx) {
+		__sync_synchronize();
+		int id = disk.used->ring[disk.used_idx % NUM].id;
+		struct blk_req *req = disk.inflight[id];
+
+		req->status = disk.status[id] == 0 ? BLK_OK : BLK_ERROR;
+		disk.inflight[id] = NULL;
+		free_chain(id);
+		disk.used_idx++;
+		disk.completed++;
+
+		if (req->done) {
+			req->done(req);
+		}
+	}
+}
+
+static int virtio_blk_dev_submit(struct blk_dev *dev, struct blk_req *reqs[], int n)
+{
+	return virtio_blk_submit(reqs, n);
+}
+
+static struct blk_dev _virtio_blk_dev = {
+	.name = "virtio-blk",
+	.submit = virtio_blk_dev_submit,
+};
+
+//块设备接口，没有磁盘时返回NULL
+struct blk_dev *virtio_blk_dev(void)
+{
+	if (!disk.ready) {
+		return NULL;
+	}
+	_virtio_blk_dev.nblocks = disk.capacity / BLOCK_SECTORS;
+	return &_virtio_blk_dev;
+}
+
+//磁盘容量(扇区数)，没有磁盘时为0
+uint32_t virtio_blk_capacity(void)
+{
+	return disk.capacity;
+}
+
+//输出提交、完成的请求数和通知设备的次数
+void virtio_blk_stats(void)
+{
+	printf("virtio-blk: submitted %d, completed %d, notifies %d\n",
+		disk.submitted, disk.completed, disk.notifies);
+}